@@ -0,0 +1,158 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "network_interface.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// A NetworkInterface resolving many neighbors at once: datagrams to every neighbor are queued behind ARP
+// requests, then the replies arrive (in random order), each releasing its neighbor's datagrams.
+
+constexpr size_t per_neighbor = 4;  // datagrams queued for each neighbor
+const EthernetAddress local_ethernet{0x02, 0, 0, 0, 0, 1};
+constexpr uint32_t local_ip = 10u << 24 | 1;
+
+uint32_t neighbor_ip(const size_t n) { return local_ip + 1 + n; }
+EthernetAddress neighbor_ethernet(const size_t n) {
+    return {0x02, 1, uint8_t(n >> 24), uint8_t(n >> 16), uint8_t(n >> 8), uint8_t(n)};
+}
+
+InternetDatagram make_datagram(const size_t n, const size_t i) {
+    InternetDatagram dgram;
+    dgram.header().src = local_ip;
+    dgram.header().dst = neighbor_ip(n);
+    dgram.header().id = i;
+    dgram.payload() = string(64, 'x');
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram;
+}
+
+EthernetFrame make_reply(const size_t n) {
+    ARPMessage arp;
+    arp.opcode = ARPMessage::OPCODE_REPLY;
+    arp.sender_ethernet_address = neighbor_ethernet(n);
+    arp.sender_ip_address = neighbor_ip(n);
+    arp.target_ethernet_address = local_ethernet;
+    arp.target_ip_address = local_ip;
+    EthernetFrame frame;
+    frame.header() = {local_ethernet, neighbor_ethernet(n), EthernetHeader::TYPE_ARP};
+    frame.payload() = arp.serialize();
+    return frame;
+}
+
+//! Check that every neighbor got its datagrams, in order, and return how many ARP requests were sent
+size_t check_frames(queue<EthernetFrame> &frames, const size_t neighbors) {
+    vector<size_t> received(neighbors);
+    size_t requests = 0;
+    for (; not frames.empty(); frames.pop()) {
+        const auto &frame = frames.front();
+        if (frame.header().type == EthernetHeader::TYPE_ARP) {
+            requests++;
+            continue;
+        }
+        InternetDatagram dgram;
+        if (dgram.parse(frame.payload().concatenate()) != ParseResult::NoError) {
+            throw runtime_error("could not parse a datagram");
+        }
+        const size_t n = dgram.header().dst - neighbor_ip(0);
+        if (n >= neighbors or frame.header().dst != neighbor_ethernet(n) or dgram.header().id != received[n]++) {
+            throw runtime_error("datagram " + dgram.header().summary() + " sent to " + to_string(frame.header().dst));
+        }
+    }
+    if (any_of(received.begin(), received.end(), [](const size_t count) { return count != per_neighbor; })) {
+        throw runtime_error("a neighbor did not get all its datagrams");
+    }
+    return requests;
+}
+
+void run(const size_t neighbors, const bool report) {
+    NetworkInterface interface{local_ethernet, Address::from_ipv4_numeric(local_ip)};
+    vector<InternetDatagram> datagrams;
+    for (size_t i = 0; i < per_neighbor; i++) {
+        for (size_t n = 0; n < neighbors; n++) {
+            datagrams.push_back(make_datagram(n, i));
+        }
+    }
+    vector<EthernetFrame> replies;
+    for (size_t n = 0; n < neighbors; n++) {
+        replies.push_back(make_reply(n));
+    }
+    mt19937 rng{1};
+    shuffle(replies.begin(), replies.end(), rng);
+
+    // queue every datagram behind an ARP request
+    auto start = steady_clock::now();
+    for (const auto &dgram : datagrams) {
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(dgram.header().dst));
+    }
+    const double queue_time = duration<double>(steady_clock::now() - start).count();
+    if (interface.frames_out().size() != neighbors) {
+        throw runtime_error("expected one ARP request per neighbor");
+    }
+
+    // the replies release the datagrams
+    start = steady_clock::now();
+    for (const auto &reply : replies) {
+        interface.recv_frame(reply);
+    }
+    const double reply_time = duration<double>(steady_clock::now() - start).count();
+    if (check_frames(interface.frames_out(), neighbors) != neighbors) {
+        throw runtime_error("expected one ARP request per neighbor");
+    }
+
+    // now every neighbor is known
+    start = steady_clock::now();
+    for (const auto &dgram : datagrams) {
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(dgram.header().dst));
+    }
+    const double send_time = duration<double>(steady_clock::now() - start).count();
+    if (check_frames(interface.frames_out(), neighbors) != 0) {
+        throw runtime_error("sent an ARP request for a known neighbor");
+    }
+
+    start = steady_clock::now();
+    interface.tick(1);
+    const double tick_time = duration<double>(steady_clock::now() - start).count();
+
+    if (not report) {
+        return;
+    }
+    cout << setw(10) << neighbors << fixed << setprecision(0) << setw(13) << queue_time / datagrams.size() * 1e9
+         << setw(13) << reply_time / neighbors * 1e9 << setw(13) << send_time / datagrams.size() * 1e9 << setw(10)
+         << tick_time * 1e6 << "\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        vector<size_t> counts{1000, 10'000, 100'000};
+        if (argc > 1) {
+            counts.clear();
+            for (int i = 1; i < argc; i++) {
+                counts.push_back(stoul(argv[i]));
+            }
+        }
+
+        cout << "(" << per_neighbor << " datagrams per neighbor)\n"
+             << "                 ns/datagram     ns/reply  ns/datagram  us/tick\n"
+             << " neighbors  (unresolved)  (" << per_neighbor << " waiting)   (resolved)\n";
+        for (const auto count : counts) {
+            run(count, false);  // warm up, so the timed run reuses memory rather than faulting in new pages
+            run(count, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
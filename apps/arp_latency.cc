@@ -0,0 +1,163 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "network_interface.hh"
+
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+// Two NetworkInterfaces on a link with a fixed delay, one sending a datagram to the other every few
+// milliseconds for minutes of simulated time. Each datagram's latency should be the link's delay: a
+// mapping in use is refreshed before it expires, so no datagram ever waits for an ARP round trip. Then
+// the receiver goes silent, and the sender must give up on its mapping once a refresh goes unanswered.
+
+constexpr size_t link_delay = 5;      // ms, each way
+constexpr size_t send_interval = 10;  // ms between datagrams
+
+//! One direction of the link: frames in flight, with the time each arrives
+class Wire {
+    deque<pair<size_t, EthernetFrame>> _in_flight{};
+
+  public:
+    //! Put a frame on the wire at `now`
+    void carry(EthernetFrame &&frame, const size_t now) {
+        frame.payload() = frame.payload().concatenate();  // as it would arrive off the wire
+        _in_flight.emplace_back(now + link_delay, move(frame));
+    }
+
+    //! Take the next frame that has arrived by `now`, if any
+    optional<EthernetFrame> arrive(const size_t now) {
+        if (_in_flight.empty() or _in_flight.front().first > now) {
+            return {};
+        }
+        auto frame = move(_in_flight.front().second);
+        _in_flight.pop_front();
+        return frame;
+    }
+};
+
+class Link {
+    NetworkInterface _sender{{0x02, 0, 0, 0, 0, 1}, Address{"10.0.0.1"}};
+    NetworkInterface _receiver{{0x02, 0, 0, 0, 0, 2}, Address{"10.0.0.2"}};
+    Wire _forward{};
+    Wire _back{};
+    size_t _now = 0;
+
+    //! Put the sender's frames on the wire (or lose them), counting what they are
+    void send(const bool connected) {
+        for (auto &frames = _sender.frames_out(); not frames.empty(); frames.pop()) {
+            auto &frame = frames.front();
+            ARPMessage arp;
+            if (frame.header().type == EthernetHeader::TYPE_IPv4) {
+                datagrams_sent++;
+            } else if (arp.parse(frame.payload().concatenate()) == ParseResult::NoError and
+                       arp.opcode == ARPMessage::OPCODE_REQUEST) {
+                (frame.header().dst == ETHERNET_BROADCAST ? broadcasts : refreshes)++;
+            }
+            if (connected) {
+                _forward.carry(move(frame), _now);
+            }
+        }
+    }
+
+  public:
+    map<size_t, size_t> latencies{};  //!< Datagrams received, by latency (ms)
+    size_t datagrams_sent = 0;        //!< Datagrams the sender put on the wire
+    size_t broadcasts = 0;            //!< ARP requests the sender broadcast
+    size_t refreshes = 0;             //!< ARP requests the sender sent straight to the receiver
+
+    //! Run for `length` ms; with `connected` false, the receiver hears nothing
+    void run(const size_t length, const bool connected = true) {
+        for (const size_t end = _now + length; _now < end; _now++) {
+            _sender.tick(1);
+            _receiver.tick(1);
+
+            if (_now % send_interval == 0) {
+                InternetDatagram dgram;
+                dgram.header().src = Address{"10.0.0.1"}.ipv4_numeric();
+                dgram.header().dst = Address{"10.0.0.2"}.ipv4_numeric();
+                dgram.payload() = to_string(_now);  // when it was sent
+                dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+                _sender.send_datagram(dgram, Address{"10.0.0.2"});
+            }
+
+            send(connected);
+            for (auto &frames = _receiver.frames_out(); not frames.empty(); frames.pop()) {
+                _back.carry(move(frames.front()), _now);
+            }
+
+            while (auto frame = _forward.arrive(_now)) {
+                if (const auto dgram = _receiver.recv_frame(frame.value())) {
+                    latencies[_now - stoul(dgram->payload().concatenate())]++;
+                }
+            }
+            while (auto frame = _back.arrive(_now)) {
+                _sender.recv_frame(frame.value());
+            }
+        }
+    }
+};
+
+int main() {
+    try {
+        Link link;
+
+        // the first datagrams wait for ARP
+        link.run(10 * send_interval);
+        if (link.broadcasts != 1) {
+            throw runtime_error("expected the first datagram to need an ARP request");
+        }
+
+        // after that, none should
+        link.latencies.clear();
+        constexpr size_t minutes = 3;
+        link.run(minutes * 60 * 1000);
+        cout << "A datagram every " << send_interval << " ms for " << minutes << " minutes, over a link with "
+             << link_delay << " ms of delay:\n"
+             << "  latency (ms)   datagrams\n";
+        for (const auto &[latency, count] : link.latencies) {
+            cout << setw(14) << latency << setw(12) << count << "\n";
+        }
+        cout << link.refreshes << " refreshes, " << link.broadcasts - 1 << " more broadcast ARP requests\n";
+        if (link.latencies.size() != 1 or link.latencies.count(link_delay) == 0) {
+            throw runtime_error("some datagrams were delayed");
+        }
+        if (link.broadcasts != 1 or link.refreshes < minutes * 60 / 30) {
+            throw runtime_error("expected the mapping to be refreshed, never to expire");
+        }
+
+        // with the receiver gone, the sender goes on using the mapping until a refresh goes unanswered, then
+        // forgets it (and asks again)
+        const size_t sent_before = link.datagrams_sent;
+        link.run(60 * 1000, false);
+        if (link.broadcasts == 1) {
+            throw runtime_error("the mapping outlived a refresh that went unanswered");
+        }
+        const size_t kept_sending = link.datagrams_sent - sent_before;
+        cout << "With the receiver gone: " << kept_sending << " datagrams sent with the stale mapping, then "
+             << link.broadcasts - 1 << " broadcast ARP requests\n";
+        if (kept_sending == 0 or kept_sending > 30 * 1000 / send_interval + 1) {
+            throw runtime_error("expected the stale mapping to be used only until the refresh failed");
+        }
+
+        // and when it comes back (and answers a request), traffic flows again
+        link.latencies.clear();
+        link.run(10 * 1000);
+        if (link.latencies[link_delay] < 4 * 1000 / send_interval) {
+            throw runtime_error("traffic did not recover");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "eventloop.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t rounds = 2000;
+
+//! Register `idle_count` sockets that never become ready, plus one that receives a datagram
+//! before every wait, and return the average time per EventLoop::wait_next_event
+double run(const EventLoop::Backend backend, const size_t idle_count) {
+    EventLoop loop{backend};
+
+    vector<UDPSocket> idle(idle_count);
+    for (auto &sock : idle) {
+        sock.bind(Address("127.0.0.1", 0));
+        loop.add_rule(sock, Direction::In, [&] { sock.recv(); });
+    }
+
+    UDPSocket rx, tx;
+    rx.bind(Address("127.0.0.1", 0));
+    tx.connect(rx.local_address());
+    size_t received = 0;
+    loop.add_rule(rx, Direction::In, [&] {
+        rx.recv_buffer();
+        received++;
+    });
+
+    nanoseconds waiting{0};
+    for (size_t round = 0; round < rounds; round++) {
+        tx.send("x");
+        const auto start = steady_clock::now();
+        if (loop.wait_next_event(-1) != EventLoop::Result::Success) {
+            throw runtime_error("unexpected EventLoop result");
+        }
+        waiting += steady_clock::now() - start;
+    }
+
+    if (received != rounds) {
+        throw runtime_error("lost datagrams");
+    }
+
+    return double(waiting.count()) / rounds;
+}
+
+int main() {
+    try {
+        // allow as many sockets as the hard limit permits
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+
+        cout << fixed << setprecision(0);
+        cout << "registered fds   poll ns/event   epoll ns/event   io_uring ns/event\n";
+        for (const size_t idle_count : {size_t(16), size_t(256), size_t(4096), size_t(16384)}) {
+            if (idle_count + 16 > limit.rlim_cur) {
+                break;
+            }
+            const auto poll_ns = run(EventLoop::Backend::Poll, idle_count);
+            const auto epoll_ns = run(EventLoop::Backend::Epoll, idle_count);
+            const auto uring_ns = run(EventLoop::Backend::IOUring, idle_count);
+            cout << setw(14) << idle_count + 1 << setw(16) << poll_ns << setw(17) << epoll_ns << setw(20) << uring_ns
+                 << "\n";
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "eventloop.hh"
+#include "io_uring.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t total_bytes = 16 * 1024 * 1024;
+constexpr size_t datagram_size = 1400;
+constexpr size_t batch = 32;
+
+struct Result {
+    double syscalls_per_mb;
+    double mb_per_second;
+};
+
+Result report(const size_t syscalls, const nanoseconds elapsed) {
+    const double mb = double(total_bytes) / (1024 * 1024);
+    return {double(syscalls) / mb, mb / duration<double>(elapsed).count()};
+}
+
+//! One sendmsg per datagram, and a poll plus a recvmsg per datagram received
+Result run_classic(UDPSocket &tx, UDPSocket &rx) {
+    const string payload(datagram_size, 'x');
+    EventLoop loop{EventLoop::Backend::Poll};
+    size_t received = 0;
+    loop.add_rule(rx, Direction::In, [&] {
+        rx.recv_buffer();
+        received++;
+    });
+
+    size_t syscalls = 0;
+    const auto start = steady_clock::now();
+    for (size_t sent = 0; sent < total_bytes; sent += batch * datagram_size) {
+        for (size_t i = 0; i < batch; i++) {
+            tx.send(payload);
+            syscalls++;
+        }
+        for (received = 0; received < batch;) {
+            loop.wait_next_event(-1);
+            syscalls += 2;
+        }
+    }
+    return report(syscalls, steady_clock::now() - start);
+}
+
+//! Each batch of datagrams is sent with one io_uring submission, and received with one recvmmsg per wait
+//! of an io_uring EventLoop
+Result run_io_uring(UDPSocket &tx, UDPSocket &rx) {
+    const string payload(datagram_size, 'x');
+    EventLoop loop{EventLoop::Backend::IOUring};
+    size_t received = 0;
+    size_t syscalls = 0;
+    loop.add_rule(rx, Direction::In, [&] {
+        for (const auto &datagram : rx.recv_batch(batch)) {
+            if (datagram.payload.size() != datagram_size) {
+                throw runtime_error("short datagram");
+            }
+            received++;
+        }
+        syscalls++;
+    });
+
+    const size_t syscalls_before = IOUringWriteBatch::syscall_count();
+    const auto start = steady_clock::now();
+    for (size_t sent = 0; sent < total_bytes; sent += batch * datagram_size) {
+        IOUringWriteBatch writes{};
+        for (size_t i = 0; i < batch; i++) {
+            tx.send(payload);
+        }
+        writes.flush();
+
+        for (received = 0; received < batch;) {
+            loop.wait_next_event(-1);
+            syscalls++;
+        }
+    }
+    const auto elapsed = steady_clock::now() - start;
+    return report(IOUringWriteBatch::syscall_count() - syscalls_before + syscalls, elapsed);
+}
+
+int main() {
+    try {
+        UDPSocket rx, tx;
+        rx.bind(Address("127.0.0.1", 0));
+        tx.connect(rx.local_address());
+
+        cout << fixed << setprecision(1);
+        const auto classic = run_classic(tx, rx);
+        cout << "poll + sendmsg/recvmsg : " << classic.syscalls_per_mb << " syscalls/MB, " << classic.mb_per_second
+             << " MB/s\n";
+
+        if (not IOUring::available()) {
+            cout << "io_uring is not available on this system\n";
+            return EXIT_SUCCESS;
+        }
+        const auto uring = run_io_uring(tx, rx);
+        cout << "io_uring               : " << uring.syscalls_per_mb << " syscalls/MB, " << uring.mb_per_second
+             << " MB/s\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -89,7 +89,7 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
 
     optional<TCPSegment> read() {
         EthernetFrame frame;
-        if (frame.parse(_data_socket_pair.first.read()) != ParseResult::NoError) {
+        if (frame.parse(_data_socket_pair.first.read_buffer()) != ParseResult::NoError) {
             return {};
         }
 
@@ -106,7 +106,7 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
 
         return {};
     }
-    void write(TCPSegment &seg) {
+    void write(TCPSegment &&seg) {
         _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
         send_pending();
     }
@@ -4,7 +4,9 @@
 
 #include <iostream>
 #include <list>
+#include <map>
 #include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -78,6 +80,9 @@ class Host {
 
     std::list<InternetDatagram> _expecting_to_receive{};
 
+    bool _collecting = false;
+    std::vector<InternetDatagram> _collected{};
+
     bool expecting(const InternetDatagram &expected) const {
         for (const auto &x : _expecting_to_receive) {
             if (x.serialize().concatenate() == expected.serialize().concatenate()) {
@@ -104,10 +109,28 @@ class Host {
         , _next_hop(next_hop) {}
 
     InternetDatagram send_to(const Address &destination, const uint8_t ttl = 64) {
+        return send(destination, IPv4Header::PROTO_TCP, "random payload: {" + to_string(rd()) + "}", ttl);
+    }
+
+    //! Send a UDP datagram (with a zero checksum, meaning none) between the given ports
+    InternetDatagram send_udp_to(const Address &destination,
+                                 const uint16_t src_port,
+                                 const uint16_t dst_port,
+                                 const string &text) {
+        string payload;
+        NetUnparser::u16(payload, src_port);
+        NetUnparser::u16(payload, dst_port);
+        NetUnparser::u16(payload, 8 + text.size());
+        NetUnparser::u16(payload, 0);
+        return send(destination, IPv4Header::PROTO_UDP, payload + text);
+    }
+
+    InternetDatagram send(const Address &destination, const uint8_t proto, string &&payload, const uint8_t ttl = 64) {
         InternetDatagram dgram;
         dgram.header().src = _my_address.ipv4_numeric();
         dgram.header().dst = destination.ipv4_numeric();
-        dgram.payload() = "random payload: {" + to_string(rd()) + "}";
+        dgram.header().proto = proto;
+        dgram.payload() = move(payload);
         dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
         dgram.header().ttl = ttl;
 
@@ -125,9 +148,19 @@ class Host {
 
     void expect(const InternetDatagram &expected) { _expecting_to_receive.push_back(expected); }
 
+    //! Keep whatever arrives, instead of checking it against what is expected
+    void collect() { _collecting = true; }
+
+    //! What has arrived, in order, since collect()
+    std::vector<InternetDatagram> &collected() { return _collected; }
+
     const string &name() { return _name; }
 
     void check() {
+        for (; _collecting and not _interface.datagrams_out().empty(); _interface.datagrams_out().pop()) {
+            _collected.push_back(_interface.datagrams_out().front());
+        }
+
         while (not _interface.datagrams_out().empty()) {
             const auto &dgram_received = _interface.datagrams_out().front();
             if (not expecting(dgram_received)) {
@@ -151,7 +184,7 @@ class Network {
   private:
     Router _router{};
 
-    size_t default_id, eth0_id, eth1_id, eth2_id, uun3_id, hs4_id, mit5_id;
+    size_t default_id, eth0_id, eth1_id, eth2_id, uun3_id, hs4_id, mit5_id, up6_id, up7_id;
 
     std::unordered_map<string, Host> _hosts{};
 
@@ -212,7 +245,9 @@ class Network {
         , eth2_id(_router.add_interface({random_router_ethernet_address(), {"192.168.0.1"}}))
         , uun3_id(_router.add_interface({random_router_ethernet_address(), {"198.178.229.1"}}))
         , hs4_id(_router.add_interface({random_router_ethernet_address(), {"143.195.0.2"}}))
-        , mit5_id(_router.add_interface({random_router_ethernet_address(), {"128.30.76.255"}})) {
+        , mit5_id(_router.add_interface({random_router_ethernet_address(), {"128.30.76.255"}}))
+        , up6_id(_router.add_interface({random_router_ethernet_address(), {"100.64.0.1"}}))
+        , up7_id(_router.add_interface({random_router_ethernet_address(), {"100.64.1.1"}})) {
         _hosts.insert({"applesauce", {"applesauce", {"10.0.0.2"}, {"10.0.0.1"}}});
         _hosts.insert({"default_router", {"default_router", {"171.67.76.1"}, {"0"}}});
         ;
@@ -220,6 +255,8 @@ class Network {
         _hosts.insert({"hs_router", {"hs_router", {"143.195.0.1"}, {"0"}}});
         _hosts.insert({"dm42", {"dm42", {"198.178.229.42"}, {"198.178.229.1"}}});
         _hosts.insert({"dm43", {"dm43", {"198.178.229.43"}, {"198.178.229.1"}}});
+        _hosts.insert({"uplink_a", {"uplink_a", {"100.64.0.2"}, {"0"}}});
+        _hosts.insert({"uplink_b", {"uplink_b", {"100.64.1.2"}, {"0"}}});
 
         _router.add_route(ip("0.0.0.0"), 0, host("default_router").address(), default_id);
         _router.add_route(ip("10.0.0.0"), 8, {}, eth0_id);
@@ -230,6 +267,8 @@ class Network {
         _router.add_route(ip("143.195.128.0"), 18, host("hs_router").address(), hs4_id);
         _router.add_route(ip("143.195.192.0"), 19, host("hs_router").address(), hs4_id);
         _router.add_route(ip("128.30.76.255"), 16, Address{"128.30.0.1"}, mit5_id);
+        _router.add_multipath_route(
+            ip("203.0.113.0"), 24, {{host("uplink_a").address(), up6_id}, {host("uplink_b").address(), up7_id}});
     }
 
     void simulate_physical_connections() {
@@ -238,6 +277,8 @@ class Network {
         exchange_frames("router.eth0", _router.interface(eth0_id), "applesauce", host("applesauce").interface());
         exchange_frames("router.eth2", _router.interface(eth2_id), "cherrypie", host("cherrypie").interface());
         exchange_frames("router.hs4", _router.interface(hs4_id), "hs_router", host("hs_router").interface());
+        exchange_frames("router.up6", _router.interface(up6_id), "uplink_a", host("uplink_a").interface());
+        exchange_frames("router.up7", _router.interface(up7_id), "uplink_b", host("uplink_b").interface());
         exchange_frames("router.uun3",
                         _router.interface(uun3_id),
                         "dm42",
@@ -331,6 +372,48 @@ void network_simulator() {
         network.simulate();
     }
 
+    cout << green << "\n\nSuccess! Testing multipath routing (applesauce to 203.0.113.7 via uplink_a or uplink_b)..."
+         << normal << "\n\n";
+    {
+        // each flow (source port) must stick to one uplink, in order, while the flows spread over both
+        constexpr uint16_t flows = 16, per_flow = 3;
+        network.host("uplink_a").collect();
+        network.host("uplink_b").collect();
+        vector<InternetDatagram> sent;
+        for (uint16_t n = 0; n < per_flow; n++) {
+            for (uint16_t flow = 0; flow < flows; flow++) {
+                sent.push_back(network.host("applesauce").send_udp_to({"203.0.113.7"}, 5000 + flow, 53, to_string(n)));
+                sent.back().header().ttl--;
+            }
+        }
+        network.simulate();
+
+        map<string, string> uplink_of;  // serialized datagram -> the uplink that received it
+        for (const string name : {"uplink_a", "uplink_b"}) {
+            map<uint16_t, size_t> received;  // flow -> datagrams received so far
+            for (const auto &dgram : network.host(name).collected()) {
+                const auto raw = dgram.serialize().concatenate();
+                uplink_of[raw] = name;
+                const uint16_t flow = (uint8_t(raw.at(20)) << 8 | uint8_t(raw.at(21))) - 5000;
+                if (raw != sent.at(received[flow]++ * flows + flow).serialize().concatenate()) {
+                    throw runtime_error(name + " received the datagrams of flow " + to_string(flow) + " out of order");
+                }
+            }
+        }
+        for (size_t i = 0; i < sent.size(); i++) {
+            const auto raw = sent[i].serialize().concatenate();
+            if (uplink_of.count(raw) == 0) {
+                throw runtime_error("a multipath datagram went missing: " + sent[i].header().summary());
+            }
+            if (uplink_of[raw] != uplink_of[sent[i % flows].serialize().concatenate()]) {
+                throw runtime_error("a flow was split between the uplinks");
+            }
+        }
+        if (network.host("uplink_a").collected().empty() or network.host("uplink_b").collected().empty()) {
+            throw runtime_error("the flows were not spread over the uplinks");
+        }
+    }
+
     cout << green << "\n\nSuccess! Testing TTL expiration..." << normal << "\n\n";
     {
         auto dgram_sent = network.host("applesauce").send_to({"1.2.3.4"}, 1);
@@ -0,0 +1,190 @@
+#include "dir24_8_table.hh"
+#include "epoch.hh"
+#include "lpm_trie.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t lookups = 10'000'000;
+
+struct Route {
+    uint32_t prefix;
+    uint8_t length;
+    uint32_t value;
+};
+
+//! Random prefixes with lengths roughly as in a BGP table: mostly /24, then /16 to /23, a few shorter
+vector<Route> make_routes(const size_t count, mt19937 &rng) {
+    discrete_distribution<int> length_distribution{
+        {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 3, 5, 6, 13, 6, 10, 18, 30, 40, 60, 50, 320}};
+    vector<Route> routes;
+    routes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const auto length = static_cast<uint8_t>(length_distribution(rng));
+        routes.push_back({static_cast<uint32_t>(rng()) & LPMTrie::mask(length), length, uint32_t(i % 4096)});
+    }
+    return routes;
+}
+
+//! Longest-prefix match by scanning every route (how Router used to look routes up)
+optional<uint32_t> scan(const vector<Route> &routes, const uint32_t address) {
+    optional<uint32_t> best{};
+    int best_length = -1;
+    for (const auto &route : routes) {
+        if ((address & LPMTrie::mask(route.length)) == route.prefix and route.length >= best_length) {
+            best = route.value;
+            best_length = route.length;
+        }
+    }
+    return best;
+}
+
+//! Addresses to look up: half inside random routes' prefixes, half anywhere
+vector<uint32_t> make_addresses(const vector<Route> &routes, const size_t count, mt19937 &rng) {
+    vector<uint32_t> addresses(count);
+    for (auto &address : addresses) {
+        address = rng();
+        if (address & 1) {
+            const auto &route = routes[rng() % routes.size()];
+            address = route.prefix | (address & ~LPMTrie::mask(route.length));
+        }
+    }
+    return addresses;
+}
+
+//! Seconds taken by `lookup` for each of `addresses`
+template <typename LookupT>
+double time_lookups(const vector<uint32_t> &addresses, const LookupT &lookup) {
+    uint64_t checksum = 0;
+    const auto start = steady_clock::now();
+    for (const auto address : addresses) {
+        checksum += lookup(address).value_or(0);
+    }
+    const double time = duration<double>(steady_clock::now() - start).count();
+    if (checksum == 1) {  // keep the lookups from being optimized away
+        cout << "";
+    }
+    return time;
+}
+
+void run(const size_t count) {
+    mt19937 rng{static_cast<uint32_t>(count)};
+    const auto routes = make_routes(count, rng);
+
+    LPMTrie trie;
+    const auto insert_start = steady_clock::now();
+    for (const auto &route : routes) {
+        trie.insert(route.prefix, route.length, route.value);
+    }
+    const double insert_time = duration<double>(steady_clock::now() - insert_start).count();
+
+    const auto compile_start = steady_clock::now();
+    Dir24_8Builder builder{trie, 0};
+    const double compile_time = duration<double>(steady_clock::now() - compile_start).count();
+
+    const auto addresses = make_addresses(routes, lookups, rng);
+    const double trie_time = time_lookups(addresses, [&](const uint32_t a) { return trie.lookup(a); });
+    double table_time = 0, table_memory = 0;
+    {
+        const Epoch::Guard guard;
+        const Dir24_8Table *const table = builder.table();
+        for (size_t i = 0; i < addresses.size(); i += 97) {
+            if (trie.lookup(addresses[i]) != table->lookup(addresses[i])) {
+                throw runtime_error("trie and DIR-24-8 table disagree on " + to_string(addresses[i]));
+            }
+        }
+        table_time = time_lookups(addresses, [&](const uint32_t a) { return table->lookup(a); });
+        table_memory = table->memory_usage();
+    }
+
+    // changes (alternately changing and removing a route), each recompiled in the background and swapped
+    // in before the next is made
+    const size_t changes = 200;
+    const auto table_version = [&] {
+        const Epoch::Guard guard;
+        const Dir24_8Table *const table = builder.table();
+        if (not table) {
+            throw runtime_error("DIR-24-8 table withdrawn after a failed update");
+        }
+        return table->version();
+    };
+    const auto update_start = steady_clock::now();
+    for (size_t i = 0; i < changes; i++) {
+        const auto &route = routes[rng() % routes.size()];
+        if (i % 2) {
+            trie.erase(route.prefix, route.length);
+            builder.update(route.prefix, route.length, {}, i + 1);
+        } else {
+            trie.insert(route.prefix, route.length, (route.value + 1) % 4096);
+            builder.update(route.prefix, route.length, (route.value + 1) % 4096, i + 1);
+        }
+        while (table_version() != i + 1) {
+            this_thread::yield();
+        }
+    }
+    const double update_time = duration<double>(steady_clock::now() - update_start).count();
+    const Epoch::Guard guard;
+    for (size_t i = 0; i < addresses.size(); i += 97) {
+        if (trie.lookup(addresses[i]) != builder.table()->lookup(addresses[i])) {
+            throw runtime_error("trie and updated DIR-24-8 table disagree on " + to_string(addresses[i]));
+        }
+    }
+
+    cout << setw(9) << count << fixed << setprecision(2) << setw(13) << trie.size() / insert_time / 1e6
+         << setw(12) << lookups / trie_time / 1e6 << setw(12) << setprecision(1)
+         << double(trie.memory_usage()) / trie.size() << setw(13) << compile_time * 1e3 << setw(12)
+         << lookups / table_time / 1e6 << setw(11) << table_time / lookups * 1e9 << setw(10)
+         << table_memory / 1048576.0 << setw(12) << update_time / changes * 1e3 << "\n";
+}
+
+//! Lookups per second by scanning a small table, for comparison
+void run_scan(const size_t count) {
+    mt19937 rng{static_cast<uint32_t>(count)};
+    const auto routes = make_routes(count, rng);
+    const auto addresses = make_addresses(routes, lookups / 1000, rng);
+    uint64_t checksum = 0;
+    const auto start = steady_clock::now();
+    for (const auto address : addresses) {
+        checksum += scan(routes, address).value_or(0);
+    }
+    const double time = duration<double>(steady_clock::now() - start).count();
+    cout << "linear scan of " << count << " routes: " << fixed << setprecision(3) << addresses.size() / time / 1e6
+         << " M lookups/s   (" << checksum % 1000 << ")\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        vector<size_t> counts{100'000, 300'000, 1'000'000};
+        if (argc > 1) {
+            counts.clear();
+            for (int i = 1; i < argc; i++) {
+                counts.push_back(stoul(argv[i]));
+            }
+        }
+
+        run_scan(1000);
+        run_scan(10000);
+
+        cout << "\n                        trie                                  DIR-24-8\n"
+             << "   routes  M inserts/s M lookups/s   bytes/pfx   compile ms M lookups/s  ns/lookup       MiB"
+             << "   update ms\n";
+        for (const auto count : counts) {
+            run(count);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
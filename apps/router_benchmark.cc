@@ -0,0 +1,373 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "lpm_trie.hh"
+#include "router.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Packets per second through Router::route(), routing each datagram on its own or in batches, and patching
+// the received header or rebuilding it; then, for traffic to a few popular destinations, with a flow cache
+
+constexpr size_t num_interfaces = 4;
+constexpr size_t num_hops = 16;
+constexpr size_t pool_size = 4096;  // datagrams queued for each call to route()
+constexpr size_t datagrams_per_run = 1'000'000;
+
+size_t hop_interface(const size_t hop) { return hop % num_interfaces; }
+uint32_t interface_address(const size_t interface) { return (10u << 24) | (uint32_t(interface) << 8) | 1; }
+uint32_t hop_address(const size_t hop) { return (10u << 24) | (uint32_t(hop_interface(hop)) << 8) | (10 + hop); }
+EthernetAddress hop_ethernet(const size_t hop) { return {0x02, 0, 0, 0, 2, uint8_t(hop)}; }
+
+//! Random routes, with prefix lengths roughly as in a BGP table, to random next hops
+vector<Router::Route> make_routes(const size_t count, mt19937 &rng) {
+    discrete_distribution<int> length_distribution{
+        {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 3, 5, 6, 13, 6, 10, 18, 30, 40, 60, 50, 320}};
+    vector<Router::Route> routes;
+    routes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const auto length = static_cast<uint8_t>(length_distribution(rng));
+        const size_t hop = rng() % num_hops;
+        routes.push_back({static_cast<uint32_t>(rng()) & LPMTrie::mask(length),
+                          length,
+                          Address::from_ipv4_numeric(hop_address(hop)),
+                          hop_interface(hop)});
+    }
+    return routes;
+}
+
+//! A router with the routes, and the Ethernet addresses of its next hops already known
+void set_up(Router &router, const vector<Router::Route> &routes) {
+    for (size_t interface = 0; interface < num_interfaces; interface++) {
+        const auto address = Address::from_ipv4_numeric(interface_address(interface));
+        router.add_interface(AsyncNetworkInterface{{0x02, 0, 0, 0, 1, uint8_t(interface)}, address});
+    }
+    for (size_t hop = 0; hop < num_hops; hop++) {
+        ARPMessage arp;
+        arp.opcode = ARPMessage::OPCODE_REQUEST;
+        arp.sender_ethernet_address = hop_ethernet(hop);
+        arp.sender_ip_address = hop_address(hop);
+        arp.target_ip_address = interface_address(hop_interface(hop));
+        EthernetFrame frame;
+        frame.header() = {ETHERNET_BROADCAST, hop_ethernet(hop), EthernetHeader::TYPE_ARP};
+        frame.payload().append(arp.serialize());
+        router.interface(hop_interface(hop)).recv_frame(frame);
+    }
+    for (size_t interface = 0; interface < num_interfaces; interface++) {
+        router.interface(interface).frames_out() = {};
+    }
+
+    router.add_routes(routes);
+    router.add_route(0, 0, Address::from_ipv4_numeric(hop_address(0)), hop_interface(0));
+}
+
+//! A datagram to `address`, serialized
+string make_datagram(const uint32_t address, mt19937 &rng) {
+    InternetDatagram dgram;
+    dgram.header().src = interface_address(0);
+    dgram.header().dst = address;
+    dgram.header().ttl = 64;
+    dgram.header().id = rng();
+    dgram.payload() = string(64, 'x');
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram.serialize().concatenate();
+}
+
+//! A destination address: half the time inside a random route's prefix, else anywhere
+uint32_t make_destination(const vector<Router::Route> &routes, mt19937 &rng) {
+    uint32_t address = rng();
+    if (address & 1) {
+        const auto &route = routes[rng() % routes.size()];
+        address = route.prefix | (address & ~LPMTrie::mask(route.prefix_length));
+    }
+    return address;
+}
+
+//! Datagrams to route (serialized), and the order to route them in (a list of indices, repeated as needed)
+struct Traffic {
+    vector<string> datagrams{};
+    vector<uint32_t> order{};
+};
+
+//! Traffic to pool_size distinct destinations, each sent to in turn
+Traffic uniform_traffic(const vector<Router::Route> &routes, mt19937 &rng) {
+    Traffic traffic;
+    for (size_t i = 0; i < pool_size; i++) {
+        traffic.datagrams.push_back(make_datagram(make_destination(routes, rng), rng));
+        traffic.order.push_back(i);
+    }
+    return traffic;
+}
+
+//! Traffic to `flows` destinations, the k-th most popular getting a share proportional to 1/k (Zipf's law)
+Traffic zipf_traffic(const vector<Router::Route> &routes, const size_t flows, mt19937 &rng) {
+    Traffic traffic;
+    vector<double> weights;
+    for (size_t k = 1; k <= flows; k++) {
+        traffic.datagrams.push_back(make_datagram(make_destination(routes, rng), rng));
+        weights.push_back(1.0 / k);
+    }
+    discrete_distribution<uint32_t> flow_distribution{weights.begin(), weights.end()};
+    for (size_t i = 0; i < datagrams_per_run; i++) {
+        traffic.order.push_back(flow_distribution(rng));
+    }
+    return traffic;
+}
+
+//! Queue pool_size datagrams of the traffic, starting at `first` in its order, on interface 0 as if they had
+//! just arrived
+//! \param[in] rebuild makes the router rebuild each header rather than patch the received one
+void receive(Router &router, const Traffic &traffic, const size_t first, const bool rebuild) {
+    for (size_t i = first; i < first + pool_size; i++) {
+        InternetDatagram dgram;
+        if (dgram.parse(Buffer::copy_of(traffic.datagrams[traffic.order[i % traffic.order.size()]])) !=
+            ParseResult::NoError) {
+            throw runtime_error("could not parse a datagram");
+        }
+        if (rebuild) {
+            dgram.header();  // a mutable header might have changed, so it will be serialized afresh
+        }
+        router.interface(0).datagrams_out().push(move(dgram));
+    }
+}
+
+//! Route the first pool_size datagrams of the traffic once, returning what each interface sent
+vector<vector<string>> route_once(Router &router, const Traffic &traffic, const bool rebuild) {
+    receive(router, traffic, 0, rebuild);
+    router.route();
+    vector<vector<string>> sent(num_interfaces);
+    for (size_t interface = 0; interface < num_interfaces; interface++) {
+        for (auto &frames = router.interface(interface).frames_out(); not frames.empty(); frames.pop()) {
+            sent[interface].push_back(frames.front().serialize().concatenate());
+        }
+    }
+    return sent;
+}
+
+//! Seconds spent in Router::route() forwarding datagrams_per_run datagrams of the traffic
+double time_route(Router &router, const Traffic &traffic, const bool rebuild) {
+    double time = 0;
+    for (size_t routed = 0; routed < datagrams_per_run; routed += pool_size) {
+        receive(router, traffic, routed, rebuild);
+        const auto start = steady_clock::now();
+        router.route();
+        time += duration<double>(steady_clock::now() - start).count();
+        for (size_t interface = 0; interface < num_interfaces; interface++) {
+            router.interface(interface).frames_out() = {};
+        }
+    }
+    return time;
+}
+
+void print_rate(const double time) {
+    cout << fixed << setprecision(2) << setw(9) << datagrams_per_run / time / 1e6 << setprecision(0) << setw(5)
+         << time / datagrams_per_run * 1e9;
+}
+
+//! Check that decrementing the TTL of a received datagram gives the same bytes as rebuilding its header
+void check_decrement_ttl() {
+    mt19937 rng{1};
+    for (size_t i = 0; i < 100'000; i++) {
+        InternetDatagram original;
+        original.header().ttl = 2 + rng() % 254;
+        original.header().proto = rng();
+        original.header().id = rng();
+        original.header().src = rng();
+        original.header().dst = rng();
+        original.header().len = original.header().hlen * 4;
+        const auto raw = original.serialize().concatenate();
+
+        InternetDatagram patched, rebuilt;
+        if (patched.parse(Buffer::copy_of(raw)) != ParseResult::NoError or
+            rebuilt.parse(Buffer::copy_of(raw)) != ParseResult::NoError) {
+            throw runtime_error("could not parse a datagram");
+        }
+        patched.decrement_ttl();
+        rebuilt.header().ttl--;
+        if (patched.serialize().concatenate() != rebuilt.serialize().concatenate()) {
+            throw runtime_error("decrement_ttl() disagrees with a rebuilt header: " + rebuilt.header().summary());
+        }
+    }
+}
+
+//! Check that route() notices a change to the routes behind a cached lookup
+void check_flow_cache() {
+    mt19937 rng{1};
+    const auto routes = make_routes(1000, rng);
+    Router router;
+    set_up(router, routes);
+    router.set_flow_cache_size(16);
+    const uint32_t destination = make_destination(routes, rng);
+    const auto raw = make_datagram(destination, rng);
+
+    // route the datagram four times (twice each way, so filling the cache and then hitting it), and return
+    // the interface it was sent on
+    const auto sent_on = [&] {
+        for (const size_t batch_size : {size_t(1), Router::DEFAULT_BATCH_SIZE}) {
+            router.set_batch_size(batch_size);
+            for (size_t i = 0; i < 2; i++) {
+                InternetDatagram dgram;
+                if (dgram.parse(Buffer::copy_of(raw)) != ParseResult::NoError) {
+                    throw runtime_error("could not parse a datagram");
+                }
+                router.interface(0).datagrams_out().push(move(dgram));
+                router.route();
+            }
+        }
+        optional<size_t> interface;
+        for (size_t n = 0; n < num_interfaces; n++) {
+            auto &frames = router.interface(n).frames_out();
+            if (not frames.empty()) {
+                if (interface.has_value() or frames.size() != 4) {
+                    throw runtime_error("flow cache: datagrams sent on different interfaces");
+                }
+                interface = n;
+                frames = {};
+            }
+        }
+        return interface.value();
+    };
+
+    const size_t before = sent_on();
+    const size_t hop = (before + 1) % num_interfaces;
+    router.add_route(destination, 32, Address::from_ipv4_numeric(hop_address(hop)), hop_interface(hop));
+    if (sent_on() != hop_interface(hop)) {
+        throw runtime_error("flow cache: a cached lookup outlived a new route");
+    }
+    router.remove_route(destination, 32);
+    if (sent_on() != before) {
+        throw runtime_error("flow cache: a cached lookup outlived a removed route");
+    }
+    if (router.flow_cache()->hits() == 0) {
+        throw runtime_error("flow cache: no hits");
+    }
+}
+
+void run(const size_t count, const vector<size_t> &batch_sizes) {
+    mt19937 rng{static_cast<uint32_t>(count)};
+    const auto routes = make_routes(count, rng);
+    Router router;
+    set_up(router, routes);
+    const auto traffic = uniform_traffic(routes, rng);
+
+    for (const bool compiled : {false, true}) {
+        if (compiled) {
+            router.compile_routes();
+        }
+
+        // neither batching nor patching received headers may change what is sent where, nor the order on
+        // any one interface
+        router.set_batch_size(1);
+        const auto expected = route_once(router, traffic, true);
+        if (route_once(router, traffic, false) != expected) {
+            throw runtime_error("route() sent different frames when patching received headers");
+        }
+        router.set_batch_size(Router::DEFAULT_BATCH_SIZE);
+        if (route_once(router, traffic, false) != expected) {
+            throw runtime_error("batched route() sent different frames");
+        }
+
+        cout << setw(9) << count << setw(10) << (compiled ? "DIR-24-8" : "trie");
+        for (const auto batch_size : batch_sizes) {
+            router.set_batch_size(batch_size);
+            print_rate(time_route(router, traffic, false));
+        }
+        router.set_batch_size(Router::DEFAULT_BATCH_SIZE);
+        print_rate(time_route(router, traffic, true));
+        cout << "\n";
+    }
+}
+
+void run_flow_cache(const size_t count, const vector<size_t> &flow_counts, const vector<size_t> &cache_sizes) {
+    mt19937 rng{static_cast<uint32_t>(count)};
+    const auto routes = make_routes(count, rng);
+    Router router;
+    set_up(router, routes);
+
+    for (const bool compiled : {false, true}) {
+        if (compiled) {
+            router.compile_routes();
+        }
+        for (const auto flows : flow_counts) {
+            const auto traffic = zipf_traffic(routes, flows, rng);
+            router.set_flow_cache_size(0);
+            const auto expected = route_once(router, traffic, false);
+
+            cout << setw(9) << count << setw(10) << (compiled ? "DIR-24-8" : "trie") << setw(8) << flows;
+            print_rate(time_route(router, traffic, false));
+            for (const auto cache_size : cache_sizes) {
+                router.set_flow_cache_size(cache_size);
+                if (route_once(router, traffic, false) != expected) {
+                    throw runtime_error("route() sent different frames with a flow cache");
+                }
+                router.set_flow_cache_size(cache_size);  // start empty
+                const double time = time_route(router, traffic, false);
+                const auto &cache = *router.flow_cache();
+                cout << setw(6) << setprecision(1) << 100.0 * cache.hits() / (cache.hits() + cache.misses()) << "%";
+                print_rate(time);
+            }
+            cout << "\n";
+        }
+    }
+    router.set_flow_cache_size(0);
+}
+
+int main(int argc, char **argv) {
+    try {
+        vector<size_t> counts{1000, 300'000};
+        if (argc > 1) {
+            counts.clear();
+            for (int i = 1; i < argc; i++) {
+                counts.push_back(stoul(argv[i]));
+            }
+        }
+
+        check_decrement_ttl();
+        cout << "decrement_ttl() matches a rebuilt header\n\n";
+
+        check_flow_cache();
+        cout << "a flow cache keeps up with changes to the routes\n\n";
+
+        const vector<size_t> batch_sizes{1, 8, 32, 64};
+        cout << "                       M datagrams/s and ns/datagram, by batch size"
+             << "           32, rebuilding headers\n"
+             << "   routes    lookup";
+        for (const auto batch_size : batch_sizes) {
+            cout << setw(14) << batch_size;
+        }
+        cout << setw(14) << Router::DEFAULT_BATCH_SIZE << "\n";
+        for (const auto count : counts) {
+            run(count, batch_sizes);
+        }
+
+        const vector<size_t> flow_counts{1000, 100'000};
+        const vector<size_t> cache_sizes{1024, 16384};
+        cout << "\n                                        with a flow cache of"
+             << "\n                          Zipf  no cache";
+        for (const auto cache_size : cache_sizes) {
+            cout << setw(21) << cache_size;
+        }
+        cout << "\n   routes    lookup   flows";
+        for (size_t i = 0; i <= cache_sizes.size(); i++) {
+            cout << (i == 0 ? "" : "    hits") << "     Mpps   ns";
+        }
+        cout << "\n";
+        for (const auto count : counts) {
+            run_flow_cache(count, flow_counts, cache_sizes);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
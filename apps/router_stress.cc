@@ -0,0 +1,247 @@
+#include "arp_message.hh"
+#include "epoch.hh"
+#include "ethernet_frame.hh"
+#include "router.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Looks up and forwards on several threads while another thread keeps changing the routes, checking that
+// every lookup sees either the old or the new version of each route, never anything else.
+
+constexpr size_t num_interfaces = 4;
+constexpr size_t num_hops = 8;
+constexpr size_t num_stable = 64;   // 20.i.0.0/16 via hop i % num_hops, never changed
+constexpr size_t num_probes = 64;   // 30.i.0.0/16: via PROBE_A, via PROBE_B, or absent (so the default route)
+constexpr size_t num_filler = 512;  // 40.x.y.0/24 routes added and removed at random
+constexpr size_t num_readers = 3;
+constexpr uint32_t DEFAULT_HOP = 0, PROBE_A = 1, PROBE_B = 2;
+
+uint32_t stable_prefix(const size_t i) { return (20u << 24) | (uint32_t(i) << 16); }
+uint32_t probe_prefix(const size_t i) { return (30u << 24) | (uint32_t(i) << 16); }
+uint32_t filler_prefix(const size_t i) { return (40u << 24) | (uint32_t(i) << 8); }
+
+uint32_t interface_address(const size_t interface) { return (10u << 24) | (uint32_t(interface) << 8) | 1; }
+size_t hop_interface(const size_t hop) { return hop % num_interfaces; }
+uint32_t hop_address(const size_t hop) { return (10u << 24) | (uint32_t(hop_interface(hop)) << 8) | (10 + hop); }
+
+EthernetAddress interface_ethernet(const size_t interface) { return {0x02, 0, 0, 0, 1, uint8_t(interface)}; }
+EthernetAddress hop_ethernet(const size_t hop) { return {0x02, 0, 0, 0, 2, uint8_t(hop)}; }
+
+class Stress {
+    Router _router{};
+    atomic<bool> _stopping{false};
+    atomic<uint64_t> _lookups{0};
+    atomic<uint64_t> _forwarded{0};
+    atomic<uint64_t> _updates{0};
+
+    mutex _failure_mutex{};
+    string _failure{};
+
+    void fail(const string &what) {
+        const lock_guard<mutex> lock(_failure_mutex);
+        if (_failure.empty()) {
+            _failure = what;
+        }
+        _stopping = true;
+    }
+
+    void add(const uint32_t prefix, const uint8_t length, const size_t hop) {
+        _router.add_route(prefix, length, Address::from_ipv4_numeric(hop_address(hop)), hop_interface(hop));
+    }
+
+    //! Check the next hop of `address`, which must be one of `hops`
+    bool check(const uint32_t address, const vector<uint32_t> &hops) {
+        const auto hop = _router.lookup(address);
+        for (const auto expected : hops) {
+            if (hop.has_value() and hop->address == hop_address(expected) and
+                hop->interface_num == hop_interface(expected)) {
+                return true;
+            }
+        }
+        fail("wrong next hop for " + Address::from_ipv4_numeric(address).ip() + ": " +
+             (hop.has_value() ? Address::from_ipv4_numeric(hop->address).ip() : "(none)"));
+        return false;
+    }
+
+    void read_loop(const uint32_t seed) {
+        mt19937 rng{seed};
+        uint64_t lookups = 0;
+        while (not _stopping) {
+            const size_t i = rng() % num_stable;
+            const uint32_t host = rng() & 0xffff;
+            if (not check(stable_prefix(i) | host, {uint32_t(i % num_hops)}) or
+                not check(probe_prefix(i % num_probes) | host, {PROBE_A, PROBE_B, DEFAULT_HOP})) {
+                return;
+            }
+            lookups += 2;
+        }
+        _lookups += lookups;
+    }
+
+    //! Route datagrams for the stable prefixes with Router::route(), checking where each frame went
+    void forward_loop() {
+        mt19937 rng{7};
+        uint64_t forwarded = 0;
+        while (not _stopping) {
+            vector<size_t> sent(num_interfaces);
+            for (size_t n = 0; n < 32; n++) {
+                const size_t i = rng() % num_stable;
+                InternetDatagram dgram;
+                dgram.header().src = interface_address(0);
+                dgram.header().dst = stable_prefix(i) | (rng() & 0xffff);
+                dgram.header().ttl = 64;
+                dgram.header().len = dgram.header().hlen * 4;
+                _router.interface(0).datagrams_out().push(dgram);
+                sent[hop_interface(i % num_hops)]++;
+            }
+            _router.route();
+            for (size_t interface = 0; interface < num_interfaces; interface++) {
+                auto &frames = _router.interface(interface).frames_out();
+                if (frames.size() != sent[interface]) {
+                    fail("interface " + to_string(interface) + " sent " + to_string(frames.size()) +
+                         " frames, not " + to_string(sent[interface]));
+                    return;
+                }
+                for (; not frames.empty(); frames.pop()) {
+                    const auto dst = frames.front().header().dst;
+                    if (dst != hop_ethernet(interface) and dst != hop_ethernet(interface + num_interfaces)) {
+                        fail("frame sent to " + to_string(dst) + " on interface " + to_string(interface));
+                        return;
+                    }
+                }
+            }
+            forwarded += 32;
+        }
+        _forwarded += forwarded;
+    }
+
+    void churn_loop() {
+        mt19937 rng{11};
+        vector<bool> filler(num_filler);
+        uint64_t updates = 0;
+        while (not _stopping) {
+            const size_t i = rng() % num_probes;
+            switch (rng() % 3) {
+                case 0:
+                    add(probe_prefix(i), 16, PROBE_A);
+                    break;
+                case 1:
+                    add(probe_prefix(i), 16, PROBE_B);
+                    break;
+                default:
+                    _router.remove_route(probe_prefix(i), 16);
+            }
+
+            const size_t j = rng() % num_filler;
+            if (filler[j]) {
+                _router.remove_route(filler_prefix(j), 24);
+            } else {
+                add(filler_prefix(j), 24, rng() % num_hops);
+            }
+            filler[j] = not filler[j];
+            updates += 2;
+
+            // pause now and then, so that a compiled table catches up and lookups use it too
+            if (updates % 2048 == 0) {
+                this_thread::sleep_for(milliseconds(100));
+            }
+        }
+        _updates += updates;
+    }
+
+  public:
+    Stress() {
+        for (size_t interface = 0; interface < num_interfaces; interface++) {
+            const auto address = Address::from_ipv4_numeric(interface_address(interface));
+            _router.add_interface(AsyncNetworkInterface{interface_ethernet(interface), address});
+        }
+
+        // teach each interface its next hops' Ethernet addresses, so that forwarding needs no ARP
+        for (size_t hop = 0; hop < num_hops; hop++) {
+            ARPMessage arp;
+            arp.opcode = ARPMessage::OPCODE_REQUEST;
+            arp.sender_ethernet_address = hop_ethernet(hop);
+            arp.sender_ip_address = hop_address(hop);
+            arp.target_ip_address = interface_address(hop_interface(hop));
+            EthernetFrame frame;
+            frame.header() = {ETHERNET_BROADCAST, hop_ethernet(hop), EthernetHeader::TYPE_ARP};
+            frame.payload().append(arp.serialize());
+            _router.interface(hop_interface(hop)).recv_frame(frame);
+        }
+        for (size_t interface = 0; interface < num_interfaces; interface++) {
+            _router.interface(interface).frames_out() = {};
+        }
+
+        // route() caches its lookups, while the routes keep changing under the cache
+        _router.set_flow_cache_size(256);
+
+        add(0, 0, DEFAULT_HOP);
+        for (size_t i = 0; i < num_stable; i++) {
+            add(stable_prefix(i), 16, i % num_hops);
+        }
+    }
+
+    //! Run for `length`, compiling the routes partway through if `compile`
+    void run(const string &name, const milliseconds length, const bool compile) {
+        _lookups = _forwarded = _updates = 0;
+        vector<thread> threads;
+        for (size_t i = 0; i < num_readers; i++) {
+            threads.emplace_back([this, i] { read_loop(i); });
+        }
+        threads.emplace_back([this] { forward_loop(); });
+        threads.emplace_back([this] { churn_loop(); });
+
+        const auto start = steady_clock::now();
+        if (compile) {
+            this_thread::sleep_for(length / 4);
+            _router.compile_routes();
+        }
+        this_thread::sleep_until(start + length);
+        _stopping = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        _stopping = false;
+        if (not _failure.empty()) {
+            throw runtime_error(name + ": " + _failure);
+        }
+
+        const double seconds = duration<double>(steady_clock::now() - start).count();
+        cout << setw(8) << name << fixed << setprecision(2) << setw(14) << _lookups / seconds / 1e6 << setw(14)
+             << _forwarded / seconds / 1e6 << setw(14) << _updates / seconds / 1e3 << "\n";
+    }
+};
+
+int main() {
+    try {
+        cout << "    mode   M lookups/s M forwarded/s   k updates/s\n";
+        {
+            Stress stress;
+            stress.run("trie", milliseconds(1000), false);
+            stress.run("compiled", milliseconds(1500), true);
+        }
+
+        Epoch::reclaim();
+        if (Epoch::pending() != 0) {
+            throw runtime_error(to_string(Epoch::pending()) + " retired objects never freed");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
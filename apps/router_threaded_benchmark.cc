@@ -0,0 +1,242 @@
+#include "router.hh"
+#include "threaded_router.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// A network like network_simulator's, with one host on each of a router's interfaces, every host sending
+// to every other: datagrams forwarded per second by a ThreadedRouter, as the number of interfaces grows.
+// First, a check that the workers keep their interfaces' clocks running: an ARP request the router sends
+// is lost, and must be sent again.
+
+auto rd = get_random_generator();
+
+EthernetAddress random_ethernet_address(const uint8_t first) {
+    EthernetAddress addr;
+    for (auto &byte : addr) {
+        byte = rd();
+    }
+    addr.at(0) = first;  // "10" in last two binary digits marks a private Ethernet address
+    return addr;
+}
+
+Address host_address(const size_t n) { return Address{"10.0." + to_string(n) + ".2"}; }
+Address router_address(const size_t n) { return Address{"10.0." + to_string(n) + ".1"}; }
+
+//! A host on one of the router's interfaces, which sends prepared frames as fast as the router takes them
+class Host {
+    size_t _n;
+    EthernetAddress _ethernet_address;
+    AsyncNetworkInterface _interface;
+    vector<EthernetFrame> _frames{};  //!< A frame to each other host
+    size_t _next = 0;
+    size_t _sent = 0;
+    size_t _received = 0;
+    size_t _misdelivered = 0;
+
+  public:
+    Host(const size_t n, const size_t hosts)
+        : _n(n), _ethernet_address(random_ethernet_address(0x02)), _interface(_ethernet_address, host_address(n)) {
+        for (size_t m = 0; m < hosts; m++) {
+            if (m == n) {
+                continue;
+            }
+            InternetDatagram dgram;
+            dgram.header().src = host_address(n).ipv4_numeric();
+            dgram.header().dst = host_address(m).ipv4_numeric();
+            dgram.header().ttl = 64;
+            dgram.payload() = string(64, 'x');
+            dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+            _interface.send_datagram(dgram, router_address(n));
+        }
+    }
+
+    //! Learn the router's Ethernet address (as the router learns the host's), then keep the frames the
+    //! interface sent once it knew it
+    void connect(ThreadedRouter &router, const size_t hosts) {
+        for (; not _interface.frames_out().empty(); _interface.frames_out().pop()) {
+            auto &frame = _interface.frames_out().front();
+            frame.payload() = frame.payload().concatenate();  // as it would arrive off the wire
+            if (not router.deliver(_n, move(frame))) {
+                throw runtime_error("router would not take an ARP request");
+            }
+        }
+        const auto deadline = steady_clock::now() + seconds(5);
+        while (_frames.size() < hosts - 1) {
+            if (steady_clock::now() > deadline) {
+                throw runtime_error("host " + to_string(_n) + " never heard back from the router");
+            }
+            if (auto frame = router.collect(_n)) {
+                _interface.recv_frame(frame.value());
+            }
+            for (; not _interface.frames_out().empty(); _interface.frames_out().pop()) {
+                _frames.push_back(_interface.frames_out().front());
+                _frames.back().payload() = _frames.back().payload().concatenate();
+            }
+        }
+    }
+
+    //! Send until the router's ring is full (or a burst has gone), and take what arrived
+    void run_once(ThreadedRouter &router) {
+        for (size_t burst = 0; burst < 32; burst++) {
+            EthernetFrame frame = _frames[_next];
+            if (not router.deliver(_n, move(frame))) {
+                break;
+            }
+            _next = (_next + 1) % _frames.size();
+            _sent++;
+        }
+        while (auto frame = router.collect(_n)) {
+            _received++;
+            _misdelivered += frame->header().dst != _ethernet_address;
+        }
+    }
+
+    size_t sent() const { return _sent; }
+    size_t received() const { return _received; }
+    size_t misdelivered() const { return _misdelivered; }
+};
+
+//! Take the next frame the router sends to host `n`, waiting for it until `deadline`
+EthernetFrame await_frame(ThreadedRouter &router, const size_t n, const steady_clock::time_point deadline) {
+    while (steady_clock::now() < deadline) {
+        if (auto frame = router.collect(n)) {
+            frame->payload() = frame->payload().concatenate();
+            return move(frame.value());
+        }
+        this_thread::yield();
+    }
+    throw runtime_error("host " + to_string(n) + " heard nothing from the router");
+}
+
+//! Host 0 sends to host 1, which the router has not heard from; the router's first ARP request is lost
+void check_lost_arp_request() {
+    Router router;
+    for (size_t n = 0; n < 2; n++) {
+        router.add_interface(AsyncNetworkInterface{random_ethernet_address(0x02), router_address(n)});
+        router.add_route(host_address(n).ipv4_numeric() & 0xffffff00, 24, {}, n);
+    }
+    router.compile_routes();
+    Host sender{0, 2};
+    AsyncNetworkInterface receiver{random_ethernet_address(0x02), host_address(1)};
+
+    ThreadedRouter threaded{router};
+    sender.connect(threaded, 2);
+    sender.run_once(threaded);
+
+    constexpr auto arp_timeout = seconds(5);  // NetworkInterface::ARP_TIMEOUT
+    await_frame(threaded, 1, steady_clock::now() + seconds(1));  // lost
+    const auto lost_at = steady_clock::now();
+    const EthernetFrame request = await_frame(threaded, 1, lost_at + arp_timeout + seconds(2));
+    const double resent_after = duration<double>(steady_clock::now() - lost_at).count();
+    if (request.header().type != EthernetHeader::TYPE_ARP or resent_after < 0.9 * arp_timeout.count()) {
+        throw runtime_error("the router did not wait for its ARP request to time out");
+    }
+
+    // this time host 1 answers, and the datagrams waiting on it get through
+    receiver.recv_frame(request);
+    for (; not receiver.frames_out().empty(); receiver.frames_out().pop()) {
+        auto &frame = receiver.frames_out().front();
+        frame.payload() = frame.payload().concatenate();
+        if (not threaded.deliver(1, move(frame))) {
+            throw runtime_error("router would not take an ARP reply");
+        }
+    }
+    const auto deadline = steady_clock::now() + seconds(1);
+    while (receiver.datagrams_out().empty()) {
+        receiver.recv_frame(await_frame(threaded, 1, deadline));
+    }
+    cout << "A lost ARP request was sent again after " << fixed << setprecision(1) << resent_after << " s\n\n";
+}
+
+void run(const size_t hosts, const milliseconds length) {
+    Router router;
+    for (size_t n = 0; n < hosts; n++) {
+        router.add_interface(AsyncNetworkInterface{random_ethernet_address(0x02), router_address(n)});
+        router.add_route(host_address(n).ipv4_numeric() & 0xffffff00, 24, {}, n);
+    }
+    router.compile_routes();
+
+    vector<unique_ptr<Host>> network;
+    for (size_t n = 0; n < hosts; n++) {
+        network.push_back(make_unique<Host>(n, hosts));
+    }
+
+    ThreadedRouter threaded{router};
+    for (auto &host : network) {
+        host->connect(threaded, hosts);
+    }
+
+    atomic<bool> stopping{false};
+    vector<thread> threads;
+    for (auto &host : network) {
+        threads.emplace_back([&stopping, &threaded, &host] {
+            while (not stopping) {
+                host->run_once(threaded);
+            }
+        });
+    }
+    this_thread::sleep_for(length / 4);  // warm up
+    const size_t forwarded_before = threaded.forwarded();
+    const auto start = steady_clock::now();
+    this_thread::sleep_for(length);
+    const size_t forwarded = threaded.forwarded() - forwarded_before;
+    const double time = duration<double>(steady_clock::now() - start).count();
+    stopping = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    size_t sent = 0, received = 0;
+    for (const auto &host : network) {
+        sent += host->sent();
+        received += host->received();
+        if (host->misdelivered() != 0) {
+            throw runtime_error("a host received frames meant for someone else");
+        }
+    }
+    if (received == 0) {
+        throw runtime_error("nothing got through");
+    }
+
+    cout << setw(10) << hosts << fixed << setprecision(3) << setw(12) << forwarded / time / 1e6 << setw(12)
+         << forwarded / time / 1e6 / hosts << setw(13) << sent << setw(13) << received << setw(11)
+         << threaded.dropped() << "\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        vector<size_t> counts{2, 4, 8};
+        if (argc > 1) {
+            counts.clear();
+            for (int i = 1; i < argc; i++) {
+                counts.push_back(stoul(argv[i]));
+            }
+        }
+
+        check_lost_arp_request();
+
+        cout << "(" << thread::hardware_concurrency() << " CPUs; one worker per interface, and a thread per host)\n"
+             << "interfaces      Mpps   Mpps/core    host sent     received    dropped\n";
+        for (const auto count : counts) {
+            run(count, milliseconds(1000));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
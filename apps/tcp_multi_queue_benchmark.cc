@@ -0,0 +1,93 @@
+#include "socket.hh"
+#include "tcp_sponge_socket.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t bytes_per_connection = 1024 * 1024;
+
+void show_usage(const char *argv0) {
+    cerr << "Usage: " << argv0 << " <tundev> <local address> <server address> <queues> <connections>\n\n"
+         << "Sends " << bytes_per_connection << " bytes on each of <connections> concurrent connections, from\n"
+         << "<local address> over the queues of <tundev>, to a kernel TCP socket on <server address>.\n"
+         << "The device must be multi-queue, e.g. (as root):\n\n"
+         << "   ip tuntap add mode tun multi_queue user $USER name tun146\n"
+         << "   ip addr add 169.254.146.1/24 dev tun146 && ip link set dev tun146 up\n\n"
+         << "and then: " << argv0 << " tun146 169.254.146.9 169.254.146.1 4 64\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 6) {
+            show_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const string local_address = argv[2];
+        const size_t queues = stoul(argv[4]);
+        const size_t connections = stoul(argv[5]);
+
+        // the kernel side: accept every connection and count what arrives
+        TCPSocket server;
+        server.set_reuseaddr();
+        server.bind(Address(argv[3], 0));
+        server.listen(int(connections));
+        const Address server_address = server.local_address();
+
+        atomic<size_t> bytes_received{0};
+        thread acceptor([&] {
+            vector<thread> readers;
+            for (size_t i = 0; i < connections; i++) {
+                readers.emplace_back([&, sock = server.accept()]() mutable {
+                    while (not sock.eof()) {
+                        bytes_received += sock.read_buffer().size();
+                    }
+                });
+            }
+            for (auto &reader : readers) {
+                reader.join();
+            }
+        });
+
+        // our side: one TCPSpongeSocket per connection, all sharing the device's queues
+        const auto device = make_shared<MultiQueueTun>(argv[1], queues);
+        const auto start = steady_clock::now();
+        vector<thread> senders;
+        for (size_t i = 0; i < connections; i++) {
+            senders.emplace_back([&, i] {
+                TCPOverIPv4OverMultiQueueTunSpongeSocket sock{TCPOverIPv4OverMultiQueueTunAdapter(device)};
+                FdAdapterConfig adapter_config;
+                adapter_config.source = {local_address, to_string(20000 + i)};
+                adapter_config.destination = server_address;
+                sock.connect({}, adapter_config);
+                sock.write(string(bytes_per_connection, 'x'));
+                sock.wait_until_closed();
+            });
+        }
+        for (auto &sender : senders) {
+            sender.join();
+        }
+        acceptor.join();
+        const duration<double> elapsed = steady_clock::now() - start;
+
+        if (bytes_received != connections * bytes_per_connection) {
+            throw runtime_error("received " + to_string(bytes_received) + " bytes");
+        }
+        cout << fixed << setprecision(1) << connections << " connections over " << queues << " queues: "
+             << 8 * bytes_received / elapsed.count() / 1e6 << " Mbit/s\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "tcp_connection.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t len = 32 * 1024 * 1024;
+
+//! \name Global allocation counters
+//! Every heap allocation made by the process goes through the replaced operator new below,
+//! so the difference between two snapshots is the allocator traffic of the code in between.
+//!@{
+static size_t allocations = 0;
+static size_t bytes_allocated = 0;
+//!@}
+
+void *operator new(size_t size) {
+    ++allocations;
+    bytes_allocated += size;
+    if (void *ptr = malloc(size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+struct Counters {
+    size_t allocations;
+    size_t bytes;
+    size_t segments;
+};
+
+//! Drain `x`'s outbound queue through serialize/parse (as a real adapter would) into `y`
+size_t move_segments(TCPConnection &x, TCPConnection &y) {
+    size_t n = 0;
+    while (not x.segments_out().empty()) {
+        TCPSegment seg{move(x.segments_out().front())};
+        x.segments_out().pop();
+
+        TCPSegment wire;
+        if (wire.parse(seg.serialize().concatenate()) != ParseResult::NoError) {
+            throw runtime_error("segment failed to round-trip");
+        }
+        y.segment_received(wire);
+        ++n;
+    }
+    return n;
+}
+
+Counters run() {
+    TCPConfig config;
+    TCPConnection x{config}, y{config};
+
+    const string string_to_send(len, 'x');
+    string_view bytes_to_send{string_to_send};
+
+    x.connect();
+    y.end_input_stream();
+    bool x_closed = false;
+
+    Counters before{allocations, bytes_allocated, 0};
+    size_t segments = 0;
+
+    while (not y.inbound_stream().eof()) {
+        while (bytes_to_send.size() and x.remaining_outbound_capacity()) {
+            const auto want = min(x.remaining_outbound_capacity(), bytes_to_send.size());
+            x.write(string(bytes_to_send.substr(0, want)));
+            bytes_to_send.remove_prefix(want);
+        }
+        if (bytes_to_send.empty() and not x_closed) {
+            x.end_input_stream();
+            x_closed = true;
+        }
+
+        segments += move_segments(x, y);
+        segments += move_segments(y, x);
+
+        y.inbound_stream().pop_output(y.inbound_stream().buffer_size());
+
+        x.tick(1);
+        y.tick(1);
+    }
+
+    const Counters ret{allocations - before.allocations, bytes_allocated - before.bytes, segments};
+
+    // let both sides finish closing (not counted)
+    while (x.active() or y.active()) {
+        move_segments(x, y);
+        move_segments(y, x);
+        x.tick(1000);
+        y.tick(1000);
+    }
+
+    return ret;
+}
+
+int main() {
+    try {
+        const auto first_time = high_resolution_clock::now();
+        const auto counters = run();
+        const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - first_time).count();
+
+        cout << fixed << setprecision(2);
+        cout << "segments through pipeline : " << counters.segments << "\n";
+        cout << "ns per segment            : " << double(duration) / counters.segments << "\n";
+        cout << "allocations per segment   : " << double(counters.allocations) / counters.segments << "\n";
+        cout << "bytes allocated per segment: " << double(counters.bytes) / counters.segments << "\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#include "sharded_tcp_stack.hh"
+#include "socket.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t echo_port = 7;
+constexpr size_t bytes_per_connection = 4096;
+constexpr size_t client_threads = 8;
+
+void show_usage(const char *argv0) {
+    cerr << "Usage: " << argv0 << " <tundev> <stack address> <connections>\n\n"
+         << "Runs an echo server on a ShardedTCPStack with 1, 2, 4 and 8 shards, listening on <stack address>\n"
+         << "port " << echo_port << " of <tundev>. For each, " << client_threads << " threads of kernel TCP clients "
+         << "open <connections> connections\n"
+         << "in total, then each connection sends " << bytes_per_connection << " bytes and reads them back.\n"
+         << "The device must be multi-queue, e.g. (as root):\n\n"
+         << "   ip tuntap add mode tun multi_queue user $USER name tun148\n"
+         << "   ip addr add 169.254.148.1/24 dev tun148 && ip link set dev tun148 up\n"
+         << "   ip link set dev tun148 txqueuelen 10000\n\n"
+         << "and then: " << argv0 << " tun148 169.254.148.9 1000\n";
+}
+
+//! Echo what a connection receives, and close it once the peer has finished and everything is echoed
+void echo(TCPStack &stack, const TCPStack::SocketId id) {
+    const size_t amount = min(stack.bytes_readable(id), stack.remaining_outbound_capacity(id));
+    if (amount > 0) {
+        stack.write(id, stack.read(id, amount));
+    }
+    if (stack.eof(id)) {
+        stack.close(id);
+    }
+}
+
+//! Run `connections` kernel clients against the server, and report connection and echo rates
+void run(const string &devname, const Address &server_address, const size_t shards, const size_t connections) {
+    atomic<size_t> accepted{0};
+    ShardedTCPStack stacks{devname, shards, {}, [&](TCPStack &stack, const size_t) {
+                               const auto listener = stack.listen(server_address, connections);
+                               stack.set_callback(listener, [&stack, &accepted, listener] {
+                                   while (const auto id = stack.accept(listener)) {
+                                       accepted++;
+                                       stack.set_callback(id.value(), [&stack, id = id.value()] { echo(stack, id); });
+                                       echo(stack, id.value());
+                                   }
+                               });
+                           }};
+
+    // each client thread's share of the connections
+    vector<vector<TCPSocket>> socks(client_threads);
+    const auto in_parallel = [&](const function<void(const size_t, vector<TCPSocket> &)> &work) {
+        const auto start = steady_clock::now();
+        vector<thread> threads;
+        for (size_t t = 0; t < client_threads; t++) {
+            threads.emplace_back([&, t] { work(t, socks[t]); });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        return duration<double>(steady_clock::now() - start).count();
+    };
+
+    atomic<size_t> errors{0};
+    const double connect_time = in_parallel([&](const size_t t, vector<TCPSocket> &mine) {
+        const size_t share = connections / client_threads + (t < connections % client_threads ? 1 : 0);
+        for (size_t i = 0; i < share; i++) {
+            mine.emplace_back();
+            mine.back().connect(server_address);
+        }
+    });
+
+    atomic<size_t> bytes_echoed{0};
+    const double echo_time = in_parallel([&](const size_t, vector<TCPSocket> &mine) {
+        const string data(bytes_per_connection, 'x');
+        for (auto &sock : mine) {
+            sock.write(data);
+            sock.shutdown(SHUT_WR);
+        }
+        for (auto &sock : mine) {
+            size_t received = 0;
+            while (not sock.eof()) {
+                received += sock.read_buffer().size();
+            }
+            bytes_echoed += received;
+            errors += received != bytes_per_connection;
+        }
+    });
+
+    if (accepted != connections or errors > 0) {
+        throw runtime_error(to_string(shards) + " shards: accepted " + to_string(accepted) + " of " +
+                            to_string(connections) + " connections, " + to_string(errors) + " echoed wrongly");
+    }
+    cout << setw(6) << shards << setw(14) << fixed << setprecision(0) << connections / connect_time << setw(16)
+         << setprecision(1) << 8 * bytes_echoed / echo_time / 1e6 << setw(14) << stacks.forwarded() << "\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 4) {
+            show_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const Address server_address{argv[2], echo_port};
+        const size_t connections = stoul(argv[3]);
+
+        cout << connections << " connections, " << thread::hardware_concurrency() << " CPUs\n";
+        cout << "shards   connects/s   echo Mbit/s   forwarded\n";
+        for (const size_t shards : {1, 2, 4, 8}) {
+            run(argv[1], server_address, shards, connections);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "shared_memory_adapter.hh"
+#include "tcp_config.hh"
+#include "tcp_sponge_socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t server_port = 1000;
+constexpr uint16_t client_port = 2000;
+
+void show_usage(const char *argv0) {
+    cerr << "Usage: " << argv0 << " [-p] [-n <MiB>] [-L <loss>] [-R <reorder>]\n\n"
+         << "Sends <MiB> (default 100) MiB between two TCPSpongeSockets joined by a SharedMemoryLink.\n\n"
+         << "   -p             Run the receiver in a child process (default: in a thread of this process)\n"
+         << "   -L <loss>      Drop segments in each direction at rate <loss> (float in 0..1)\n"
+         << "   -R <reorder>   Hold segments back until after the next at rate <reorder> (float in 0..1)\n";
+}
+
+//! A rate in 0..1 as a fraction of 65536, as FdAdapterConfig stores it
+uint16_t to_rate(const char *arg) {
+    const double rate = stod(arg);
+    if (rate < 0 or rate > 1) {
+        throw runtime_error("rates must be between 0 and 1");
+    }
+    return static_cast<uint16_t>(min(rate * 65536, 65535.0));
+}
+
+//! Accept a connection on end 1 of the link, read everything sent on it, and report the throughput
+void receive(const shared_ptr<SharedMemoryLink> &link, const TCPConfig &tcp_config, FdAdapterConfig adapter_config) {
+    LossyTCPOverSharedMemorySpongeSocket sock{LossyTCPOverSharedMemoryAdapter{TCPOverSharedMemoryAdapter{link, 1}}};
+    adapter_config.source = {"0", server_port};
+    sock.listen_and_accept(tcp_config, adapter_config);
+
+    const auto start = steady_clock::now();
+    size_t received = 0;
+    while (not sock.eof()) {
+        received += sock.read_buffer().size();
+    }
+    const double seconds = duration<double>(steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(1) << "received " << received << " bytes in " << setprecision(3) << seconds
+         << " s: " << setprecision(1) << 8 * received / seconds / 1e6 << " Mbit/s\n";
+    sock.wait_until_closed();
+}
+
+//! Connect from end 0 of the link and send `length` bytes
+void send(const shared_ptr<SharedMemoryLink> &link,
+          const TCPConfig &tcp_config,
+          FdAdapterConfig adapter_config,
+          const size_t length) {
+    LossyTCPOverSharedMemorySpongeSocket sock{LossyTCPOverSharedMemoryAdapter{TCPOverSharedMemoryAdapter{link, 0}}};
+    adapter_config.source = {"0", client_port};
+    adapter_config.destination = {"0", server_port};
+    sock.connect(tcp_config, adapter_config);
+
+    const string chunk(64 * 1024, 'x');
+    for (size_t sent = 0; sent < length; sent += chunk.size()) {
+        sock.write(string_view(chunk).substr(0, min(chunk.size(), length - sent)));
+    }
+    sock.shutdown(SHUT_WR);
+    sock.wait_until_closed();
+}
+
+int main(int argc, char **argv) {
+    try {
+        bool processes = false;
+        size_t length = 100 * 1024 * 1024;
+        FdAdapterConfig adapter_config{};
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "-p") == 0) {
+                processes = true;
+            } else if (strcmp(argv[i], "-n") == 0 and i + 1 < argc) {
+                length = stoul(argv[++i]) * 1024 * 1024;
+            } else if (strcmp(argv[i], "-L") == 0 and i + 1 < argc) {
+                adapter_config.loss_rate_up = adapter_config.loss_rate_dn = to_rate(argv[++i]);
+            } else if (strcmp(argv[i], "-R") == 0 and i + 1 < argc) {
+                adapter_config.reorder_rate = to_rate(argv[++i]);
+            } else {
+                show_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        TCPConfig tcp_config{};
+        tcp_config.rt_timeout = 10;  // the link's round trip takes microseconds
+
+        const auto link = make_shared<SharedMemoryLink>();
+        if (processes) {
+            const pid_t child = SystemCall("fork", fork());
+            if (child == 0) {
+                receive(link, tcp_config, adapter_config);
+                _exit(EXIT_SUCCESS);
+            }
+            send(link, tcp_config, adapter_config, length);
+            int status = 0;
+            SystemCall("waitpid", waitpid(child, &status, 0));
+            return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+        }
+
+        thread receiver([&] { receive(link, tcp_config, adapter_config); });
+        send(link, tcp_config, adapter_config, length);
+        receiver.join();
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#include "socket.hh"
+#include "tcp_stack.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t echo_port = 7;
+constexpr size_t bytes_per_connection = 4096;
+
+void show_usage(const char *argv0) {
+    cerr << "Usage: " << argv0 << " <tundev> <stack address> <connections>\n\n"
+         << "Runs an echo server for <connections> concurrent connections on a single TCPStack (one thread),\n"
+         << "listening on <stack address> port " << echo_port << " of <tundev>. The clients are kernel TCP\n"
+         << "sockets: all of them connect first, then each sends " << bytes_per_connection
+         << " bytes and reads them back. The device must exist, e.g. (as root):\n\n"
+         << "   ip tuntap add mode tun user $USER name tun147\n"
+         << "   ip addr add 169.254.147.1/24 dev tun147 && ip link set dev tun147 up\n"
+         << "   ip link set dev tun147 txqueuelen 10000   # the clients' first bursts overflow the default\n\n"
+         << "and then: " << argv0 << " tun147 169.254.147.9 1000\n";
+}
+
+//! Echo what a connection receives, and close it once the peer has finished and everything is echoed
+void echo(TCPStack &stack, const TCPStack::SocketId id) {
+    const size_t amount = min(stack.bytes_readable(id), stack.remaining_outbound_capacity(id));
+    if (amount > 0) {
+        stack.write(id, stack.read(id, amount));
+    }
+    if (stack.eof(id)) {
+        stack.close(id);
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 4) {
+            show_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const Address server_address{argv[2], echo_port};
+        const size_t connections = stoul(argv[3]);
+
+        // the server: every connection on one stack, served by this thread
+        TCPStack stack{TunFD(argv[1])};
+        const auto listener = stack.listen(server_address, connections);
+        size_t accepted = 0;
+        size_t peak = 0;
+        stack.set_callback(listener, [&] {
+            while (const auto id = stack.accept(listener)) {
+                accepted++;
+                stack.set_callback(id.value(), [&stack, id = id.value()] { echo(stack, id); });
+                echo(stack, id.value());
+            }
+            peak = max(peak, stack.connection_count());
+        });
+
+        // the clients: kernel sockets, connected all at once
+        atomic<bool> done{false};
+        duration<double> connect_time{};
+        duration<double> echo_time{};
+        thread clients([&] {
+            try {
+                const auto start = steady_clock::now();
+                vector<TCPSocket> socks(connections);
+                for (auto &sock : socks) {
+                    sock.connect(server_address);
+                }
+                const auto connected = steady_clock::now();
+
+                const string data(bytes_per_connection, 'x');
+                for (auto &sock : socks) {
+                    sock.write(data);
+                    sock.shutdown(SHUT_WR);
+                }
+                for (auto &sock : socks) {
+                    size_t received = 0;
+                    while (not sock.eof()) {
+                        received += sock.read_buffer().size();
+                    }
+                    if (received != bytes_per_connection) {
+                        throw runtime_error("echoed " + to_string(received) + " bytes");
+                    }
+                }
+                connect_time = connected - start;
+                echo_time = steady_clock::now() - connected;
+            } catch (const exception &e) {
+                cerr << "Client: " << e.what() << "\n";
+            }
+            done = true;
+        });
+
+        while (not done) {
+            stack.wait_next_event(100);
+        }
+        clients.join();
+
+        // let the last connections finish closing
+        const auto deadline = steady_clock::now() + seconds(1);
+        while (stack.connection_count() > 0 and steady_clock::now() < deadline) {
+            stack.wait_next_event(100);
+        }
+        if (accepted != connections or echo_time == echo_time.zero()) {
+            throw runtime_error("accepted " + to_string(accepted) + " of " + to_string(connections) +
+                                " connections");
+        }
+
+        cout << fixed << setprecision(0) << connections << " connections on one thread: "
+             << connections / connect_time.count() << " connects/s, " << setprecision(1)
+             << 8 * connections * bytes_per_connection / echo_time.count() / 1e6 << " Mbit/s echoed; " << peak
+             << " connections open at once\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
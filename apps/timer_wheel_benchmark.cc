@@ -0,0 +1,125 @@
+#include "eventloop.hh"
+#include "timing_wheel.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t connections = 100000;
+constexpr uint64_t rto_ms = 1000;        // each connection's timer is restarted for this long
+constexpr uint64_t simulated_ms = 10000;  // length of the simulated run
+
+//! Restart a random connection's retransmission timer `rearms_per_ms` times per simulated millisecond (as when
+//! segments are acknowledged), and
+//! pass the time the way the tick-based components do: by scanning every connection's deadline each tick
+double run_scan(const size_t rearms_per_ms) {
+    minstd_rand rng{1};
+    vector<uint64_t> deadlines(connections, rto_ms);
+    size_t fired = 0;
+
+    const auto start = steady_clock::now();
+    for (uint64_t now = 1; now <= simulated_ms; now++) {
+        for (size_t i = 0; i < rearms_per_ms; i++) {
+            deadlines[rng() % connections] = now + rto_ms;
+        }
+        for (auto &deadline : deadlines) {
+            if (deadline <= now) {
+                fired++;
+                deadline = UINT64_MAX;  // re-armed on the next restart
+            }
+        }
+    }
+    const duration<double> elapsed = steady_clock::now() - start;
+    if (fired == 0) {
+        throw runtime_error("no timers fired");
+    }
+    return elapsed.count() * 1e9 / simulated_ms;
+}
+
+//! The same workload with a TimingWheel: a restart is a cancel and an add, and a tick only touches what expires
+double run_wheel(const size_t rearms_per_ms) {
+    minstd_rand rng{1};
+    TimingWheel wheel{0};
+    vector<TimingWheel::TimerId> timers(connections);
+    size_t fired = 0;
+
+    const auto arm = [&](const size_t connection, const uint64_t now) {
+        wheel.cancel(timers[connection]);
+        timers[connection] = wheel.add(now + rto_ms, [&, connection] {
+            fired++;
+            timers[connection] = {};  // re-armed on the next restart
+        });
+    };
+    for (size_t c = 0; c < connections; c++) {
+        arm(c, 0);
+    }
+
+    const auto start = steady_clock::now();
+    for (uint64_t now = 1; now <= simulated_ms; now++) {
+        for (size_t i = 0; i < rearms_per_ms; i++) {
+            arm(rng() % connections, now);
+        }
+        wheel.advance(now);
+    }
+    const duration<double> elapsed = steady_clock::now() - start;
+    if (fired == 0) {
+        throw runtime_error("no timers fired");
+    }
+    return elapsed.count() * 1e9 / simulated_ms;
+}
+
+//! Add `connections` timers with delays spread over two seconds to an EventLoop, and measure how late they fire
+void run_eventloop() {
+    EventLoop loop{};
+    minstd_rand rng{1};
+    double total_lateness = 0;
+    uint64_t max_lateness = 0;
+    size_t fired = 0;
+
+    for (size_t c = 0; c < connections; c++) {
+        const uint64_t delay = rng() % 2000;
+        const uint64_t expiry = timestamp_ms() + delay;
+        loop.add_timer(delay, [&, expiry] {
+            const uint64_t lateness = timestamp_ms() - expiry;
+            total_lateness += lateness;
+            max_lateness = max(max_lateness, lateness);
+            fired++;
+        });
+    }
+
+    size_t waits = 0;
+    while (loop.wait_next_event(-1) != EventLoop::Result::Exit) {
+        waits++;
+    }
+    if (fired != connections) {
+        throw runtime_error("not every timer fired");
+    }
+    cout << "EventLoop: " << connections << " timers over 2 s fired in " << waits << " waits, "
+         << setprecision(2) << total_lateness / fired << " ms late on average (at most " << max_lateness
+         << " ms)\n";
+}
+
+int main() {
+    try {
+        cout << fixed << setprecision(0);
+        cout << connections << " connections, ns per simulated ms:\n";
+        cout << "   restarts/ms   scan every deadline each tick   timing wheel\n";
+        for (const size_t rearms_per_ms : {10, 100, 1000}) {
+            cout << setw(14) << rearms_per_ms << setw(32) << run_scan(rearms_per_ms) << setw(15)
+                 << run_wheel(rearms_per_ms) << "\n";
+        }
+        run_eventloop();
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t datagram_size = 64;
+constexpr size_t batch = 256;
+constexpr size_t rounds = 2000;
+
+//! Send `batch` small datagrams from `tx` to `rx` with `send`, then receive them all with `receive`
+//! (which returns the number of datagrams it took); returns send and receive rates in datagrams/s
+template <typename SendT, typename ReceiveT>
+pair<double, double> run(UDPSocket &tx, UDPSocket &rx, const SendT &send, const ReceiveT &receive) {
+    const string payload(datagram_size, 'x');
+    const vector<BufferViewList> payloads(batch, payload);
+    nanoseconds sending{0}, receiving{0};
+
+    for (size_t round = 0; round < rounds; round++) {
+        auto start = steady_clock::now();
+        send(tx, payloads);
+        sending += steady_clock::now() - start;
+
+        start = steady_clock::now();
+        for (size_t received = 0; received < batch;) {
+            received += receive(rx);
+        }
+        receiving += steady_clock::now() - start;
+    }
+
+    const double datagrams = rounds * batch;
+    return {datagrams / duration<double>(sending).count(), datagrams / duration<double>(receiving).count()};
+}
+
+void check_size(const size_t size) {
+    if (size != datagram_size) {
+        throw runtime_error("short datagram");
+    }
+}
+
+int main() {
+    try {
+        UDPSocket rx, tx;
+        rx.bind(Address("127.0.0.1", 0));
+        tx.connect(rx.local_address());
+
+        const auto one_at_a_time = [](UDPSocket &sock, const vector<BufferViewList> &payloads) {
+            for (const auto &payload : payloads) {
+                sock.send(payload);
+            }
+        };
+        const auto batched = [](UDPSocket &sock, const vector<BufferViewList> &payloads) { sock.send_batch(payloads); };
+
+        const auto with_string = run(tx, rx, one_at_a_time, [](UDPSocket &sock) {
+            check_size(sock.recv().payload.size());
+            return 1;
+        });
+        const auto with_buffer = run(tx, rx, one_at_a_time, [](UDPSocket &sock) {
+            check_size(sock.recv_buffer().payload.size());
+            return 1;
+        });
+        const auto receive_batch = [](UDPSocket &sock) {
+            const auto datagrams = sock.recv_batch(batch);
+            for (const auto &datagram : datagrams) {
+                check_size(datagram.payload.size());
+            }
+            return datagrams.size();
+        };
+        const auto with_batch = run(tx, rx, batched, receive_batch);
+
+        // the same again, letting the kernel coalesce the datagrams on both sides
+        UDPSocket offload_rx, offload_tx;
+        offload_rx.bind(Address("127.0.0.1", 0));
+        offload_tx.connect(offload_rx.local_address());
+        if (not offload_tx.enable_gso() or not offload_rx.enable_gro()) {
+            throw runtime_error("UDP GSO/GRO not supported");
+        }
+        const auto with_offload = run(offload_tx, offload_rx, batched, receive_batch);
+
+        cout << fixed << setprecision(0);
+        cout << "send()         : " << with_buffer.first << " datagrams/s\n";
+        cout << "send_batch()   : " << with_batch.first << " datagrams/s\n";
+        cout << "  ... with GSO : " << with_offload.first << " datagrams/s\n";
+        cout << "recv()         : " << with_string.second << " datagrams/s\n";
+        cout << "recv_buffer()  : " << with_buffer.second << " datagrams/s\n";
+        cout << "recv_batch()   : " << with_batch.second << " datagrams/s\n";
+        cout << "  ... with GRO : " << with_offload.second << " datagrams/s\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -18,3 +18,9 @@ endif ()
 set (CMAKE_CXX_FLAGS_DEBUG "-O0 ${CMAKE_CXX_FLAGS_DEBUG} -ggdb3")
 set (CMAKE_CXX_FLAGS_DEBUGASAN "${CMAKE_CXX_FLAGS_DEBUG} -fsanitize=undefined -fsanitize=address")
 set (CMAKE_CXX_FLAGS_RELASAN "${CMAKE_CXX_FLAGS_RELEASE} -fsanitize=undefined -fsanitize=address")
+
+# Buffer reference counts are atomic by default; a program that never shares a Buffer between threads can opt out
+option (SPONGE_BUFFER_NONATOMIC_REFCOUNT "Use non-atomic Buffer reference counts (single-threaded use only)" OFF)
+if (SPONGE_BUFFER_NONATOMIC_REFCOUNT)
+    add_definitions (-DSPONGE_BUFFER_NONATOMIC_REFCOUNT)
+endif ()
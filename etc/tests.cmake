@@ -40,8 +40,10 @@ add_test(NAME t_byte_stream_many_writes  COMMAND byte_stream_many_writes)
 add_test(NAME t_webget               COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh")
 
 add_test(NAME arp_network_interface    COMMAND net_interface)
+add_test(NAME arp_latency              COMMAND arp_latency)
 
 add_test(NAME router_test    COMMAND network_simulator)
+add_test(NAME router_stress  COMMAND router_stress)
 
 add_test(NAME t_tcp_parser           COMMAND tcp_parser "${PROJECT_SOURCE_DIR}/tests/ipv4_parser.data")
 add_test(NAME t_ipv4_parser          COMMAND ipv4_parser "${PROJECT_SOURCE_DIR}/tests/ipv4_parser.data")
@@ -56,6 +58,13 @@ add_test(NAME t_connect              COMMAND fsm_connect_relaxed)
 add_test(NAME ec_listen              COMMAND fsm_listen)
 add_test(NAME t_listen               COMMAND fsm_listen_relaxed)
 add_test(NAME t_winsize              COMMAND fsm_winsize)
+add_test(NAME t_winsize_update       COMMAND fsm_winsize_update)
+add_test(NAME t_tcp_stack            COMMAND tcp_stack)
+add_test(NAME t_eventloop            COMMAND eventloop)
+add_test(NAME t_timing_wheel         COMMAND timing_wheel)
+add_test(NAME t_lpm_trie             COMMAND lpm_trie)
+add_test(NAME t_dir24_8_table        COMMAND dir24_8_table)
+add_test(NAME t_ipv4_ttl             COMMAND ipv4_ttl)
 add_test(NAME ec_retx                COMMAND fsm_retx)
 add_test(NAME t_retx                 COMMAND fsm_retx_relaxed)
 add_test(NAME t_retx_win             COMMAND fsm_retx_win)
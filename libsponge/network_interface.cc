@@ -3,6 +3,7 @@
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
 
+#include <algorithm>
 #include <iostream>
 
 // Dummy implementation of a network interface
@@ -26,20 +27,11 @@ NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, cons
          << ip_address.ip() << "\n";
 }
 
-bool NetworkInterface::check_arp_request_exist(const uint32_t target_ip_address) {
-    for (auto iter = _arp_datagram.cbegin(); iter != _arp_datagram.cend();) {
-        if (iter->first.target_ip_address == target_ip_address) {
-            return false;
-        }
-    }
-    return true;
-}
-
 void NetworkInterface::send_arp(const uint16_t opcode,
                                 const EthernetAddress &target_ethernet_address,
                                 const uint32_t target_ip_address) {
     EthernetFrame arp_frame;
-    if (opcode == ARPMessage::OPCODE_REQUEST) {
+    if (opcode == ARPMessage::OPCODE_REQUEST and target_ethernet_address == EthernetAddress{}) {
         arp_frame.header().dst = ETHERNET_BROADCAST;
     } else {
         arp_frame.header().dst = target_ethernet_address;
@@ -56,48 +48,54 @@ void NetworkInterface::send_arp(const uint16_t opcode,
     arp_msg.sender_ip_address = _ip_address.ipv4_numeric();
 
     arp_frame.payload().append(arp_msg.serialize());
-    if (opcode == ARPMessage::OPCODE_REQUEST) {
-        _arp_datagram.emplace_back(arp_msg, _current_time);
-    }
     _frames_out.push(arp_frame);
 }
 
-void NetworkInterface::do_send_datagram(const InternetDatagram &dgram, const Address &next_hop) {
-    const uint32_t next_hop_ip = next_hop.ipv4_numeric();
-    EthernetAddress dst_ethernet_address{_arp_table[next_hop_ip].first};
+void NetworkInterface::do_send_datagram(const InternetDatagram &dgram, const EthernetAddress &dst) {
     EthernetFrame frame;
-    frame.header().dst = dst_ethernet_address;
+    frame.header().dst = dst;
     frame.header().src = _ethernet_address;
     frame.header().type = EthernetHeader::TYPE_IPv4;
     frame.payload().append(dgram.serialize());
     _frames_out.push(frame);
 }
 
+//! \param[in] ip_address the neighbor's IP address
+//! \param[in] ethernet_address the neighbor's Ethernet address
+void NetworkInterface::learn(const uint32_t ip_address, const EthernetAddress &ethernet_address) {
+    Neighbor &neighbor = _neighbors[ip_address];
+    neighbor.ethernet_address = ethernet_address;
+    neighbor.learned_at = _current_time;
+    neighbor.requested_at.reset();
+    neighbor.probed_at.reset();
+    for (const auto &dgram : neighbor.pending) {
+        do_send_datagram(dgram, ethernet_address);
+    }
+    neighbor.pending.clear();
+}
+
 //! \param[in] dgram the IPv4 datagram to be sent
 //! \param[in] next_hop the IP address of the interface to send it to (typically a router or default gateway, but may also be another host if directly connected to the same network as the destination)
 //! (Note: the Address type can be converted to a uint32_t (raw 32-bit IP address) with the Address::ipv4_numeric() method.)
 void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Address &next_hop) {
     // convert IP address of next hop to raw 32-bit representation (used in ARP header)
     const uint32_t next_hop_ip = next_hop.ipv4_numeric();
-    if (_arp_table.find(next_hop_ip) != _arp_table.end()) {
-        do_send_datagram(dgram, next_hop);
-    } else {
-        _ip_datagram.emplace_back(dgram, next_hop);
-        // send a ARP datagram
-        if (check_arp_request_exist(next_hop_ip)) {
-            send_arp(ARPMessage::OPCODE_REQUEST, {}, next_hop_ip);
+    Neighbor &neighbor = _neighbors[next_hop_ip];
+    if (neighbor.ethernet_address.has_value()) {
+        do_send_datagram(dgram, neighbor.ethernet_address.value());
+        // keep a mapping in use from expiring: refresh it once it is stale, while still using it
+        if (_current_time - neighbor.learned_at > REFRESH_AFTER and not neighbor.probed_at.has_value()) {
+            send_arp(ARPMessage::OPCODE_REQUEST, neighbor.ethernet_address.value(), next_hop_ip);
+            neighbor.probed_at = _current_time;
         }
+        return;
     }
-}
 
-void NetworkInterface::try_send_all() {
-    for (auto iter = _ip_datagram.cbegin(); iter != _ip_datagram.cend();) {
-        if (_arp_table.find(iter->second.ipv4_numeric()) != _arp_table.end()) {
-            do_send_datagram(iter->first, iter->second);
-            _ip_datagram.erase(iter++);
-        } else {
-            ++iter;
-        }
+    // wait for the Ethernet address, asking for it unless a request is already on its way
+    neighbor.pending.push_back(dgram);
+    if (not neighbor.requested_at.has_value()) {
+        send_arp(ARPMessage::OPCODE_REQUEST, {}, next_hop_ip);
+        neighbor.requested_at = _current_time;
     }
 }
 
@@ -120,18 +118,7 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
         case EthernetHeader::TYPE_ARP:
             if (arp_msg_received.parse(frame.payload()) == ParseResult::NoError) {
                 if (arp_msg_received.opcode == ARPMessage::OPCODE_REPLY) {
-                    // remove the (used to be) un-replied arp datagram
-                    for (auto iter = _arp_datagram.cbegin(); iter != _arp_datagram.cend();) {
-                        if (iter->first.target_ip_address == arp_msg_received.sender_ip_address) {
-                            _arp_datagram.erase(iter++);
-                            break;
-                        }
-                        ++iter;
-                    }
-
-                    _arp_table[arp_msg_received.sender_ip_address] = {arp_msg_received.sender_ethernet_address,
-                                                                      _current_time};
-                    try_send_all();
+                    learn(arp_msg_received.sender_ip_address, arp_msg_received.sender_ethernet_address);
                 } else if (arp_msg_received.opcode == ARPMessage::OPCODE_REQUEST) {
                     if (arp_msg_received.target_ip_address == _ip_address.ipv4_numeric()) {
                         // send back a ARP reply
@@ -140,8 +127,7 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
                                  arp_msg_received.sender_ip_address);
                     }
                     // also keep track of the sender's MAC
-                    _arp_table[arp_msg_received.sender_ip_address] = {arp_msg_received.sender_ethernet_address,
-                                                                      _current_time};
+                    learn(arp_msg_received.sender_ip_address, arp_msg_received.sender_ethernet_address);
                 }
             }
             return {};
@@ -150,32 +136,51 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
     }
 }
 
-void NetworkInterface::timeout_arp_table() {
-    for (auto iter = _arp_table.cbegin(); iter != _arp_table.cend();) {
-        if (_current_time - iter->second.second > MAPPING_TTL) {
-            _arp_table.erase(iter++);
-        } else {
-            ++iter;
+std::optional<size_t> NetworkInterface::next_deadline() const {
+    std::optional<size_t> deadline{};
+    // an entry times out once strictly more than `timeout` milliseconds have passed since `since`
+    const auto consider = [&](const size_t since, const size_t timeout) {
+        const size_t elapsed = _current_time - since;
+        const size_t left = elapsed > timeout ? 0 : timeout + 1 - elapsed;
+        deadline = std::min(deadline.value_or(left), left);
+    };
+
+    for (const auto &[ip_address, neighbor] : _neighbors) {
+        if (neighbor.requested_at.has_value()) {
+            consider(neighbor.requested_at.value(), ARP_TIMEOUT);
         }
-    }
-}
-
-void NetworkInterface::resend_arp() {
-    for (auto iter = _arp_datagram.begin(); iter != _arp_datagram.end();) {
-        if (_current_time - iter->second > ARP_TIMEOUT) {
-            // resend
-            auto arp_msg = iter->first;
-            _arp_datagram.erase(iter++);
-            send_arp(arp_msg.opcode, arp_msg.target_ethernet_address, arp_msg.target_ip_address);
-        } else {
-            ++iter;
+        if (neighbor.probed_at.has_value()) {
+            consider(neighbor.probed_at.value(), ARP_TIMEOUT);
+        } else if (neighbor.ethernet_address.has_value()) {
+            consider(neighbor.learned_at, MAPPING_TTL);
         }
     }
+    return deadline;
 }
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick) {
     _current_time += ms_since_last_tick;
-    timeout_arp_table();
-    resend_arp();
+    for (auto iter = _neighbors.begin(); iter != _neighbors.end();) {
+        Neighbor &neighbor = iter->second;
+        // forget a mapping once it times out, or, if it was being refreshed, once the refresh goes unanswered
+        if (neighbor.probed_at.has_value()) {
+            if (_current_time - neighbor.probed_at.value() > ARP_TIMEOUT) {
+                neighbor.ethernet_address.reset();
+                neighbor.probed_at.reset();
+            }
+        } else if (neighbor.ethernet_address.has_value() and _current_time - neighbor.learned_at > MAPPING_TTL) {
+            neighbor.ethernet_address.reset();
+        }
+        // resend an ARP request that went unanswered
+        if (neighbor.requested_at.has_value() and _current_time - neighbor.requested_at.value() > ARP_TIMEOUT) {
+            send_arp(ARPMessage::OPCODE_REQUEST, {}, iter->first);
+            neighbor.requested_at = _current_time;
+        }
+        if (not neighbor.ethernet_address.has_value() and not neighbor.requested_at.has_value()) {
+            iter = _neighbors.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
 }
@@ -6,10 +6,10 @@
 #include "tcp_over_ip.hh"
 #include "tun.hh"
 
-#include <list>
-#include <map>
 #include <optional>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 //! \brief A "network interface" that connects IP (the internet layer, or network layer)
 //! with Ethernet (the network access layer, or link layer).
@@ -37,6 +37,10 @@ class NetworkInterface {
     constexpr static size_t ARP_TIMEOUT = 5 * 1000;
     constexpr static size_t MAPPING_TTL = 30 * 1000;
 
+    //! Age after which a mapping is stale: still used, but the next datagram sent with it also sends a
+    //! unicast ARP request to refresh it (leaving time for the reply before the mapping would expire)
+    constexpr static size_t REFRESH_AFTER = MAPPING_TTL - ARP_TIMEOUT;
+
     //! Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
     EthernetAddress _ethernet_address;
 
@@ -46,37 +50,32 @@ class NetworkInterface {
     //! outbound queue of Ethernet frames that the NetworkInterface wants sent
     std::queue<EthernetFrame> _frames_out{};
 
-    //! IP datagram destination MAC address unknow currently
-    std::list<std::pair<InternetDatagram, Address>> _ip_datagram{};
-
-    //! un-replied flying arp datagram
-    std::list<std::pair<ARPMessage, size_t>> _arp_datagram{};
+    //! What the interface knows about one neighbor (an IP address on its link)
+    struct Neighbor {
+        std::optional<EthernetAddress> ethernet_address{};  //!< Its Ethernet address, once learned
+        size_t learned_at = 0;                               //!< When its Ethernet address was learned
+        std::optional<size_t> requested_at{};                //!< When the unanswered ARP request for it was sent
+        std::optional<size_t> probed_at{};                   //!< When the unanswered refresh request was sent
+        std::vector<InternetDatagram> pending{};             //!< Datagrams waiting for its Ethernet address
+    };
 
-    //! map the 32-bit ip to 48-bit mac
-    std::map<uint32_t, std::pair<EthernetAddress, size_t>> _arp_table{};
+    //! Neighbors that have a known Ethernet address, an unanswered ARP request or waiting datagrams, by IP
+    //! address
+    std::unordered_map<uint32_t, Neighbor> _neighbors{};
 
     //! current time (in millisecond, start by 0)
     size_t _current_time{};
 
-    //! helper method to check if there is already an arp request on the way
-    bool check_arp_request_exist(const uint32_t target_ip_address);
-
-    //! helper method to send a arp frame
+    //! helper method to send a arp frame (a request is broadcast, unless it has a target Ethernet address)
     void send_arp(const uint16_t opcode,
                   const EthernetAddress &target_ethernet_address,
                   const uint32_t target_ip_address);
 
-    //! helper method try to send all queued datagram in _ip_datagram
-    void try_send_all();
+    //! helper method to learn a neighbor's Ethernet address, and send the datagrams waiting for it
+    void learn(const uint32_t ip_address, const EthernetAddress &ethernet_address);
 
-    //! helper method to remove all timeouted mapping
-    void timeout_arp_table();
-
-    //! helper method to resend all timeouted arp datagram
-    void resend_arp();
-
-    //! helper method to direct send a ip datagram, caller should ensure the next_hop has cached in the _arp_table
-    void do_send_datagram(const InternetDatagram &dgram, const Address &next_hop);
+    //! helper method to direct send a ip datagram to a neighbor's Ethernet address
+    void do_send_datagram(const InternetDatagram &dgram, const EthernetAddress &dst);
 
   public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer) addresses
@@ -100,6 +99,10 @@ class NetworkInterface {
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() could next do something (resend an ARP request or forget a mapping)
+    //! \returns `std::nullopt` if there are no outstanding requests or cached mappings
+    std::optional<size_t> next_deadline() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
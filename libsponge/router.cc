@@ -1,6 +1,11 @@
 #include "router.hh"
 
-#include <iostream>
+#include "epoch.hh"
+
+#include <array>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 using namespace std;
 
@@ -15,6 +20,30 @@ using namespace std;
 
 // You will need to add private members to the class declaration in `router.hh`
 
+//! 2^64 divided by the golden ratio (an odd constant whose bits look random)
+static constexpr uint64_t GOLDEN = 0x9e3779b97f4a7c15;
+
+//! Mix the bits of `x` so that every bit of the result depends on all of them (MurmurHash3's finalizer)
+static uint32_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    x ^= x >> 33;
+    return static_cast<uint32_t>(x);
+}
+
+//! A hash of a destination address, to pick a multipath route's next hop when there is no datagram to hash
+static uint32_t address_hash(const uint32_t address) { return mix(address * GOLDEN); }
+
+Router::Router() : _snapshot(new RouteSnapshot) {}
+
+//! \note There must be no lookups left on other threads.
+Router::~Router() {
+    delete _fib.load();
+    delete _snapshot.load();
+}
+
 //! \param[in] route_prefix The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
 //! \param[in] prefix_length For this route to be applicable, how many high-order (most-significant) bits of the route_prefix will need to match the corresponding bits of the datagram's destination address?
 //! \param[in] next_hop The IP address of the next hop. Will be empty if the network is directly attached to the router (in which case, the next hop address should be the datagram's final destination).
@@ -23,51 +52,340 @@ void Router::add_route(const uint32_t route_prefix,
                        const uint8_t prefix_length,
                        const optional<Address> next_hop,
                        const size_t interface_num) {
-    cerr << "DEBUG: adding route " << Address::from_ipv4_numeric(route_prefix).ip() << "/" << int(prefix_length)
-         << " => " << (next_hop.has_value() ? next_hop->ip() : "(direct)") << " on interface " << interface_num << "\n";
+    add_routes({{route_prefix, prefix_length, next_hop, interface_num}});
+}
 
-    _route_table.push_back({{route_prefix, prefix_length}, {next_hop, interface_num}});
+//! \param[in] routes The routes to add
+void Router::add_routes(const vector<Route> &routes) {
+    vector<RouteChange> changes;
+    changes.reserve(routes.size());
+    for (const auto &route : routes) {
+        changes.push_back({route.prefix,
+                           route.prefix_length,
+                           {{route.next_hop.has_value() ? route.next_hop->ipv4_numeric() : 0,
+                             static_cast<uint32_t>(route.interface_num)}}});
+    }
+    insert_routes(changes);
+}
+
+//! \param[in] route_prefix The IPv4 address prefix to match the datagram's destination address against
+//! \param[in] prefix_length The number of high-order bits of route_prefix that must match
+//! \param[in] paths The next hops to spread datagrams over (at least one)
+void Router::add_multipath_route(const uint32_t route_prefix,
+                                 const uint8_t prefix_length,
+                                 const vector<Path> &paths) {
+    if (paths.empty()) {
+        throw invalid_argument("Router: a multipath route needs at least one path");
+    }
+    RouteChange change{route_prefix, prefix_length};
+    for (const auto &path : paths) {
+        change.hops.push_back(
+            {path.next_hop.has_value() ? path.next_hop->ipv4_numeric() : 0, static_cast<uint32_t>(path.interface_num)});
+    }
+    insert_routes({change});
+}
+
+//! \param[in] changes The routes to add
+void Router::insert_routes(const vector<RouteChange> &changes) {
+    const lock_guard<mutex> lock(_update_mutex);
+    const RouteSnapshot &current = *_snapshot.load(memory_order_relaxed);
+    Dir24_8Builder *const fib = _fib.load(memory_order_relaxed);
+
+    auto next = make_unique<RouteSnapshot>(current);
+    vector<uint32_t> indices;
+    vector<vector<uint64_t>> added_keys;
+    for (const auto &change : changes) {
+        vector<uint64_t> key;
+        for (const auto &hop : change.hops) {
+            key.push_back((uint64_t(hop.interface_num) << 32) | hop.address);
+        }
+        const auto [entry, added] = _next_hop_index.try_emplace(key, next->next_hops.size());
+        if (added) {
+            added_keys.push_back(key);
+            for (const auto &hop : change.hops) {
+                next->next_hops.push_back({hop, static_cast<uint32_t>(change.hops.size())});
+            }
+        }
+        if (fib and entry->second > Dir24_8Table::MAX_VALUE) {
+            for (const auto &added_key : added_keys) {
+                _next_hop_index.erase(added_key);
+            }
+            throw out_of_range("Router: too many next hops for a compiled route table");
+        }
+        next->routes.insert(change.prefix, change.prefix_length, entry->second);
+        indices.push_back(entry->second);
+    }
+
+    // one version per route, so that a table compiled from some of the changes is not taken as current
+    for (size_t i = 0; i < changes.size(); i++) {
+        next->version++;
+        if (fib) {
+            fib->update(changes[i].prefix, changes[i].prefix_length, indices[i], next->version);
+        }
+    }
+    publish(move(next));
+}
+
+//! \param[in] route_prefix The prefix of the route to remove
+//! \param[in] prefix_length The length of the prefix of the route to remove
+bool Router::remove_route(const uint32_t route_prefix, const uint8_t prefix_length) {
+    const lock_guard<mutex> lock(_update_mutex);
+    const RouteSnapshot &current = *_snapshot.load(memory_order_relaxed);
+    if (not current.routes.find(route_prefix, prefix_length).has_value()) {
+        return false;
+    }
+
+    auto next = make_unique<RouteSnapshot>(current);
+    next->routes.erase(route_prefix, prefix_length);
+    next->version++;
+    if (Dir24_8Builder *const fib = _fib.load(memory_order_relaxed)) {
+        fib->update(route_prefix, prefix_length, {}, next->version);
+    }
+    publish(move(next));
+    return true;
+}
+
+//! \param[in] next is the new snapshot
+//! \details Lookups that loaded the old snapshot go on using it; it is freed once they have finished.
+void Router::publish(unique_ptr<RouteSnapshot> next) {
+    Epoch::retire(_snapshot.exchange(next.release()));
+}
+
+void Router::compile_routes() {
+    const lock_guard<mutex> lock(_update_mutex);
+    if (_fib.load(memory_order_relaxed)) {
+        return;
+    }
+    const RouteSnapshot &current = *_snapshot.load(memory_order_relaxed);
+    if (current.next_hops.size() > Dir24_8Table::MAX_VALUE + 1) {
+        throw out_of_range("Router: too many next hops for a compiled route table");
+    }
+    _fib.store(new Dir24_8Builder(current.routes, current.version), memory_order_release);
+}
+
+//! \param[in] routes The routes the table must be up to date with
+const Dir24_8Table *Router::current_fib(const RouteSnapshot &routes) const {
+    const Dir24_8Builder *const builder = _fib.load(memory_order_acquire);
+    if (not builder) {
+        return nullptr;
+    }
+    const Dir24_8Table *const fib = builder->table();
+    return fib and fib->version() == routes.version ? fib : nullptr;
+}
+
+//! \param[in] address The destination address to look up
+//! \param[in] routes The routes to look it up in
+//! \param[in] fib The compiled table, if it is up to date with `routes`
+optional<Router::NextHop> Router::lookup(const uint32_t address,
+                                         const RouteSnapshot &routes,
+                                         const Dir24_8Table *fib) const {
+    const auto index = fib ? fib->lookup(address) : routes.routes.lookup(address);
+    if (not index.has_value()) {
+        return {};
+    }
+    return routes.next_hops[choose_path(routes, index.value(), address_hash(address))].hop;
+}
+
+//! \param[in] addresses The destination addresses to look up
+//! \param[out] indices Receives the index into `routes.next_hops` of each address's next hop, if any
+//! \param[in] count The number of addresses
+//! \param[in] routes The routes to look them up in
+//! \param[in] fib The compiled table, if it is up to date with `routes`
+void Router::lookup_indices(const uint32_t *addresses,
+                            optional<uint32_t> *indices,
+                            const size_t count,
+                            const RouteSnapshot &routes,
+                            const Dir24_8Table *fib) {
+    if (fib) {
+        fib->lookup_batch(addresses, indices, count);
+    } else {
+        routes.routes.lookup_batch(addresses, indices, count);
+    }
+}
+
+//! \param[in] address The destination address to look up
+optional<Router::NextHop> Router::lookup(const uint32_t address) const {
+    const Epoch::Guard guard;
+    const RouteSnapshot &routes = *_snapshot.load(memory_order_acquire);
+    return lookup(address, routes, current_fib(routes));
+}
+
+//! \param[in] addresses The destination addresses to look up
+//! \param[out] hops Receives the next hop of each address, if any
+//! \param[in] count The number of addresses
+void Router::lookup_batch(const uint32_t *addresses, optional<NextHop> *hops, const size_t count) const {
+    lookup_batch(nullptr, addresses, hops, count);
+}
+
+//! \param[in] datagrams The datagrams, or null to choose among multiple paths by address
+//! \param[in] addresses The datagrams' destination addresses
+//! \param[out] hops Receives the next hop of each datagram, if any
+//! \param[in] count The number of datagrams
+void Router::lookup_batch(const InternetDatagram *datagrams,
+                          const uint32_t *addresses,
+                          optional<NextHop> *hops,
+                          const size_t count) const {
+    const Epoch::Guard guard;
+    const RouteSnapshot &routes = *_snapshot.load(memory_order_acquire);
+    const Dir24_8Table *const fib = current_fib(routes);
+    array<optional<uint32_t>, DEFAULT_BATCH_SIZE> indices{};
+    for (size_t first = 0; first < count; first += indices.size()) {
+        const size_t batch = min(indices.size(), count - first);
+        lookup_indices(addresses + first, indices.data(), batch, routes, fib);
+        for (size_t i = 0; i < batch; i++) {
+            if (indices[i].has_value()) {
+                const uint32_t index = indices[i].value();
+                const uint32_t path = datagrams ? choose_path(routes, index, datagrams[first + i])
+                                                : choose_path(routes, index, address_hash(addresses[first + i]));
+                hops[first + i] = routes.next_hops[path].hop;
+            } else {
+                hops[first + i] = {};
+            }
+        }
+    }
 }
 
 //! \param[in] dgram The datagram to be routed
-void Router::route_one_datagram(InternetDatagram &dgram) {
-    if (dgram.header().ttl < 2) {
+//! \param[in] routes The routes to use
+//! \param[in] fib The compiled table, if it is up to date with `routes`
+void Router::route_one_datagram(InternetDatagram &dgram, const RouteSnapshot &routes, const Dir24_8Table *fib) {
+    // read the header through a const reference, so that the datagram can still be sent on as received
+    const IPv4Header &header = as_const(dgram).header();
+    if (header.ttl < 2) {
         return;
     }
 
-    const auto dst_ip = dgram.header().dst;
-    std::optional<uint8_t> max_match{};
-    auto chosen_route = _route_table.front();
-    for (auto route : _route_table) {
-        const auto &[sub_net, next_hop] = route;
-        const auto &[sub_net_ip, sub_net_len] = sub_net;
-        const auto sub_net_shift = 32 - sub_net_len;
+    const auto dst_ip = header.dst;
+    optional<uint32_t> index;
+    if (not _flow_cache or not _flow_cache->lookup(dst_ip, routes.version, index)) {
+        index = fib ? fib->lookup(dst_ip) : routes.routes.lookup(dst_ip);
+        if (_flow_cache) {
+            _flow_cache->insert(dst_ip, routes.version, index);
+        }
+    }
+    if (index.has_value()) {
+        const NextHop &hop = routes.next_hops[choose_path(routes, index.value(), dgram)].hop;
+        dgram.decrement_ttl();
+        interface(hop.interface_num)
+            .send_datagram(dgram, Address::from_ipv4_numeric(hop.address != 0 ? hop.address : dst_ip));
+    }
+}
+
+//! \param[in] routes The routes to use
+//! \param[in] fib The compiled table, if it is up to date with `routes`
+void Router::route_batch(const RouteSnapshot &routes, const Dir24_8Table *fib) {
+    auto &[datagrams, destinations, hops, order, group_end, misses, miss_destinations, miss_hops] = _batch;
+    destinations.clear();
+    for (const auto &dgram : datagrams) {
+        destinations.push_back(dgram.header().dst);
+    }
+    hops.resize(datagrams.size());
+    if (not _flow_cache) {
+        lookup_indices(destinations.data(), hops.data(), destinations.size(), routes, fib);
+    } else {
+        // take what the flow cache has, and look up the rest together
+        for (const auto destination : destinations) {
+            _flow_cache->prefetch(destination);
+        }
+        misses.clear();
+        miss_destinations.clear();
+        for (size_t i = 0; i < destinations.size(); i++) {
+            if (not _flow_cache->lookup(destinations[i], routes.version, hops[i])) {
+                misses.push_back(i);
+                miss_destinations.push_back(destinations[i]);
+            }
+        }
+        miss_hops.resize(misses.size());
+        lookup_indices(miss_destinations.data(), miss_hops.data(), misses.size(), routes, fib);
+        for (size_t j = 0; j < misses.size(); j++) {
+            hops[misses[j]] = miss_hops[j];
+            _flow_cache->insert(miss_destinations[j], routes.version, miss_hops[j]);
+        }
+    }
+
+    // pick each multipath route's next hop, then sort the datagrams to send by interface (a counting sort,
+    // keeping their order within an interface)
+    const auto sendable = [&](const size_t i) {
+        return hops[i].has_value() and as_const(datagrams[i]).header().ttl >= 2;
+    };
+    group_end.assign(_interfaces.size(), 0);
+    for (size_t i = 0; i < datagrams.size(); i++) {
+        if (sendable(i)) {
+            hops[i] = choose_path(routes, hops[i].value(), as_const(datagrams[i]));
+            group_end[routes.next_hops[hops[i].value()].hop.interface_num]++;
+        }
+    }
+    size_t total = 0;
+    for (auto &end : group_end) {
+        total += end;
+        end = total - end;  // for now, where the group starts
+    }
+    order.resize(total);
+    for (size_t i = 0; i < datagrams.size(); i++) {
+        if (sendable(i)) {
+            order[group_end[routes.next_hops[hops[i].value()].hop.interface_num]++] = i;
+        }
+    }
+
+    for (const auto i : order) {
+        InternetDatagram &dgram = datagrams[i];
+        const NextHop &hop = routes.next_hops[hops[i].value()].hop;
+        dgram.decrement_ttl();
+        interface(hop.interface_num)
+            .send_datagram(dgram, Address::from_ipv4_numeric(hop.address != 0 ? hop.address : destinations[i]));
+    }
+}
+
+//! \param[in] dgram The datagram
+uint32_t Router::flow_hash(const InternetDatagram &dgram) {
+    const IPv4Header &header = dgram.header();
 
-        if ((static_cast<uint64_t>((dst_ip ^ sub_net_ip)) >> sub_net_shift) == 0) {
-            if (max_match.value_or(33) > sub_net_shift) {
-                max_match = sub_net_shift;
-                chosen_route = route;
+    // the source and destination ports are the first four bytes of a TCP or UDP header
+    uint32_t ports = 0;
+    const bool has_ports = header.proto == IPv4Header::PROTO_TCP or header.proto == IPv4Header::PROTO_UDP;
+    if (has_ports and not header.mf and header.offset == 0) {
+        const auto &slices = dgram.payload().buffers();
+        size_t taken = 0;
+        for (size_t i = 0; i < slices.size() and taken < 4; i++) {
+            const string_view bytes = slices[i].str();
+            for (size_t j = 0; j < bytes.size() and taken < 4; j++, taken++) {
+                ports = (ports << 8) | static_cast<uint8_t>(bytes[j]);
             }
         }
+        ports = taken == 4 ? ports : 0;
     }
 
-    if (max_match.has_value()) {
-        const auto &[sub_net, next_hop] = chosen_route;
-        const auto &[next_hop_ip_opt, next_hop_if] = next_hop;
-        auto &next_hop_interface = interface(next_hop_if);
+    return mix((uint64_t(header.src) << 32 | header.dst) ^ ((uint64_t(ports) << 8 | header.proto) * GOLDEN));
+}
 
-        dgram.header().ttl--;
-        next_hop_interface.send_datagram(dgram, next_hop_ip_opt.value_or(Address::from_ipv4_numeric(dst_ip)));
+//! \param[in] entries The least number of entries to cache, or 0 for no cache
+void Router::set_flow_cache_size(const size_t entries) {
+    if (entries == 0) {
+        _flow_cache.reset();
+    } else {
+        _flow_cache.emplace(entries);
     }
 }
 
 void Router::route() {
     // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
+    const Epoch::Guard guard;
+    const RouteSnapshot &routes = *_snapshot.load(memory_order_acquire);
+    const Dir24_8Table *const fib = current_fib(routes);
     for (auto &interface : _interfaces) {
         auto &queue = interface.datagrams_out();
+        if (_batch_size == 1) {
+            for (; not queue.empty(); queue.pop()) {
+                route_one_datagram(queue.front(), routes, fib);
+            }
+            continue;
+        }
         while (not queue.empty()) {
-            route_one_datagram(queue.front());
-            queue.pop();
+            _batch.datagrams.clear();
+            for (; not queue.empty() and _batch.datagrams.size() < _batch_size; queue.pop()) {
+                _batch.datagrams.push_back(move(queue.front()));
+            }
+            route_batch(routes, fib);
         }
     }
 }
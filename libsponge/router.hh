@@ -1,11 +1,21 @@
 #ifndef SPONGE_LIBSPONGE_ROUTER_HH
 #define SPONGE_LIBSPONGE_ROUTER_HH
 
+#include "dir24_8_table.hh"
+#include "flow_cache.hh"
+#include "lpm_trie.hh"
 #include "network_interface.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 //! \brief A wrapper for NetworkInterface that makes the host-side
 //! interface asynchronous: instead of returning received datagrams
@@ -45,12 +55,146 @@ class Router {
     //! The router's collection of network interfaces
     std::vector<AsyncNetworkInterface> _interfaces{};
 
-    std::list<std::pair<std::pair<uint32_t, uint8_t>, std::pair<std::optional<Address>, size_t>>> _route_table{};
+  public:
+    //! Where a route sends datagrams
+    struct NextHop {
+        uint32_t address;        //!< The next hop's IPv4 address (zero for a directly attached network)
+        uint32_t interface_num;  //!< The interface to send on
+    };
+
+    //! One of the equal-cost next hops of a multipath route, for add_multipath_route()
+    struct Path {
+        std::optional<Address> next_hop;  //!< The next hop (empty for a directly attached network)
+        size_t interface_num;             //!< The interface to send on
+    };
+
+    //! A route, for add_routes()
+    struct Route {
+        uint32_t prefix;                  //!< The prefix to match
+        uint8_t prefix_length;            //!< Its length
+        std::optional<Address> next_hop;  //!< The next hop (empty for a directly attached network)
+        size_t interface_num;             //!< The interface to send on
+    };
+
+    //! Default for the most datagrams route() looks up together (see set_batch_size())
+    static constexpr size_t DEFAULT_BATCH_SIZE = 32;
+
+  private:
+    //! An entry of RouteSnapshot::next_hops
+    struct HopEntry {
+        NextHop hop;    //!< The next hop
+        uint32_t ways;  //!< Number of next hops in the set starting here (more than 1 for a multipath route)
+    };
+
+    //! \brief One version of the routes
+    //! \details Never changed once published: a change to the routes makes a new snapshot.
+    struct RouteSnapshot {
+        //! The routes, mapping each prefix to the index of the first of its next hops in `next_hops`
+        LPMTrie routes{};
+
+        //! \brief The distinct sets of next hops of the routes, each one's next hops in consecutive entries
+        //! \details A set stays after the last route using it is removed.
+        std::vector<HopEntry> next_hops{};
+
+        //! Incremented by every change to the routes
+        uint64_t version = 0;
+    };
+
+    //! The current routes (owned; replaced snapshots are retired with Epoch)
+    std::atomic<const RouteSnapshot *> _snapshot;
+
+    //! The routes compiled into a DIR-24-8 table (owned; set by compile_routes())
+    std::atomic<Dir24_8Builder *> _fib{nullptr};
+
+    //! Serializes changes to the routes (never taken by lookups)
+    std::mutex _update_mutex{};
+
+    //! Index into RouteSnapshot::next_hops of each set of next hops, keyed by their addresses and
+    //! interfaces (protected by _update_mutex)
+    std::map<std::vector<uint64_t>, uint32_t> _next_hop_index{};
+
+    //! A route to add: a prefix, and its next hops (more than one for a multipath route)
+    struct RouteChange {
+        uint32_t prefix;              //!< The prefix to match
+        uint8_t prefix_length;        //!< Its length
+        std::vector<NextHop> hops{};  //!< Its next hops
+    };
+
+    //! Add the routes, making a single new version of the routes
+    void insert_routes(const std::vector<RouteChange> &changes);
+
+    //! \brief The next hop to use from the set of next hops at `index` in `routes.next_hops`
+    //! \returns `index` for a single next hop; for a multipath route, the index of the one that `hash`
+    //! picks
+    static uint32_t choose_path(const RouteSnapshot &routes, const uint32_t index, const uint32_t hash) {
+        const uint32_t ways = routes.next_hops[index].ways;
+        return ways == 1 ? index : index + static_cast<uint32_t>((uint64_t(hash) * ways) >> 32);
+    }
+
+    //! Like choose_path(), picking by the hash of `dgram`'s flow (computed only for a multipath route)
+    static uint32_t choose_path(const RouteSnapshot &routes, const uint32_t index, const InternetDatagram &dgram) {
+        return routes.next_hops[index].ways == 1 ? index : choose_path(routes, index, flow_hash(dgram));
+    }
+
+    //! \brief A hash of a datagram's flow: its addresses and protocol, and, for TCP or UDP, its ports
+    //! \details Stable, so that all the datagrams of a flow take the same path (and stay in order). The
+    //! ports are left out for fragments, which (but for the first) do not carry them.
+    static uint32_t flow_hash(const InternetDatagram &dgram);
+
+    //! Publish `next` as the current routes, and retire the snapshot it replaces
+    //! (with _update_mutex held)
+    void publish(std::unique_ptr<RouteSnapshot> next);
+
+    //! The compiled table, if there is one and it is up to date with `routes` (with an Epoch::Guard held)
+    const Dir24_8Table *current_fib(const RouteSnapshot &routes) const;
+
+    //! Look up `address` in `fib` if there is one, else in `routes` (with an Epoch::Guard held)
+    std::optional<NextHop> lookup(const uint32_t address,
+                                  const RouteSnapshot &routes,
+                                  const Dir24_8Table *fib) const;
+
+    //! Look up `count` addresses in `fib` if there is one, else in `routes`, storing the index of each one's
+    //! next hop in `indices` (with an Epoch::Guard held)
+    static void lookup_indices(const uint32_t *addresses,
+                               std::optional<uint32_t> *indices,
+                               const size_t count,
+                               const RouteSnapshot &routes,
+                               const Dir24_8Table *fib);
+
+    //! \brief Cache of route()'s lookups, if enabled (see set_flow_cache_size())
+    //! \details Entries are stamped with RouteSnapshot::version, so any change to the routes invalidates them.
+    std::optional<FlowCache> _flow_cache{};
+
+    //! The most datagrams route() looks up together
+    size_t _batch_size = DEFAULT_BATCH_SIZE;
+
+    //! Space for route() to work in, kept to save allocating it for every batch
+    struct Batch {
+        std::vector<InternetDatagram> datagrams{};    //!< The datagrams
+        std::vector<uint32_t> destinations{};         //!< Their destination addresses
+        std::vector<std::optional<uint32_t>> hops{};  //!< The index of each one's next hop, if any
+        std::vector<uint32_t> order{};                //!< Indices of those to send, grouped by interface
+        std::vector<size_t> group_end{};              //!< Where each interface's group ends in `order`
+
+        //! \name Those the flow cache missed
+        //!@{
+        std::vector<uint32_t> misses{};                    //!< Their indices
+        std::vector<uint32_t> miss_destinations{};         //!< Their destination addresses
+        std::vector<std::optional<uint32_t>> miss_hops{};  //!< The index of each one's next hop, if any
+        //!@}
+    } _batch{};
+
+    //! Route the datagrams in Router::_batch, looking up their next hops together
+    //! \param[in] routes are the routes to use
+    //! \param[in] fib is the compiled table to use (if not null)
+    void route_batch(const RouteSnapshot &routes, const Dir24_8Table *fib);
 
     //! Send a single datagram from the appropriate outbound interface to the next hop,
     //! as specified by the route with the longest prefix_length that matches the
     //! datagram's destination address.
-    void route_one_datagram(InternetDatagram &dgram);
+    //! \param[in] routes are the routes to use
+    //! \param[in] fib is the compiled table to use (if not null)
+    void route_one_datagram(InternetDatagram &dgram, const RouteSnapshot &routes, const Dir24_8Table *fib);
 
   public:
     //! Add an interface to the router
@@ -61,17 +205,90 @@ class Router {
         return _interfaces.size() - 1;
     }
 
+    //! A router with no interfaces and no routes
+    Router();
+
+    //! Free the routes
+    ~Router();
+
     //! Access an interface by index
     AsyncNetworkInterface &interface(const size_t N) { return _interfaces.at(N); }
 
-    //! Add a route (a forwarding rule)
+    //! Number of interfaces
+    size_t interface_count() const { return _interfaces.size(); }
+
+    //! \brief Add a route (a forwarding rule), or replace the route for the same prefix
+    //! \details Like remove_route(), may be called from any thread, while other threads look up routes.
     void add_route(const uint32_t route_prefix,
                    const uint8_t prefix_length,
                    const std::optional<Address> next_hop,
                    const size_t interface_num);
 
-    //! Route packets between the interfaces
+    //! \brief Add several routes (or replace them), making a single new version of the routes
+    //! \details Much faster than calling add_route() for each of many routes.
+    void add_routes(const std::vector<Route> &routes);
+
+    //! \brief Add a route with several equal-cost next hops (ECMP), or replace the route for the same prefix
+    //! \details route() spreads the route's datagrams over the paths by a hash of each one's flow (see
+    //! flow_hash()), so every flow sticks to one path. A path listed twice gets twice the share.
+    void add_multipath_route(const uint32_t route_prefix, const uint8_t prefix_length, const std::vector<Path> &paths);
+
+    //! \brief Remove a route
+    //! \returns `true` if there was a route for the prefix
+    bool remove_route(const uint32_t route_prefix, const uint8_t prefix_length);
+
+    //! \brief The next hop of the route with the longest prefix matching `address`, if any (from any thread)
+    //! \details For a multipath route, which of its next hops depends on `address` alone.
+    std::optional<NextHop> lookup(const uint32_t address) const;
+
+    //! \brief Look up `count` addresses at once (from any thread), as route() does
+    //! \details Stores the next hop for `addresses[i]` in `hops[i]`. All come from the same version of the
+    //! routes.
+    void lookup_batch(const uint32_t *addresses, std::optional<NextHop> *hops, const size_t count) const;
+
+    //! \brief Like lookup_batch(), but for datagrams: `addresses[i]` is `datagrams[i]`'s destination
+    //! \details For a multipath route, picks the next hop by the datagram's flow (see flow_hash()), as
+    //! route() does, rather than by its destination alone.
+    void lookup_batch(const InternetDatagram *datagrams,
+                      const uint32_t *addresses,
+                      std::optional<NextHop> *hops,
+                      const size_t count) const;
+
+    //! \brief Compile the routes into a DIR-24-8 table, for lookups in one or two memory accesses
+    //! \details For routes that change rarely. After this, add_route() and remove_route() recompile the
+    //! affected part of the table on a background thread, and lookups use the route table until the
+    //! new table is ready. Does nothing if the routes are already compiled.
+    //! \note If a change cannot be compiled (e.g. there are too many routes longer than /24), the table is
+    //! withdrawn, and lookups use the route table from then on.
+    void compile_routes();
+
+    //! \brief Route packets between the interfaces
+    //! \details Takes no locks, so routes can change on other threads meanwhile: each call uses the
+    //! routes as they were when it started.
+    //!
+    //! Takes the datagrams from each interface in batches, looks up all of a batch's destinations
+    //! together (so that their cache misses overlap), then sends them grouped by outbound interface.
     void route();
+
+    //! \brief Set the most datagrams route() looks up together
+    //! \details With 1, route() routes each datagram on its own.
+    void set_batch_size(const size_t batch_size) { _batch_size = std::max(batch_size, size_t(1)); }
+
+    //! \brief Cache route()'s lookups by destination address, in a flow cache of (at least) `entries` entries
+    //! \details For traffic to a small set of destinations, where a hit saves a longest-prefix match. With
+    //! 0, turns the cache off. Like set_batch_size(), must not be called while route() runs.
+    void set_flow_cache_size(const size_t entries);
+
+    //! The flow cache, if there is one (for its statistics)
+    const FlowCache *flow_cache() const { return _flow_cache ? &_flow_cache.value() : nullptr; }
+
+    //! \name
+    //! A Router cannot be copied or moved (lookups on other threads refer to it)
+
+    //!@{
+    Router(const Router &other) = delete;
+    Router &operator=(const Router &other) = delete;
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_ROUTER_HH
@@ -136,14 +136,9 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
     auto capacity_of_unassembled = _capacity - _output.buffer_size();
     auto max_unassembled = end_of_assembled + capacity_of_unassembled;
 
-    if (eof) {
-        if (!_eof_index.has_value()) {
-            // shouldn't we just update the _eof_index once?
-            _eof_index = index + data.length();
-        } else {
-            // multiple eof, ignore
-            return;
-        }
+    if (eof && !_eof_index.has_value()) {
+        // later substrings may carry the eof again (e.g. a retransmission); their data still counts
+        _eof_index = index + data.length();
     }
 
     if (index + data.length() > end_of_assembled) {
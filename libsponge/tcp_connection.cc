@@ -24,22 +24,42 @@ size_t TCPConnection::time_since_last_segment_received() const {
     return _current_time_tick - _time_tick_of_last_segment_received;
 }
 
-void TCPConnection::send(TCPSegment &seg) {
+void TCPConnection::send(TCPSegment &&seg) {
     auto ackno = _receiver.ackno();
     auto window_size = _receiver.window_size();
-    auto out_seg = seg;
     if (ackno.has_value()) {
         // we need send a packet with ack
-        out_seg.header().ackno = ackno.value();
-        out_seg.header().win = std::min(window_size, static_cast<size_t>(std::numeric_limits<uint16_t>::max()));
-        out_seg.header().ack = true;
+        seg.header().ackno = ackno.value();
+        seg.header().win = std::min(window_size, static_cast<size_t>(std::numeric_limits<uint16_t>::max()));
+        seg.header().ack = true;
+        _advertised_window = seg.header().win;
     }
 
     if (_rst) {
-        out_seg.header().rst = true;
+        seg.header().rst = true;
     }
 
-    _segments_out.push(out_seg);
+    _segments_out.emplace(std::move(seg));
+}
+
+void TCPConnection::send_empty_segment() {
+    TCPSegment seg;
+    seg.header().seqno = _sender.next_seqno();
+    send(std::move(seg));
+}
+
+void TCPConnection::inbound_stream_read() {
+    if (not active() or not _receiver.ackno().has_value() or inbound_stream().input_ended()) {
+        return;
+    }
+
+    // announce the window once it has grown by a full segment or by half the buffer, whichever is less
+    // (the receiver's side of silly window syndrome avoidance, RFC 1122 4.2.3.3)
+    const size_t window = std::min(_receiver.window_size(), static_cast<size_t>(std::numeric_limits<uint16_t>::max()));
+    const size_t threshold = std::min(TCPConfig::MAX_PAYLOAD_SIZE, _cfg.recv_capacity / 2);
+    if (window >= _advertised_window + threshold) {
+        send_empty_segment();
+    }
 }
 
 size_t TCPConnection::try_send() {
@@ -50,10 +70,9 @@ size_t TCPConnection::try_send() {
 size_t TCPConnection::send_all() {
     size_t n_sent = 0;
     while (!_sender.segments_out().empty()) {
-        auto out_seg = _sender.segments_out().front();
+        send(std::move(_sender.segments_out().front()));
         _sender.segments_out().pop();
         n_sent++;
-        send(out_seg);
     }
     return n_sent;
 }
@@ -94,15 +113,13 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
         // is sent in reply, to reflect an update in the ackno and window size
         n_sent = try_send();
         if (n_sent == 0) {
-            _sender.send_empty_segment();
-            send_all();
+            send_empty_segment();
         }
     }
 
     if (_receiver.ackno().has_value() && (seg.length_in_sequence_space() == 0) &&
         seg.header().seqno == _receiver.ackno().value() - 1) {
-        _sender.send_empty_segment();
-        send_all();
+        send_empty_segment();
     }
 
     set_linger_start_time();
@@ -159,8 +176,7 @@ void TCPConnection::goto_rst() {
     handle_rst();
 
     if (!send_all()) {
-        _sender.send_empty_segment();
-        send_all();
+        send_empty_segment();
     }
 }
 
@@ -174,6 +190,20 @@ void TCPConnection::tick(const size_t ms_since_last_tick) {
     send_all();
 }
 
+std::optional<size_t> TCPConnection::next_deadline() const {
+    if (not active()) {
+        return std::nullopt;
+    }
+
+    auto deadline = _sender.next_deadline();
+    if (_linger_after_streams_finish && _linger_start_time.has_value() && check_prereq()) {
+        // active() implies that less than 10 * rt_timeout has passed since lingering began
+        const size_t linger_left = _linger_start_time.value() + 10 * _cfg.rt_timeout - _current_time_tick;
+        deadline = std::min(deadline.value_or(linger_left), linger_left);
+    }
+    return deadline;
+}
+
 void TCPConnection::end_input_stream() {
     _sender.stream_in().end_input();
     try_send();
@@ -24,11 +24,18 @@ class TCPConnection {
     //! have we received or sent rst?
     bool _rst{false};
 
+    //! the window size in the last segment sent with an ackno
+    size_t _advertised_window{0};
+
     //! helper method for TCPConnection to send a rst packet to peer
     void goto_rst();
 
-    //! helper method for TCPConnection to send a segment
-    void send(TCPSegment &seg);
+    //! helper method for TCPConnection to send a segment (fills in ackno/window in place, then moves it out)
+    void send(TCPSegment &&seg);
+
+    //! helper method for TCPConnection to send an empty (ACK-only or RST) segment directly,
+    //! without going through the TCPSender's queue
+    void send_empty_segment();
 
     //! helper method for TCPConnection to try to send a segment (use TCPSender's fill_window)
     size_t try_send();
@@ -70,6 +77,11 @@ class TCPConnection {
 
     //! \brief The inbound byte stream received from the peer
     ByteStream &inbound_stream() { return _receiver.stream_out(); }
+
+    //! \brief Called after the reader has taken bytes from the inbound stream
+    //! \details If that reopened a window the peer believes is (nearly) closed, sends an ACK to say so,
+    //! rather than leaving the peer to probe for it.
+    void inbound_stream_read();
     //!@}
 
     //! \name Accessors used for testing
@@ -94,6 +106,10 @@ class TCPConnection {
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
+    //! \brief Milliseconds until tick() could next change anything (a retransmission or the end of lingering)
+    //! \returns `std::nullopt` if nothing depends on time until another segment arrives or is written
+    std::optional<size_t> next_deadline() const;
+
     //! \brief TCPSegments that the TCPConnection has enqueued for transmission.
     //! \note The owner or operating system will dequeue these and
     //! put each one into the payload of a lower-layer datagram (usually Internet datagrams (IP),
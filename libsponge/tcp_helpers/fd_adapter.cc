@@ -1,11 +1,17 @@
 #include "fd_adapter.hh"
 
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <utility>
 
 using namespace std;
 
+//! \param[in] sock is the UDP socket to carry the segments
+//! \details With GSO, write_batch() sends a burst of full-size segments (e.g. from TCPSender::fill_window)
+//! as one buffer. GRO is left off until read_batch() is first called.
+TCPOverUDPSocketAdapter::TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(move(sock)) { _sock.enable_gso(); }
+
 //! \details This function first attempts to parse a TCP segment from the next UDP
 //! payload recv()d from the socket.
 //!
@@ -18,9 +24,54 @@ using namespace std;
 //! `_listen` flag and calls calls connect() on the underlying UDP socket, with
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
+//! \note Once read_batch() has turned GRO on, one datagram from the socket may yield several segments; the
+//! rest are returned by later calls (or by read_batch()) without reading the socket.
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    if (_unread.empty()) {
+        for (auto &datagram : _sock.recv_batch(1)) {
+            auto seg = accept(move(datagram));
+            if (seg) {
+                _unread.push_back(move(seg.value()));
+            }
+        }
+    }
+
+    if (_unread.empty()) {
+        return {};
+    }
+    auto seg = move(_unread.front());
+    _unread.pop_front();
+    return seg;
+}
+
+//! \details Each datagram is filtered exactly as by read(), in the order received, so a SYN that ends
+//! listening also determines which of the datagrams after it in the same batch are accepted. With GRO, the
+//! kernel hands over a flow's datagrams joined together, and they are split apart again here.
+vector<TCPSegment> TCPOverUDPSocketAdapter::read_batch() {
+    if (not _batched) {
+        _sock.enable_gro();
+        _batched = true;
+    }
+
+    // segments left over from read() come first, without reading the socket (which may have nothing more)
+    if (not _unread.empty()) {
+        vector<TCPSegment> ret(make_move_iterator(_unread.begin()), make_move_iterator(_unread.end()));
+        _unread.clear();
+        return ret;
+    }
 
+    vector<TCPSegment> ret;
+    for (auto &datagram : _sock.recv_batch(MAX_BATCH)) {
+        auto seg = accept(move(datagram));
+        if (seg) {
+            ret.push_back(move(seg.value()));
+        }
+    }
+    return ret;
+}
+
+//! \param[in] datagram is the received UDP datagram
+optional<TCPSegment> TCPOverUDPSocketAdapter::accept(UDPSocket::received_buffer &&datagram) {
     // is it for us?
     if (not listening() and (datagram.source_address != config().destination)) {
         return {};
@@ -47,10 +98,28 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
 
 //! Serialize a TCP segment and send it as the payload of a UDP datagram.
 //! \param[in] seg is the TCP segment to write
-void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
+void TCPOverUDPSocketAdapter::write(TCPSegment &&seg) {
+    address(seg);
+    _sock.sendto(config().destination, seg.serialize(0));
+}
+
+//! \param[in,out] segments are the TCP segments to write; they are popped as they are serialized
+void TCPOverUDPSocketAdapter::write_batch(queue<TCPSegment> &segments) {
+    // the serialized segments must outlive the views of them handed to send_batch
+    vector<BufferList> datagrams;
+    datagrams.reserve(segments.size());
+    while (not segments.empty()) {
+        address(segments.front());
+        datagrams.push_back(segments.front().serialize(0));
+        segments.pop();
+    }
+    _sock.send_batch(config().destination, vector<BufferViewList>(datagrams.begin(), datagrams.end()));
+}
+
+//! \param[in,out] seg is the TCP segment to address
+void TCPOverUDPSocketAdapter::address(TCPSegment &seg) const {
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
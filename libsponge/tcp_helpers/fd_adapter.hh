@@ -8,8 +8,11 @@
 #include "tcp_header.hh"
 #include "tcp_segment.hh"
 
+#include <deque>
 #include <optional>
+#include <queue>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
@@ -40,22 +43,55 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! Milliseconds until tick() could next do something (never, by default)
+    std::optional<size_t> next_deadline() const { return {}; }
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
+//! \details Read with either read() or read_batch(), not both. Receive offload (GRO), which lets the kernel
+//! hand over several of a flow's datagrams as one, is turned on only by the first call to read_batch(), since
+//! read() would have to keep the extra segments of a coalesced datagram for later calls, and an EventLoop
+//! waiting for the socket to become readable would not know they were there. A caller that does mix the two
+//! must call read() until it returns nothing (or call read_batch()) before waiting for the socket again.
 class TCPOverUDPSocketAdapter : public FdAdapterBase {
   private:
     UDPSocket _sock;
 
+    //! Segments received (split out of a datagram coalesced by GRO) but not yet returned by read()
+    std::deque<TCPSegment> _unread{};
+
+    //! Whether read_batch() has been called (and so has tried to turn GRO on)
+    bool _batched = false;
+
+    //! Most datagrams taken from the socket by one read_batch()
+    static constexpr size_t MAX_BATCH = 32;
+
+    //! Parse a received datagram, returning the TCP segment it carries if it is related to the current connection
+    std::optional<TCPSegment> accept(UDPSocket::received_buffer &&datagram);
+
+    //! Stamp a segment with the connection's ports before it is sent
+    void address(TCPSegment &seg) const;
+
   public:
-    //! Construct from a UDPSocket sliced into a FileDescriptor
-    explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
+    //! Construct from a UDPSocket sliced into a FileDescriptor, enabling UDP segmentation offload (GSO) if the
+    //! kernel supports it
+    explicit TCPOverUDPSocketAdapter(UDPSocket &&sock);
 
-    //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
+    //! \brief Attempts to read and return a TCP segment related to the current connection from a UDP payload
+    //! \note Once read_batch() has been called, may leave segments for later calls (see the class notes).
     std::optional<TCPSegment> read();
 
     //! Writes a TCP segment into a UDP payload
-    void write(TCPSegment &seg);
+    void write(TCPSegment &&seg);
+
+    //! \brief Reads every datagram already queued on the socket (up to a limit) with one system call, returning
+    //! the TCP segments related to the current connection
+    //! \details The first call turns on GRO, if the kernel supports it.
+    std::vector<TCPSegment> read_batch();
+
+    //! Writes all of `segments` (leaving it empty), each into its own UDP payload, with one system call
+    void write_batch(std::queue<TCPSegment> &segments);
 
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
@@ -0,0 +1,35 @@
+#include "flow_key.hh"
+
+#include "ipv4_header.hh"
+
+#include <functional>
+#include <string_view>
+
+using namespace std;
+
+bool FlowKey::operator==(const FlowKey &other) const {
+    return local_address == other.local_address and local_port == other.local_port and
+           remote_address == other.remote_address and remote_port == other.remote_port;
+}
+
+size_t FlowKeyHash::operator()(const FlowKey &key) const {
+    const uint64_t addresses = (uint64_t(key.local_address) << 32) | key.remote_address;
+    const uint32_t ports = (uint32_t(key.local_port) << 16) | key.remote_port;
+    return hash<uint64_t>{}(addresses) ^ (hash<uint32_t>{}(ports) * 0x9e3779b97f4a7c15ULL);
+}
+
+//! \param[in] datagram is an IPv4 datagram
+optional<FlowKey> flow_of(const InternetDatagram &datagram) {
+    // peek at the ports (the first four bytes of the TCP header)
+    if (datagram.header().proto != IPv4Header::PROTO_TCP or datagram.payload().buffers().empty()) {
+        return {};
+    }
+    const string_view tcp_header = datagram.payload().buffers().front();
+    if (tcp_header.size() < 4) {
+        return {};
+    }
+    const auto port_at = [&](const size_t offset) {
+        return uint16_t((uint8_t(tcp_header[offset]) << 8) | uint8_t(tcp_header[offset + 1]));
+    };
+    return FlowKey{datagram.header().dst, port_at(2), datagram.header().src, port_at(0)};
+}
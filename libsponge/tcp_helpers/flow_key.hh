@@ -0,0 +1,30 @@
+#ifndef SPONGE_LIBSPONGE_FLOW_KEY_HH
+#define SPONGE_LIBSPONGE_FLOW_KEY_HH
+
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+//! The addresses (numeric) and ports of a TCP flow, as seen from our side; the remote half is zero for a listener
+struct FlowKey {
+    uint32_t local_address;   //!< Our IPv4 address (zero for any)
+    uint16_t local_port;      //!< Our port
+    uint32_t remote_address;  //!< The peer's IPv4 address
+    uint16_t remote_port;     //!< The peer's port
+
+    //! Equality, for lookups
+    bool operator==(const FlowKey &other) const;
+};
+
+//! Hash of a FlowKey
+struct FlowKeyHash {
+    size_t operator()(const FlowKey &key) const;
+};
+
+//! \brief The flow of the TCP segment in an IPv4 datagram, as seen by its receiver (only the ports are parsed)
+//! \returns `std::nullopt` if the datagram does not carry (the start of) a TCP segment
+std::optional<FlowKey> flow_of(const InternetDatagram &datagram);
+
+#endif  // SPONGE_LIBSPONGE_FLOW_KEY_HH
@@ -5,22 +5,53 @@
 
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 using namespace std;
 
 ParseResult IPv4Datagram::parse(const Buffer buffer) {
     NetParser p{buffer};
-    _header.parse(p);
+    const ParseResult header_result = _header.parse(p);
     _payload = p.buffer();
+    _received = Buffer{};
 
     if (_payload.size() != _header.payload_length()) {
         return ParseResult::PacketTooShort;
     }
 
+    if (header_result == ParseResult::NoError and not p.error()) {
+        _received = buffer;
+    }
     return p.get_error();
 }
 
+void IPv4Datagram::decrement_ttl() {
+    _header.decrement_ttl();
+    if (_received.empty()) {
+        return;
+    }
+
+    // drop the payload's share of the bytes, so that if nothing else holds them they can be patched in place
+    _payload = BufferList{};
+    char *bytes = _received.mutable_data();
+    if (not bytes) {
+        _received = Buffer::copy_of(_received);
+        bytes = _received.mutable_data();
+    }
+    bytes[8] = _header.ttl;
+    bytes[10] = _header.cksum >> 8;
+    bytes[11] = _header.cksum & 0xff;
+
+    Buffer payload = _received;
+    payload.remove_prefix(4 * _header.hlen);
+    _payload = move(payload);
+}
+
 BufferList IPv4Datagram::serialize() const {
+    if (not _received.empty()) {
+        return BufferList{_received};
+    }
+
     if (_payload.size() != _header.payload_length()) {
         throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
     }
@@ -10,20 +10,37 @@ class IPv4Datagram {
     IPv4Header _header{};
     BufferList _payload{};
 
+    //! The datagram as parsed, while it still matches the header and payload (empty once it may not)
+    Buffer _received{};
+
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer);
 
     //! \brief Serialize the segment to a string
+    //! \details A datagram that was parsed and has not been changed since (except by decrement_ttl())
+    //! serializes to the bytes it was parsed from, without rebuilding the header.
     BufferList serialize() const;
 
+    //! \brief Decrement the TTL (as a router does before forwarding), updating the checksum incrementally
+    //! \details If the datagram still holds the bytes it was parsed from, patches the TTL and checksum
+    //! there too (in place, unless another Buffer shares them).
+    void decrement_ttl();
+
     //! \name Accessors
+    //! \note Taking a non-const reference to the header or payload means serialize() rebuilds the datagram.
     //!@{
     const IPv4Header &header() const { return _header; }
-    IPv4Header &header() { return _header; }
+    IPv4Header &header() {
+        _received = Buffer{};
+        return _header;
+    }
 
     const BufferList &payload() const { return _payload; }
-    BufferList &payload() { return _payload; }
+    BufferList &payload() {
+        _received = Buffer{};
+        return _payload;
+    }
     //!@}
 };
 
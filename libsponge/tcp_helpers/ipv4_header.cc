@@ -111,6 +111,19 @@ string IPv4Header::serialize() const {
 
 uint16_t IPv4Header::payload_length() const { return len - 4 * hlen; }
 
+//! \details An incremental update as in [RFC 1624](\ref rfc::rfc1624) (eqn. 3): HC' = ~(~HC + ~m + m'),
+//! where `m` is the 16-bit word holding the TTL and the protocol, before and after.
+void IPv4Header::decrement_ttl() {
+    const uint16_t old_word = (ttl << 8) | proto;
+    ttl--;
+    const uint16_t new_word = (ttl << 8) | proto;
+
+    uint32_t sum = uint16_t(~cksum) + uint16_t(~old_word) + new_word;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    cksum = ~sum;
+}
+
 //! \details This value is needed when computing the checksum of an encapsulated TCP segment.
 //! ~~~{.txt}
 //!   0      7 8     15 16    23 24    31
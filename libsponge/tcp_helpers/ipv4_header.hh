@@ -9,6 +9,7 @@ struct IPv4Header {
     static constexpr size_t LENGTH = 20;         //!< [IPv4](\ref rfc::rfc791) header length, not including options
     static constexpr uint8_t DEFAULT_TTL = 128;  //!< A reasonable default TTL value
     static constexpr uint8_t PROTO_TCP = 6;      //!< Protocol number for [tcp](\ref rfc::rfc793)
+    static constexpr uint8_t PROTO_UDP = 17;     //!< Protocol number for [udp](\ref rfc::rfc768)
 
     //! \struct IPv4Header
     //! ~~~{.txt}
@@ -55,6 +56,10 @@ struct IPv4Header {
     //! Length of the payload
     uint16_t payload_length() const;
 
+    //! \brief Decrement the TTL, updating the checksum to match without recomputing it
+    //! \details Assumes `cksum` was correct (e.g. the header was parsed).
+    void decrement_ttl();
+
     //! [pseudo-header's](\ref rfc::rfc793) contribution to the TCP checksum
     uint32_t pseudo_cksum() const;
 
@@ -6,11 +6,13 @@
 #include "tcp_segment.hh"
 #include "util.hh"
 
+#include <algorithm>
 #include <optional>
+#include <queue>
 #include <random>
 #include <utility>
 
-//! An adapter class that adds random dropping behavior to an FD adapter
+//! An adapter class that adds random dropping (and reordering) behavior to an FD adapter
 template <typename AdapterT>
 class LossyFdAdapter {
   private:
@@ -29,6 +31,25 @@ class LossyFdAdapter {
         return loss != 0 && uint16_t(_rand()) < loss;
     }
 
+    //! A segment held back to be written after the next one
+    std::optional<TCPSegment> _held{};
+
+    //! \brief Queue a segment to be written, unless it is to be held back; a segment held back before it follows it
+    //! \param[in] seg is the segment to be written
+    //! \param[in,out] out is the queue of segments to be written
+    void _reorder(TCPSegment &&seg, std::queue<TCPSegment> &out) {
+        const uint16_t rate = _adapter.config().reorder_rate;
+        if (not _held.has_value() and rate != 0 and uint16_t(_rand()) < rate) {
+            _held = std::move(seg);
+            return;
+        }
+        out.push(std::move(seg));
+        if (_held.has_value()) {
+            out.push(std::move(_held.value()));
+            _held.reset();
+        }
+    }
+
   public:
     //! Conversion to a FileDescriptor by returning the underlying AdapterT
     operator const FileDescriptor &() const { return _adapter; }
@@ -49,11 +70,40 @@ class LossyFdAdapter {
 
     //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
     //! \param[in] seg is the packet to either write or drop
-    void write(TCPSegment &seg) {
+    void write(TCPSegment &&seg) {
         if (_should_drop(true)) {
             return;
         }
-        return _adapter.write(seg);
+        std::queue<TCPSegment> out{};
+        _reorder(std::move(seg), out);
+        for (; not out.empty(); out.pop()) {
+            _adapter.write(std::move(out.front()));
+        }
+    }
+
+    //! \brief Read a batch from the underlying AdapterT instance, potentially dropping each segment
+    //! \note Only available if AdapterT has a `read_batch()` method
+    template <typename A = AdapterT>
+    auto read_batch() -> decltype(std::declval<A &>().read_batch()) {
+        auto segments = _adapter.read_batch();
+        const auto dropped = [&](const TCPSegment &) { return _should_drop(false); };
+        segments.erase(std::remove_if(segments.begin(), segments.end(), dropped), segments.end());
+        return segments;
+    }
+
+    //! \brief Write a batch to the underlying AdapterT instance, potentially dropping each segment
+    //! \param[in,out] segments are the packets to either write or drop (leaving it empty)
+    //! \note Only available if AdapterT has a `write_batch()` method
+    template <typename A = AdapterT>
+    auto write_batch(std::queue<TCPSegment> &segments) -> decltype(std::declval<A &>().write_batch(segments)) {
+        std::queue<TCPSegment> kept{};
+        while (not segments.empty()) {
+            if (not _should_drop(true)) {
+                _reorder(std::move(segments.front()), kept);
+            }
+            segments.pop();
+        }
+        return _adapter.write_batch(kept);
     }
 
     //! \name
@@ -64,8 +114,15 @@ class LossyFdAdapter {
     const FdAdapterConfig &config() const { return _adapter.config(); }  //!< FdAdapterBase::config passthrough
     FdAdapterConfig &config_mut() { return _adapter.config_mut(); }      //!< FdAdapterBase::config_mut passthrough
     void tick(const size_t ms_since_last_tick) {
+        if (_held.has_value()) {  // don't hold a segment back forever if nothing follows it
+            _adapter.write(std::move(_held.value()));
+            _held.reset();
+        }
         _adapter.tick(ms_since_last_tick);
-    }  //!< FdAdapterBase::tick passthrough
+    }  //!< FdAdapterBase::tick passthrough (which also writes a segment held back)
+    std::optional<size_t> next_deadline() const {
+        return _held.has_value() ? 0 : _adapter.next_deadline();
+    }  //!< FdAdapterBase::next_deadline passthrough (but a segment held back is due at the next tick)
     //!@}
 };
 
@@ -0,0 +1,200 @@
+#include "multi_queue_tun_adapter.hh"
+
+#include "eventloop.hh"
+#include "parser.hh"
+#include "util.hh"
+
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] datagram is the datagram to deliver
+void MultiQueueTun::Inbox::push(InternetDatagram &&datagram) {
+    const lock_guard<mutex> lock(_mutex);
+    if (_datagrams.empty()) {
+        _event.raise();
+    }
+    _datagrams.push_back(move(datagram));
+}
+
+//! \details The signal is lowered when the last waiting datagram is taken (under the same lock as push()),
+//! so the descriptor is readable exactly while the inbox is not empty.
+optional<InternetDatagram> MultiQueueTun::Inbox::pop() {
+    const lock_guard<mutex> lock(_mutex);
+    if (_datagrams.empty()) {
+        return {};
+    }
+    auto ret = move(_datagrams.front());
+    _datagrams.pop_front();
+    if (_datagrams.empty()) {
+        _event.lower();
+    } else {
+        _event.register_read();
+    }
+    return ret;
+}
+
+//! \param[in] devname is the name of the TUN device, which must have been created with `multi_queue`
+//! \param[in] queue_count is the number of queues (and worker threads)
+MultiQueueTun::MultiQueueTun(const string &devname, const size_t queue_count) {
+    if (queue_count == 0) {
+        throw runtime_error("MultiQueueTun: need at least one queue");
+    }
+    for (size_t i = 0; i < queue_count; i++) {
+        _queues.push_back(make_unique<Queue>(TunFD(devname, true)));
+    }
+
+    const size_t cpus = max(1U, thread::hardware_concurrency());
+    for (size_t i = 0; i < queue_count; i++) {
+        _queues[i]->worker = thread([this, i, cpus] { serve(*_queues[i], i % cpus); });
+    }
+}
+
+MultiQueueTun::~MultiQueueTun() {
+    _stopping = true;
+    for (auto &queue : _queues) {
+        if (queue->worker.joinable()) {
+            queue->worker.join();
+        }
+    }
+}
+
+//! \param[in] queue is the queue to serve
+//! \param[in] cpu is the CPU to pin the worker to
+void MultiQueueTun::serve(Queue &queue, const size_t cpu) {
+    constexpr int STOP_CHECK_INTERVAL_MS = 100;
+
+    try {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            cerr << "Warning: could not pin TUN queue worker to CPU " << cpu << "\n";
+        }
+
+        EventLoop loop{};
+        loop.add_rule(queue.tun, Direction::In, [&] {
+            InternetDatagram datagram;
+            if (datagram.parse(queue.tun.read_buffer()) == ParseResult::NoError) {
+                dispatch(move(datagram));
+            }
+        });
+
+        while (not _stopping) {
+            if (loop.wait_next_event(STOP_CHECK_INTERVAL_MS) == EventLoop::Result::Exit) {
+                break;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in TUN queue worker: " << e.what() << "\n";
+    }
+}
+
+//! \param[in] datagram is a datagram read from one of the queues
+void MultiQueueTun::dispatch(InternetDatagram &&datagram) {
+    // peek at the ports; the connection parses the rest
+    const auto found = flow_of(datagram);
+    if (not found) {
+        return;
+    }
+
+    // the connection itself, or else a listener on its destination address and port, or on just the port
+    const FlowKey &flow = found.value();
+    const FlowKey listener{flow.local_address, flow.local_port, 0, 0};
+    const FlowKey wildcard_listener{0, flow.local_port, 0, 0};
+
+    shared_ptr<Inbox> inbox;
+    {
+        const shared_lock<shared_mutex> lock(_flows_mutex);
+        for (const auto &key : {flow, listener, wildcard_listener}) {
+            const auto it = _flows.find(key);
+            if (it != _flows.end()) {
+                inbox = it->second;
+                break;
+            }
+        }
+    }
+
+    if (inbox) {
+        inbox->push(move(datagram));
+    }
+}
+
+//! \param[in] flow is the flow whose outgoing datagrams are to be sent
+//! \returns the index of the queue to send them on
+size_t MultiQueueTun::queue_for(const FlowKey &flow) const { return FlowKeyHash{}(flow) % _queues.size(); }
+
+//! \param[in] queue is the index of the queue to send on
+//! \param[in] datagram is the serialized IPv4 datagram
+void MultiQueueTun::write(const size_t queue, const BufferViewList &datagram) {
+    Queue &q = *_queues.at(queue);
+    const lock_guard<mutex> lock(q.write_mutex);
+    q.tun.write(datagram);
+}
+
+//! \param[in] flow is the flow (or, with a zero remote half, the listener)
+//! \param[in] inbox is where to deliver its datagrams
+void MultiQueueTun::add_flow(const FlowKey &flow, const shared_ptr<Inbox> &inbox) {
+    const unique_lock<shared_mutex> lock(_flows_mutex);
+    if (not _flows.emplace(flow, inbox).second) {
+        throw runtime_error("MultiQueueTun: flow is already in use");
+    }
+}
+
+//! \param[in] flow is the flow given to add_flow
+void MultiQueueTun::remove_flow(const FlowKey &flow) {
+    const unique_lock<shared_mutex> lock(_flows_mutex);
+    _flows.erase(flow);
+}
+
+TCPOverIPv4OverMultiQueueTunAdapter::~TCPOverIPv4OverMultiQueueTunAdapter() {
+    if (_device and _registered) {
+        _device->remove_flow(_registered.value());
+    }
+}
+
+//! \details While listening, the flow is just our address and port; once a SYN arrives (see
+//! TCPOverIPv4Adapter::unwrap_tcp_in_ip), it is the full 4-tuple of the connection.
+void TCPOverIPv4OverMultiQueueTunAdapter::update_registration() {
+    MultiQueueTun::FlowKey flow{config().source.ipv4_numeric(), config().source.port(), 0, 0};
+    if (not listening()) {
+        flow.remote_address = config().destination.ipv4_numeric();
+        flow.remote_port = config().destination.port();
+    }
+    if (_registered == flow) {
+        return;
+    }
+
+    if (_registered) {
+        _device->remove_flow(_registered.value());
+        _registered.reset();
+    }
+    _device->add_flow(flow, _inbox);
+    _registered = flow;
+}
+
+optional<TCPSegment> TCPOverIPv4OverMultiQueueTunAdapter::read() {
+    auto datagram = _inbox->pop();
+    if (not datagram) {
+        return {};
+    }
+    auto seg = unwrap_tcp_in_ip(datagram.value());
+    update_registration();  // a SYN may have ended listening
+    return seg;
+}
+
+//! \param[in] seg is the TCP segment to send
+void TCPOverIPv4OverMultiQueueTunAdapter::write(TCPSegment &&seg) {
+    update_registration();
+    _device->write(_device->queue_for(_registered.value()), wrap_tcp_in_ip(seg).serialize());
+}
+
+//! \param[in] l is the new value for the flag
+void TCPOverIPv4OverMultiQueueTunAdapter::set_listening(const bool l) {
+    TCPOverIPv4Adapter::set_listening(l);
+    update_registration();
+}
@@ -0,0 +1,143 @@
+#ifndef SPONGE_LIBSPONGE_MULTI_QUEUE_TUN_ADAPTER_HH
+#define SPONGE_LIBSPONGE_MULTI_QUEUE_TUN_ADAPTER_HH
+
+#include "event_fd.hh"
+#include "flow_key.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_over_ip.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//! \brief A multi-queue TUN device shared by many TCP connections, with one worker thread per queue
+//! \details Each worker is pinned to its own CPU. It reads IPv4 datagrams from its queue and hands
+//! each one to the connection it belongs to, looked up by the datagram's 4-tuple.
+class MultiQueueTun {
+  public:
+    using FlowKey = ::FlowKey;  //!< A flow (or, with a zero remote half, a listener)
+
+    //! \brief Datagrams waiting for one connection
+    //! \details Its file descriptor (an [eventfd(2)](\ref man2::eventfd)) is readable while datagrams are waiting,
+    //! so the connection's EventLoop can wait for it like any other descriptor.
+    class Inbox {
+        EventFD _event{};
+        std::mutex _mutex{};
+        std::deque<InternetDatagram> _datagrams{};
+
+      public:
+        //! Add a datagram (called by a worker)
+        void push(InternetDatagram &&datagram);
+
+        //! Take the oldest datagram, if there is one
+        std::optional<InternetDatagram> pop();
+
+        //! The descriptor to wait on
+        const FileDescriptor &fd() const { return _event; }
+    };
+
+  private:
+    //! One queue of the device and the thread that reads it
+    struct Queue {
+        TunFD tun;                 //!< The queue's file descriptor
+        std::mutex write_mutex{};  //!< Serializes writes from the connections that send on this queue
+        std::thread worker{};      //!< Reads the queue and demultiplexes what it reads
+
+        explicit Queue(TunFD &&fd) : tun(std::move(fd)) {}
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues{};
+
+    std::shared_mutex _flows_mutex{};
+    std::unordered_map<FlowKey, std::shared_ptr<Inbox>, FlowKeyHash> _flows{};
+
+    std::atomic<bool> _stopping{false};
+
+    //! Read and demultiplex datagrams from one queue until the device is destroyed
+    void serve(Queue &queue, const size_t cpu);
+
+    //! Deliver a datagram to the connection it belongs to (or drop it)
+    void dispatch(InternetDatagram &&datagram);
+
+  public:
+    //! \brief Open `queue_count` queues of the existing multi-queue TUN device `devname`, and start their workers
+    MultiQueueTun(const std::string &devname, const size_t queue_count);
+
+    //! Stop the workers
+    ~MultiQueueTun();
+
+    //! \brief The queue that a flow's outgoing datagrams are sent on
+    //! \note The kernel steers the flow's incoming datagrams to the queue it was last sent on, so those
+    //! are read by the same worker.
+    size_t queue_for(const FlowKey &flow) const;
+
+    //! Send a serialized datagram on the given queue
+    void write(const size_t queue, const BufferViewList &datagram);
+
+    //! \brief Deliver datagrams matching `flow` to `inbox`
+    //! \details A datagram that matches no flow exactly goes to the listener (if any) on its destination
+    //! address and port, or failing that on its destination port alone.
+    void add_flow(const FlowKey &flow, const std::shared_ptr<Inbox> &inbox);
+
+    //! Stop delivering datagrams matching `flow`
+    void remove_flow(const FlowKey &flow);
+
+    //! \name
+    //! A MultiQueueTun cannot be copied or moved (its workers refer to it)
+
+    //!@{
+    MultiQueueTun(const MultiQueueTun &other) = delete;
+    MultiQueueTun &operator=(const MultiQueueTun &other) = delete;
+    //!@}
+};
+
+//! \brief A FD adapter for one TCP connection over a MultiQueueTun
+//! \details Like TCPOverIPv4OverTunFdAdapter, but many of these can share one (multi-queue) device: the device's
+//! workers read and demultiplex incoming datagrams, and each connection sends on the queue its 4-tuple hashes to.
+class TCPOverIPv4OverMultiQueueTunAdapter : public TCPOverIPv4Adapter {
+  private:
+    std::shared_ptr<MultiQueueTun> _device;
+    std::shared_ptr<MultiQueueTun::Inbox> _inbox{std::make_shared<MultiQueueTun::Inbox>()};
+    std::optional<MultiQueueTun::FlowKey> _registered{};  //!< The flow the inbox is registered for
+
+    //! (Re-)register the inbox for the flow described by the current configuration
+    void update_registration();
+
+  public:
+    //! Construct a connection's adapter on a shared device
+    explicit TCPOverIPv4OverMultiQueueTunAdapter(const std::shared_ptr<MultiQueueTun> &device) : _device(device) {}
+
+    //! Stop receiving datagrams
+    ~TCPOverIPv4OverMultiQueueTunAdapter();
+
+    //! \name
+    //! Moving transfers the registration
+
+    //!@{
+    TCPOverIPv4OverMultiQueueTunAdapter(TCPOverIPv4OverMultiQueueTunAdapter &&other) noexcept = default;
+    TCPOverIPv4OverMultiQueueTunAdapter &operator=(TCPOverIPv4OverMultiQueueTunAdapter &&other) = delete;
+    //!@}
+
+    //! Takes the next datagram delivered to this connection and unwraps its TCP segment
+    std::optional<TCPSegment> read();
+
+    //! Creates an IPv4 datagram from a TCP segment and sends it on this connection's queue
+    void write(TCPSegment &&seg);
+
+    //! Set the listening flag (registering to receive SYNs for the configured address and port)
+    void set_listening(const bool l);
+
+    //! The descriptor for an EventLoop to wait on (readable while datagrams are waiting)
+    operator const FileDescriptor &() const { return _inbox->fd(); }
+};
+
+#endif  // SPONGE_LIBSPONGE_MULTI_QUEUE_TUN_ADAPTER_HH
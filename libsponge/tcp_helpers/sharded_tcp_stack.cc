@@ -0,0 +1,126 @@
+#include "sharded_tcp_stack.hh"
+
+#include "tun.hh"
+
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] devname is the name of the TUN device, which must have been created with `multi_queue`
+//! \param[in] shards is the number of shards (threads, and queues of the device)
+//! \param[in] config configures every connection
+//! \param[in] setup is called on each shard's thread with its stack (e.g. to listen on it)
+ShardedTCPStack::ShardedTCPStack(const string &devname,
+                                 const size_t shards,
+                                 const TCPConfig &config,
+                                 const SetupT &setup) {
+    if (shards == 0) {
+        throw runtime_error("ShardedTCPStack: need at least one shard");
+    }
+    for (size_t i = 0; i < shards; i++) {
+        auto shard = make_unique<Shard>();
+        for (size_t j = 0; j < shards; j++) {
+            shard->inbound.push_back(make_unique<SPSCRing<InternetDatagram>>(RING_CAPACITY));
+        }
+        _shards.push_back(move(shard));
+    }
+
+    for (size_t i = 0; i < shards; i++) {
+        _shards[i]->thread = thread([this, i, devname, config, setup] { serve(i, devname, config, setup); });
+    }
+
+    unique_lock<mutex> lock(_startup_mutex);
+    _startup_done.wait(lock, [&] { return _started == _shards.size(); });
+    if (_startup_error) {
+        lock.unlock();
+        stop();
+        rethrow_exception(_startup_error);
+    }
+}
+
+ShardedTCPStack::~ShardedTCPStack() { stop(); }
+
+void ShardedTCPStack::stop() {
+    _stopping = true;
+    for (auto &shard : _shards) {
+        shard->doorbell.raise();
+    }
+    for (auto &shard : _shards) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+}
+
+//! \param[in] index is the shard to run
+//! \param[in] devname is the TUN device
+//! \param[in] config configures every connection
+//! \param[in] setup is called with the shard's stack before it starts serving
+void ShardedTCPStack::serve(const size_t index,
+                            const string &devname,
+                            const TCPConfig &config,
+                            const SetupT &setup) {
+    Shard &self = *_shards[index];
+    optional<TCPStack> stack{};
+
+    try {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % max(1U, thread::hardware_concurrency()), &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            cerr << "Warning: could not pin shard " << index << "\n";
+        }
+
+        stack.emplace(TunFD(devname, true), config);
+        stack->set_sharding([this, index](const FlowKey &flow) { return owner(flow) == index; },
+                            [this, index](const FlowKey &flow, InternetDatagram &&datagram) {
+                                Shard &destination = *_shards[owner(flow)];
+                                _forwarded++;
+                                if (not destination.inbound[index]->push(move(datagram))) {
+                                    _dropped++;  // as a full NIC ring would; the peer retransmits
+                                    return;
+                                }
+                                destination.doorbell.raise();
+                            });
+
+        // datagrams from the other shards
+        stack->eventloop().add_rule(self.doorbell, Direction::In, [&] {
+            self.doorbell.lower();
+            for (auto &ring : self.inbound) {
+                while (auto datagram = ring->pop()) {
+                    stack->datagram_received(datagram.value());
+                }
+            }
+        });
+
+        setup(stack.value(), index);
+    } catch (...) {
+        const lock_guard<mutex> lock(_startup_mutex);
+        if (not _startup_error) {
+            _startup_error = current_exception();
+        }
+        _started++;
+        _startup_done.notify_one();
+        return;
+    }
+
+    {
+        const lock_guard<mutex> lock(_startup_mutex);
+        _started++;
+        _startup_done.notify_one();
+    }
+
+    try {
+        while (not _stopping) {
+            if (stack->wait_next_event(-1) == EventLoop::Result::Exit) {
+                break;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in shard " << index << ": " << e.what() << "\n";
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+
+#include "event_fd.hh"
+#include "flow_key.hh"
+#include "ipv4_datagram.hh"
+#include "spsc_ring.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! \brief N TCPStacks on N pinned threads ("shards"), sharing a multi-queue TUN device and nothing else
+class ShardedTCPStack {
+  public:
+    //! Called on each shard's thread before it starts serving, to open its listeners and set its callbacks
+    using SetupT = std::function<void(TCPStack &stack, const size_t shard)>;
+
+  private:
+    static constexpr size_t RING_CAPACITY = 1024;  //!< Datagrams that can wait to cross from one shard to another
+
+    //! One shard's mailbox: the rings through which the other shards hand it datagrams
+    struct Shard {
+        //! Ring from each shard (by index; a shard's ring to itself is unused)
+        std::vector<std::unique_ptr<SPSCRing<InternetDatagram>>> inbound{};
+        EventFD doorbell{};     //!< Raised after pushing onto one of the rings
+        std::thread thread{};   //!< Runs the shard's TCPStack
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards{};
+    std::atomic<bool> _stopping{false};
+    std::atomic<size_t> _forwarded{0};  //!< Datagrams read by one shard for another
+    std::atomic<size_t> _dropped{0};    //!< Of those, the ones dropped because the ring was full
+
+    //! \name Start-up: each shard reports when its stack is ready (or failed)
+    //!@{
+    std::mutex _startup_mutex{};
+    std::condition_variable _startup_done{};
+    size_t _started = 0;
+    std::exception_ptr _startup_error{};
+    //!@}
+
+    //! The shard that owns a flow (software RSS)
+    size_t owner(const FlowKey &flow) const { return FlowKeyHash{}(flow) % _shards.size(); }
+
+    //! Run one shard until the ShardedTCPStack is destroyed
+    void serve(const size_t index, const std::string &devname, const TCPConfig &config, const SetupT &setup);
+
+    //! Stop the shards and wait for them
+    void stop();
+
+  public:
+    //! \brief Open `shards` queues of the multi-queue TUN device `devname`, and start a shard on each
+    //! \details Returns once every shard has run `setup`.
+    ShardedTCPStack(const std::string &devname, const size_t shards, const TCPConfig &config, const SetupT &setup);
+
+    //! Stop the shards (closing their connections)
+    ~ShardedTCPStack();
+
+    //! Number of shards
+    size_t size() const { return _shards.size(); }
+
+    //! Datagrams that arrived on a queue other than their owner's, and had to cross to it
+    size_t forwarded() const { return _forwarded; }
+
+    //! Datagrams dropped because the ring to their owner was full
+    size_t dropped() const { return _dropped; }
+
+    //! \name
+    //! A ShardedTCPStack cannot be copied or moved (its threads refer to it)
+
+    //!@{
+    ShardedTCPStack(const ShardedTCPStack &other) = delete;
+    ShardedTCPStack &operator=(const ShardedTCPStack &other) = delete;
+    //!@}
+};
+
+//! \class ShardedTCPStack
+//! Each shard is a thread pinned to its own CPU, with its own TCPStack: its own connections, timers and
+//! EventLoop, its own queue of the TUN device, and (since Buffer pools are per thread) its own buffers.
+//! Nothing is locked on the data path.
+//!
+//! A flow belongs to the shard its FlowKey hashes to. The kernel delivers a flow's datagrams to the queue
+//! it was last sent from, so once a connection's owner has sent on its own queue, its datagrams arrive
+//! there directly. Until then (e.g. for a SYN, which the kernel places by its own hash), the shard that
+//! reads a datagram passes it to the owner through a lock-free SPSCRing (one per pair of shards) and
+//! raises the owner's doorbell. Each shard listens on the same ports, and picks ports for outgoing
+//! connections whose flows hash to itself.
+
+#endif  // SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
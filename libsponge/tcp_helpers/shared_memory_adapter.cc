@@ -0,0 +1,192 @@
+#include "shared_memory_adapter.hh"
+
+#include "buffer.hh"
+#include "parser.hh"
+#include "util.hh"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] slots is the number of packets that can wait in each direction (a power of two)
+SharedMemoryLink::SharedMemoryLink(const size_t slots)
+    : _slots(slots)
+    , _size(2 * (sizeof(RingIndices) + slots * SLOT_SIZE))
+    , _memory(SystemCall("memfd_create", memfd_create("sponge-link", MFD_CLOEXEC)))
+    , _base(nullptr) {
+    if (slots == 0 or (slots & (slots - 1)) != 0) {
+        throw invalid_argument("SharedMemoryLink: slots must be a power of two");
+    }
+    SystemCall("ftruncate", ftruncate(_memory.fd_num(), _size));
+    void *const base = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _memory.fd_num(), 0);
+    if (base == MAP_FAILED) {
+        SystemCall("mmap", -1);
+    }
+    _base = static_cast<char *>(base);
+    for (const size_t end : {0, 1}) {
+        new (_base + ring_offset(end)) RingIndices{};
+    }
+}
+
+SharedMemoryLink::~SharedMemoryLink() { munmap(_base, _size); }
+
+size_t SharedMemoryLink::ring_offset(const size_t to_end) const {
+    return to_end * (sizeof(RingIndices) + _slots * SLOT_SIZE);
+}
+
+SharedMemoryLink::RingIndices &SharedMemoryLink::indices(const size_t to_end) {
+    return *reinterpret_cast<RingIndices *>(_base + ring_offset(to_end));
+}
+
+char *SharedMemoryLink::slot(const size_t to_end, const uint64_t n) {
+    return _base + ring_offset(to_end) + sizeof(RingIndices) + (n & (_slots - 1)) * SLOT_SIZE;
+}
+
+//! \param[in] link is the link to use
+//! \param[in] end is the end of the link to use (the other end should be used by the peer)
+TCPOverSharedMemoryAdapter::TCPOverSharedMemoryAdapter(const shared_ptr<SharedMemoryLink> &link, const size_t end)
+    : _link(link), _end(end) {
+    if (end > 1) {
+        throw invalid_argument("TCPOverSharedMemoryAdapter: a link has ends 0 and 1");
+    }
+}
+
+//! \details If the TCP FSM is listening, a SYN ends listening and its source port becomes the destination
+//! of future segments (as with TCPOverUDPSocketAdapter); otherwise a segment must be addressed between the
+//! configured ports.
+//! \param[in] seg is the received segment
+//! \param[in] local_port is the configured source port
+//! \param[in,out] remote_port is the configured destination port (set by a SYN that ends listening)
+bool TCPOverSharedMemoryAdapter::accept(const TCPSegment &seg, const uint16_t local_port, uint16_t &remote_port) {
+    if (listening()) {
+        if (seg.header().syn and not seg.header().rst) {
+            remote_port = seg.header().sport;
+            config_mutable().destination = Address(config().destination.ip(), remote_port);
+            set_listening(false);
+            return true;
+        }
+        return false;
+    }
+    return seg.header().sport == remote_port and seg.header().dport == local_port;
+}
+
+//! \param[in] limit is the most slots to take from the ring
+//! \details The doorbell is lowered before the ring is drained, and the head is published before each
+//! fresh look at the tail; the sender does the reverse (see send()), so whenever the ring is left
+//! non-empty, one side or the other sees it and the doorbell is rung again.
+vector<TCPSegment> TCPOverSharedMemoryAdapter::receive(const size_t limit) {
+    EventFD &doorbell = _link->doorbell(_end);
+    SharedMemoryLink::RingIndices &ring = _link->indices(_end);
+    doorbell.lower();
+
+    // looked up once per call (Address::port() is not cheap)
+    const uint16_t local_port = config().source.port();
+    uint16_t remote_port = config().destination.port();
+
+    vector<TCPSegment> ret;
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    size_t taken = 0;
+    for (; taken < limit; taken++) {
+        if (head == _tail) {
+            ring.head.store(head);
+            _tail = ring.tail.load();
+            if (head == _tail) {
+                return ret;
+            }
+        }
+
+        const char *const slot = _link->slot(_end, head);
+        uint32_t length;
+        memcpy(&length, slot, sizeof(length));
+        TCPSegment seg;
+        // the sender didn't compute the checksum: memory doesn't corrupt segments
+        if (seg.parse(Buffer::copy_of({slot + sizeof(length), length}), 0, false) == ParseResult::NoError and
+            accept(seg, local_port, remote_port)) {
+            ret.push_back(move(seg));
+        }
+        head++;
+    }
+
+    // stopped at the limit: if anything is left, keep the doorbell raised for the next call
+    ring.head.store(head);
+    if (head != ring.tail.load()) {
+        doorbell.raise();
+    }
+    return ret;
+}
+
+//! \param[in,out] segments are the segments to send; they are popped as they are copied
+void TCPOverSharedMemoryAdapter::send(queue<TCPSegment> &segments) {
+    const size_t peer = 1 - _end;
+    SharedMemoryLink::RingIndices &ring = _link->indices(peer);
+    const uint64_t first = ring.tail.load(memory_order_relaxed);
+    uint64_t tail = first;
+    const uint16_t local_port = config().source.port();
+    const uint16_t remote_port = config().destination.port();
+
+    for (; not segments.empty(); segments.pop()) {
+        if (tail - _peer_head == _link->slots()) {
+            _peer_head = ring.head.load(memory_order_acquire);
+            if (tail - _peer_head == _link->slots()) {
+                _dropped++;
+                continue;
+            }
+        }
+
+        TCPSegment &seg = segments.front();
+        seg.header().sport = local_port;
+        seg.header().dport = remote_port;
+        const BufferList bytes = seg.serialize(0, true);
+        const uint32_t length = bytes.size();
+        if (sizeof(length) + length > SharedMemoryLink::SLOT_SIZE) {
+            throw runtime_error("TCPOverSharedMemoryAdapter: segment too large for a slot");
+        }
+
+        char *const slot = _link->slot(peer, tail);
+        memcpy(slot, &length, sizeof(length));
+        size_t offset = sizeof(length);
+        for (const auto &buffer : bytes.buffers()) {
+            memcpy(slot + offset, buffer.str().data(), buffer.size());
+            offset += buffer.size();
+        }
+        tail++;
+    }
+
+    if (tail == first) {
+        return;
+    }
+    // publish the batch, then ring the doorbell if the peer had taken everything before it (and so may be asleep)
+    ring.tail.store(tail);
+    if (ring.head.load() == first) {
+        _link->doorbell(peer).raise();
+    }
+}
+
+optional<TCPSegment> TCPOverSharedMemoryAdapter::read() {
+    auto segments = receive(1);
+    if (segments.empty()) {
+        return {};
+    }
+    return move(segments.front());
+}
+
+//! \param[in] seg is the segment to send
+void TCPOverSharedMemoryAdapter::write(TCPSegment &&seg) {
+    queue<TCPSegment> segments;
+    segments.push(move(seg));
+    send(segments);
+}
+
+vector<TCPSegment> TCPOverSharedMemoryAdapter::read_batch() { return receive(_link->slots()); }
+
+//! \param[in,out] segments are the segments to send; they are popped as they are copied
+void TCPOverSharedMemoryAdapter::write_batch(queue<TCPSegment> &segments) { send(segments); }
+
+//! Specialize LossyFdAdapter to TCPOverSharedMemoryAdapter
+template class LossyFdAdapter<TCPOverSharedMemoryAdapter>;
@@ -0,0 +1,122 @@
+#ifndef SPONGE_LIBSPONGE_SHARED_MEMORY_ADAPTER_HH
+#define SPONGE_LIBSPONGE_SHARED_MEMORY_ADAPTER_HH
+
+#include "event_fd.hh"
+#include "fd_adapter.hh"
+#include "file_descriptor.hh"
+#include "lossy_fd_adapter.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <vector>
+
+//! \brief A point-to-point "wire" with two ends (0 and 1), made of two rings of packets in shared memory
+//! \details The rings live in a [memfd](\ref man2::memfd_create) mapped with `MAP_SHARED`, and each end has an
+//! [eventfd](\ref man2::eventfd) "doorbell", readable while packets may be waiting for it. Both survive a
+//! [fork](\ref man2::fork), so the ends can be used by two threads of one process or by a parent and a child.
+class SharedMemoryLink {
+  public:
+    static constexpr size_t SLOT_SIZE = 2048;      //!< Bytes per packet slot, including its length
+    static constexpr size_t DEFAULT_SLOTS = 1024;  //!< Default number of slots in each direction
+
+    //! The part of a ring that both ends write: each index on its own cache line
+    struct RingIndices {
+        alignas(64) std::atomic<uint64_t> head{0};  //!< Next slot to read (written by the receiving end)
+        alignas(64) std::atomic<uint64_t> tail{0};  //!< Next slot to write (written by the sending end)
+    };
+
+  private:
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices must be usable across processes");
+
+    size_t _slots;                        //!< Slots per ring (a power of two)
+    size_t _size;                         //!< Size of the mapping
+    FileDescriptor _memory;               //!< The memfd
+    char *_base;                          //!< Start of the mapping
+    std::array<EventFD, 2> _doorbells{};  //!< Doorbell of each end
+
+    //! Offset of ring `to_end`'s indices in the mapping (its slots follow)
+    size_t ring_offset(const size_t to_end) const;
+
+  public:
+    //! Create a link with `slots` slots (a power of two) in each direction
+    explicit SharedMemoryLink(const size_t slots = DEFAULT_SLOTS);
+
+    //! Unmap the rings
+    ~SharedMemoryLink();
+
+    //! Number of slots in each direction
+    size_t slots() const { return _slots; }
+
+    //! Indices of the ring carrying packets to end `to_end`
+    RingIndices &indices(const size_t to_end);
+
+    //! Slot `n` (modulo the ring size) of the ring carrying packets to end `to_end`
+    char *slot(const size_t to_end, const uint64_t n);
+
+    //! The doorbell of end `end`
+    EventFD &doorbell(const size_t end) { return _doorbells.at(end); }
+
+    //! \name
+    //! A SharedMemoryLink cannot be copied or moved (share it through a std::shared_ptr)
+
+    //!@{
+    SharedMemoryLink(const SharedMemoryLink &other) = delete;
+    SharedMemoryLink &operator=(const SharedMemoryLink &other) = delete;
+    //!@}
+};
+
+//! \brief A FD adapter that carries TCP segments over one end of a SharedMemoryLink
+//! \details Segments are serialized into the peer's ring without computing checksums (the wire cannot
+//! corrupt them), and the peer's doorbell is rung only if it may have gone to sleep on an empty ring.
+//! A segment written while the ring is full is dropped, as a full NIC queue would drop it.
+class TCPOverSharedMemoryAdapter : public FdAdapterBase {
+  private:
+    std::shared_ptr<SharedMemoryLink> _link;
+    size_t _end;  //!< Which end of the link this is
+
+    uint64_t _peer_head = 0;  //!< Last look at the head of the outbound ring (to see if it has room)
+    uint64_t _tail = 0;       //!< Last look at the tail of the inbound ring (to see if it has packets)
+    size_t _dropped = 0;      //!< Segments dropped because the outbound ring was full
+
+    //! Whether a received segment is for this connection (ending listening on a SYN)
+    bool accept(const TCPSegment &seg, const uint16_t local_port, uint16_t &remote_port);
+
+    //! Take the segments waiting in the inbound ring, up to `limit`
+    std::vector<TCPSegment> receive(const size_t limit);
+
+    //! Copy segments into the outbound ring (dropping any that don't fit) and ring the peer if needed
+    void send(std::queue<TCPSegment> &segments);
+
+  public:
+    //! Construct the adapter for end `end` (0 or 1) of `link`
+    TCPOverSharedMemoryAdapter(const std::shared_ptr<SharedMemoryLink> &link, const size_t end);
+
+    //! Takes the next segment waiting for this connection, if there is one
+    std::optional<TCPSegment> read();
+
+    //! Sends a segment to the other end
+    void write(TCPSegment &&seg);
+
+    //! Takes every segment waiting for this connection
+    std::vector<TCPSegment> read_batch();
+
+    //! Sends all of `segments` (leaving it empty) to the other end, ringing its doorbell at most once
+    void write_batch(std::queue<TCPSegment> &segments);
+
+    //! Segments dropped so far because the other end's ring was full
+    size_t dropped() const { return _dropped; }
+
+    //! The descriptor for an EventLoop to wait on (this end's doorbell; it is always writable)
+    operator const FileDescriptor &() const { return _link->doorbell(_end); }
+};
+
+//! Typedef for TCPOverSharedMemoryAdapter that can drop and reorder segments
+using LossyTCPOverSharedMemoryAdapter = LossyFdAdapter<TCPOverSharedMemoryAdapter>;
+
+#endif  // SPONGE_LIBSPONGE_SHARED_MEMORY_ADAPTER_HH
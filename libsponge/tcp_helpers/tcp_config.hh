@@ -30,6 +30,7 @@ class FdAdapterConfig {
 
     uint16_t loss_rate_dn = 0;  //!< Downlink loss rate (for LossyFdAdapter)
     uint16_t loss_rate_up = 0;  //!< Uplink loss rate (for LossyFdAdapter)
+    uint16_t reorder_rate = 0;  //!< Rate of holding an uplink segment back until after the next (for LossyFdAdapter)
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_CONFIG_HH
@@ -9,11 +9,14 @@ using namespace std;
 
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
-ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum) {
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(buffer);
-    if (check.value()) {
-        return ParseResult::BadChecksum;
+//! \param[in] verify_checksum is whether to check the checksum
+ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum, const bool verify_checksum) {
+    if (verify_checksum) {
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(buffer);
+        if (check.value()) {
+            return ParseResult::BadChecksum;
+        }
     }
 
     NetParser p{buffer};
@@ -27,15 +30,21 @@ size_t TCPSegment::length_in_sequence_space() const {
 }
 
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
-BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
+//! \param[in] partial_checksum is whether to leave the checksum over the segment itself to the device
+BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum, const bool partial_checksum) const {
     TCPHeader header_out = _header;
     header_out.cksum = 0;
 
-    // calculate checksum -- taken over entire segment
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
-    check.add(_payload);
-    header_out.cksum = check.value();
+    if (partial_checksum) {
+        // the device sums the segment (including this field) and stores the complement
+        header_out.cksum = uint16_t(~InternetChecksum(datagram_layer_checksum).value());
+    } else {
+        // calculate checksum -- taken over entire segment
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(header_out.serialize());
+        check.add(_payload);
+        header_out.cksum = check.value();
+    }
 
     BufferList ret;
     ret.append(header_out.serialize());
@@ -14,10 +14,16 @@ class TCPSegment {
 
   public:
     //! \brief Parse the segment from a string
-    ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
+    //! \note Pass `verify_checksum = false` only if the checksum is known to be good (or known not to have been
+    //! computed yet, as for a packet handed over by the kernel with checksum offload).
+    ParseResult parse(const Buffer buffer,
+                      const uint32_t datagram_layer_checksum = 0,
+                      const bool verify_checksum = true);
 
     //! \brief Serialize the segment to a string
-    BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
+    //! \note With `partial_checksum`, the checksum field holds only the sum of `datagram_layer_checksum`, for a
+    //! device with checksum offload to complete (and the payload isn't read at all).
+    BufferList serialize(const uint32_t datagram_layer_checksum = 0, const bool partial_checksum = false) const;
 
     //! \name Accessors
     //!@{
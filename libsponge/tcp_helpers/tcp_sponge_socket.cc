@@ -1,5 +1,6 @@
 #include "tcp_sponge_socket.hh"
 
+#include "io_uring.hh"
 #include "network_interface.hh"
 #include "parser.hh"
 #include "tun.hh"
@@ -8,30 +9,73 @@
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <limits>
+#include <queue>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <type_traits>
 #include <unistd.h>
 #include <utility>
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! Whether AdaptT can read and write whole batches of segments (e.g. TCPOverUDPSocketAdapter)
+template <typename AdaptT, typename = void>
+struct supports_batches : false_type {};
+
+//! Detects the `read_batch()` and `write_batch()` methods
+template <typename AdaptT>
+struct supports_batches<AdaptT,
+                        void_t<decltype(declval<AdaptT &>().read_batch()),
+                               decltype(declval<AdaptT &>().write_batch(declval<queue<TCPSegment> &>()))>>
+    : true_type {};
 
 //! \param[in] condition is a function returning true if loop should continue
+//! \details Rather than waking up at a fixed interval to pass the time to the TCPConnection and the adapter,
+//! the loop asks them when time will next matter (see TCPConnection::next_deadline) and sets a timer for then.
+//! An idle connection sleeps until a datagram or the application wakes it.
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()> &condition) {
+    constexpr uint64_t NEVER = numeric_limits<uint64_t>::max();
     auto base_time = timestamp_ms();
+    uint64_t timer_expiry = NEVER;  // when the timer is set to expire (in terms of timestamp_ms)
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        uint64_t expiry = NEVER;
+        if (_tcp.value().active()) {
+            const auto deadline = min(_tcp.value().next_deadline().value_or(NEVER),
+                                      _datagram_adapter.next_deadline().value_or(NEVER));
+            if (deadline != NEVER) {
+                expiry = base_time + deadline;
+            }
+        }
+        if (expiry != timer_expiry) {
+            if (expiry != NEVER) {
+                const auto now = timestamp_ms();
+                _timer.arm(expiry > now ? expiry - now : 0);
+            } else {
+                _timer.disarm();
+            }
+            timer_expiry = expiry;
+        }
+
+        // checked after setting the timer, which the owner expires to wake this thread after setting _abort
+        if (_abort) {
+            break;
+        }
+
+        auto ret = _eventloop.wait_next_event(-1);
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
 
+        const auto next_time = timestamp_ms();
+        if (next_time >= timer_expiry) {
+            timer_expiry = NEVER;  // the timer has gone off (or is about to), so set it again
+        }
         if (_tcp.value().active()) {
-            const auto next_time = timestamp_ms();
             _tcp.value().tick(next_time - base_time);
             _datagram_adapter.tick(next_time - base_time);
             base_time = next_time;
@@ -76,9 +120,15 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _eventloop.add_rule(_datagram_adapter,
                         Direction::In,
                         [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
+                            if constexpr (supports_batches<AdaptT>::value) {
+                                for (auto &seg : _datagram_adapter.read_batch()) {
+                                    _tcp->segment_received(move(seg));
+                                }
+                            } else {
+                                auto seg = _datagram_adapter.read();
+                                if (seg) {
+                                    _tcp->segment_received(move(seg.value()));
+                                }
                             }
 
                             // debugging output:
@@ -132,6 +182,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
             const std::string buffer = inbound.peek_output(amount_to_write);
             const auto bytes_written = _thread_data.write(move(buffer), false);
             inbound.pop_output(bytes_written);
+            _tcp->inbound_stream_read();
 
             if (inbound.eof() or inbound.error()) {
                 _thread_data.shutdown(SHUT_WR);
@@ -150,13 +201,24 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                    ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
         });
 
+    // rule 5: wake up when the timer set by _tcp_loop expires (_tcp_loop then passes the time to the TCPConnection)
+    _eventloop.add_rule(
+        _timer, Direction::In, [&] { _timer.read_expirations(); }, [&] { return _tcp->active(); });
+
     // rule 4: read outbound segments from TCPConnection and send as datagrams
     _eventloop.add_rule(_datagram_adapter,
                         Direction::Out,
                         [&] {
-                            while (not _tcp->segments_out().empty()) {
-                                _datagram_adapter.write(_tcp->segments_out().front());
-                                _tcp->segments_out().pop();
+                            if constexpr (supports_batches<AdaptT>::value) {
+                                _datagram_adapter.write_batch(_tcp->segments_out());
+                            } else {
+                                // submit all of the segments' writes with one system call (if io_uring is available)
+                                IOUringWriteBatch batch{};
+                                while (not _tcp->segments_out().empty()) {
+                                    _datagram_adapter.write(std::move(_tcp->segments_out().front()));
+                                    _tcp->segments_out().pop();
+                                }
+                                batch.flush();
                             }
                         },
                         [&] { return not _tcp->segments_out().empty(); });
@@ -183,6 +245,7 @@ TCPSpongeSocket<AdaptT>::~TCPSpongeSocket() {
             cerr << "Warning: unclean shutdown of TCPSpongeSocket\n";
             // force the other side to exit
             _abort.store(true);
+            _timer.arm(0);
             _tcp_thread.join();
         }
     } catch (const exception &e) {
@@ -279,12 +342,21 @@ template class TCPSpongeSocket<TCPOverIPv4OverTunFdAdapter>;
 //! Specialization of TCPSpongeSocket for TCPOverIPv4OverEthernetAdapter
 template class TCPSpongeSocket<TCPOverIPv4OverEthernetAdapter>;
 
+//! Specialization of TCPSpongeSocket for TCPOverIPv4OverMultiQueueTunAdapter
+template class TCPSpongeSocket<TCPOverIPv4OverMultiQueueTunAdapter>;
+
+//! Specialization of TCPSpongeSocket for TCPOverSharedMemoryAdapter
+template class TCPSpongeSocket<TCPOverSharedMemoryAdapter>;
+
 //! Specialization of TCPSpongeSocket for LossyTCPOverUDPSocketAdapter
 template class TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 
 //! Specialization of TCPSpongeSocket for LossyTCPOverIPv4OverTunFdAdapter
 template class TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
 
+//! Specialization of TCPSpongeSocket for LossyTCPOverSharedMemoryAdapter
+template class TCPSpongeSocket<LossyTCPOverSharedMemoryAdapter>;
+
 CS144TCPSocket::CS144TCPSocket() : TCPOverIPv4SpongeSocket(TCPOverIPv4OverTunFdAdapter(TunFD("tun144"))) {}
 
 void CS144TCPSocket::connect(const Address &address) {
@@ -5,9 +5,12 @@
 #include "eventloop.hh"
 #include "fd_adapter.hh"
 #include "file_descriptor.hh"
+#include "multi_queue_tun_adapter.hh"
 #include "network_interface.hh"
+#include "shared_memory_adapter.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
+#include "timer_fd.hh"
 #include "tuntap_adapter.hh"
 
 #include <atomic>
@@ -37,6 +40,9 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
     EventLoop _eventloop{};
 
+    //! Expires when the TCPConnection or the adapter next needs to be told the time
+    TimerFD _timer{};
+
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
 
@@ -99,9 +105,12 @@ class TCPSpongeSocket : public LocalStreamSocket {
 using TCPOverUDPSpongeSocket = TCPSpongeSocket<TCPOverUDPSocketAdapter>;
 using TCPOverIPv4SpongeSocket = TCPSpongeSocket<TCPOverIPv4OverTunFdAdapter>;
 using TCPOverIPv4OverEthernetSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverEthernetAdapter>;
+using TCPOverIPv4OverMultiQueueTunSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverMultiQueueTunAdapter>;
+using TCPOverSharedMemorySpongeSocket = TCPSpongeSocket<TCPOverSharedMemoryAdapter>;
 
 using LossyTCPOverUDPSpongeSocket = TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
+using LossyTCPOverSharedMemorySpongeSocket = TCPSpongeSocket<LossyTCPOverSharedMemoryAdapter>;
 
 //! \class TCPSpongeSocket
 //! This class involves the simultaneous operation of two threads.
@@ -0,0 +1,361 @@
+#include "tcp_stack.hh"
+
+#include "parser.hh"
+#include "util.hh"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] tun is the device carrying the connections' IPv4 datagrams
+//! \param[in] config configures every connection (listening or connecting)
+TCPStack::TCPStack(TunFD &&tun, const TCPConfig &config)
+    : _tun(move(tun)), _send([&](InternetDatagram &&datagram) { _tun->write(datagram.serialize()); }), _config(config) {
+    _eventloop.add_rule(_tun.value(), Direction::In, [&] { read_datagram(); });
+}
+
+//! \param[in] send is given each datagram the stack writes
+//! \param[in] config configures every connection (listening or connecting)
+TCPStack::TCPStack(const SendT &send, const TCPConfig &config) : _tun(), _send(send), _config(config) {}
+
+TCPStack::Connection &TCPStack::connection(const SocketId id) {
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        throw runtime_error("TCPStack: no connection " + to_string(id));
+    }
+    return it->second;
+}
+
+const TCPStack::Connection &TCPStack::connection(const SocketId id) const {
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        throw runtime_error("TCPStack: no connection " + to_string(id));
+    }
+    return it->second;
+}
+
+void TCPStack::read_datagram() {
+    InternetDatagram datagram;
+    if (datagram.parse(_tun->read_buffer()) != ParseResult::NoError) {
+        return;
+    }
+    if (_owns) {
+        const auto flow = flow_of(datagram);
+        if (flow and not _owns(flow.value())) {
+            _forward(flow.value(), move(datagram));
+            return;
+        }
+    }
+    datagram_received(datagram);
+}
+
+//! \param[in] datagram is an IPv4 datagram (ignored unless it carries a valid TCP segment)
+void TCPStack::datagram_received(const InternetDatagram &datagram) {
+    if (datagram.header().proto != IPv4Header::PROTO_TCP) {
+        return;
+    }
+    TCPSegment seg;
+    if (seg.parse(datagram.payload(), datagram.header().pseudo_cksum()) != ParseResult::NoError) {
+        return;
+    }
+    const TCPHeader &header = seg.header();
+    const FlowKey flow{datagram.header().dst, header.dport, datagram.header().src, header.sport};
+
+    SocketId id = NO_SOCKET;
+    const auto existing = _flows.find(flow);
+    if (existing != _flows.end()) {
+        id = existing->second;
+    } else if (header.syn and not header.ack and not header.rst) {
+        // a new connection: to the listener on its destination address and port, or on just the port
+        for (const FlowKey &key : {FlowKey{flow.local_address, flow.local_port, 0, 0},
+                                   FlowKey{0, flow.local_port, 0, 0}}) {
+            const auto listener = _flows.find(key);
+            if (listener == _flows.end()) {
+                continue;
+            }
+            Listener &l = _listeners.at(listener->second);
+            if (l.half_open + l.ready.size() >= l.backlog) {
+                return;  // the backlog is full
+            }
+            id = _next_id++;
+            _connections.emplace(piecewise_construct,
+                                 forward_as_tuple(id),
+                                 forward_as_tuple(_config, flow, listener->second, timestamp_ms()));
+            _flows.emplace(flow, id);
+            l.half_open++;
+            break;
+        }
+    }
+    if (id == NO_SOCKET) {
+        return;
+    }
+
+    connection(id).tcp.segment_received(seg);
+    notify(id);
+}
+
+//! \param[in] flow is the connection's flow
+//! \param[in] seg is the segment, whose ports are set from `flow`
+void TCPStack::send(const FlowKey &flow, TCPSegment &seg) {
+    seg.header().sport = flow.local_port;
+    seg.header().dport = flow.remote_port;
+
+    InternetDatagram datagram;
+    datagram.header().src = flow.local_address;
+    datagram.header().dst = flow.remote_address;
+    datagram.header().len = datagram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    datagram.payload() = seg.serialize(datagram.header().pseudo_cksum());
+    _send(move(datagram));
+}
+
+//! \param[in] c is the connection
+//! \returns the current time
+uint64_t TCPStack::pass_time(Connection &c) {
+    const uint64_t now = timestamp_ms();
+    if (now > c.last_tick) {
+        c.tcp.tick(now - c.last_tick);
+        c.last_tick = now;
+    }
+    return now;
+}
+
+//! \param[in] id is the connection (ignored if it has been deleted)
+void TCPStack::update(const SocketId id) {
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    Connection &c = it->second;
+
+    const uint64_t now = pass_time(c);
+    while (not c.tcp.segments_out().empty()) {
+        send(c.flow, c.tcp.segments_out().front());
+        c.tcp.segments_out().pop();
+    }
+
+    const bool active = c.tcp.active();
+
+    // set the timer for the connection's next deadline (if it changed)
+    uint64_t expiry = NEVER;
+    if (active) {
+        const auto deadline = c.tcp.next_deadline();
+        if (deadline) {
+            expiry = now + deadline.value();
+        }
+    }
+    if (expiry != c.timer_expiry) {
+        _eventloop.cancel_timer(c.timer);
+        if (expiry != NEVER) {
+            c.timer = _eventloop.add_timer(expiry - now, [this, id] {
+                connection(id).timer_expiry = NEVER;
+                notify(id);
+            });
+        }
+        c.timer_expiry = expiry;
+    }
+
+    // a half-open connection goes to its listener's queue once established (or is dropped if it failed)
+    SocketId listener_to_notify = NO_SOCKET;
+    if (c.listener != NO_SOCKET) {
+        const auto listener = _listeners.find(c.listener);
+        const auto state = c.tcp.state();
+        if (listener == _listeners.end() or not active) {
+            if (listener != _listeners.end()) {
+                listener->second.half_open--;
+            }
+            c.listener = NO_SOCKET;
+            c.closed = true;  // no owner will ever close it
+            if (active) {
+                c.tcp.end_input_stream();
+            }
+        } else if (not(state == TCPState::State::LISTEN or state == TCPState::State::SYN_RCVD)) {
+            listener->second.half_open--;
+            listener->second.ready.push_back(id);
+            listener_to_notify = c.listener;
+            c.listener = NO_SOCKET;
+        }
+    }
+
+    // a finished connection stops receiving; it is forgotten once the owner is done with it too
+    if (not active) {
+        const auto flow = _flows.find(c.flow);
+        if (flow != _flows.end() and flow->second == id) {
+            _flows.erase(flow);
+        }
+        if (c.closed) {
+            _connections.erase(it);
+        }
+    }
+
+    if (listener_to_notify != NO_SOCKET) {
+        const CallbackT callback = _listeners.at(listener_to_notify).callback;  // a copy, in case it is replaced
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+//! \param[in] id is the connection
+void TCPStack::notify(const SocketId id) {
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    Connection &c = it->second;
+
+    pass_time(c);  // first, so the callback sees the connection's current state
+    if (c.callback and not c.closed) {
+        const CallbackT callback = c.callback;  // a copy: the callback may close (and so delete) the connection
+        callback();
+    }
+    update(id);
+}
+
+//! \param[in] address is our address and port; if the IP is "0", any address of ours
+//! \param[in] backlog is the most connections that may be half-open or waiting to be accepted
+//! \returns the listener's id (see TCPStack::accept)
+TCPStack::SocketId TCPStack::listen(const Address &address, const size_t backlog) {
+    const FlowKey key{address.ipv4_numeric(), address.port(), 0, 0};
+    if (not _flows.emplace(key, _next_id).second) {
+        throw runtime_error("TCPStack: " + address.to_string() + " is already in use");
+    }
+    _listeners.emplace(piecewise_construct, forward_as_tuple(_next_id), forward_as_tuple(key, backlog));
+    return _next_id++;
+}
+
+//! \param[in] listener is the id returned by TCPStack::listen
+//! \returns the id of an established connection, if there is one
+optional<TCPStack::SocketId> TCPStack::accept(const SocketId listener) {
+    const auto it = _listeners.find(listener);
+    if (it == _listeners.end()) {
+        throw runtime_error("TCPStack: no listener " + to_string(listener));
+    }
+    auto &ready = it->second.ready;
+    if (ready.empty()) {
+        return {};
+    }
+    const SocketId id = ready.front();
+    ready.pop_front();
+    return id;
+}
+
+//! \param[in] local is our address, and our port (or 0 to pick an unused one)
+//! \param[in] remote is the peer's address and port
+//! \returns the connection's id (the connection is established once TCPStack::state says so)
+TCPStack::SocketId TCPStack::connect(const Address &local, const Address &remote) {
+    FlowKey flow{local.ipv4_numeric(), local.port(), remote.ipv4_numeric(), remote.port()};
+    if (flow.local_address == 0) {
+        throw runtime_error("TCPStack::connect: need a local IP address");
+    }
+
+    if (flow.local_port == 0) {
+        const auto usable = [&](const uint16_t port) {
+            const FlowKey candidate{flow.local_address, port, flow.remote_address, flow.remote_port};
+            return not(_flows.count(candidate) or _flows.count({flow.local_address, port, 0, 0}) or
+                       _flows.count({0, port, 0, 0})) and
+                   (not _owns or _owns(candidate));
+        };
+        for (unsigned tries = 0; tries <= UINT16_MAX - FIRST_EPHEMERAL_PORT; tries++) {
+            const uint16_t port = _next_port;
+            _next_port = _next_port == UINT16_MAX ? FIRST_EPHEMERAL_PORT : _next_port + 1;
+            if (usable(port)) {
+                flow.local_port = port;
+                break;
+            }
+        }
+        if (flow.local_port == 0) {
+            throw runtime_error("TCPStack::connect: no free ports");
+        }
+    } else if (_owns and not _owns(flow)) {
+        throw runtime_error("TCPStack::connect: " + local.to_string() + " to " + remote.to_string() +
+                            " is another stack's flow");
+    }
+
+    if (not _flows.emplace(flow, _next_id).second) {
+        throw runtime_error("TCPStack::connect: " + local.to_string() + " is already connected to " +
+                            remote.to_string());
+    }
+    const SocketId id = _next_id++;
+    _connections.emplace(
+        piecewise_construct, forward_as_tuple(id), forward_as_tuple(_config, flow, NO_SOCKET, timestamp_ms()));
+    connection(id).tcp.connect();
+    update(id);
+    return id;
+}
+
+//! \param[in] socket is a listener or a connection
+//! \param[in] callback is called (from TCPStack::wait_next_event) when the listener has connections to accept,
+//!                     or when the connection has received a segment or its timer has expired
+void TCPStack::set_callback(const SocketId socket, const CallbackT &callback) {
+    const auto listener = _listeners.find(socket);
+    if (listener != _listeners.end()) {
+        listener->second.callback = callback;
+    } else {
+        connection(socket).callback = callback;
+    }
+}
+
+//! \param[in] owns says whether a flow (of a connection or an incoming segment) belongs to this stack
+//! \param[in] forward is given each datagram read from the device whose flow does not
+void TCPStack::set_sharding(const OwnsT &owns, const ForwardT &forward) {
+    _owns = owns;
+    _forward = forward;
+}
+
+//! \param[in] id is the connection
+//! \param[in] data is the data to write
+size_t TCPStack::write(const SocketId id, const string &data) {
+    const size_t written = connection(id).tcp.write(data);
+    update(id);
+    return written;
+}
+
+//! \param[in] id is the connection
+//! \param[in] limit is the most bytes to read
+string TCPStack::read(const SocketId id, const size_t limit) {
+    TCPConnection &tcp = connection(id).tcp;
+    string ret = tcp.inbound_stream().read(limit);
+    tcp.inbound_stream_read();
+    update(id);
+    return ret;
+}
+
+//! \param[in] id is the connection
+void TCPStack::shutdown(const SocketId id) {
+    connection(id).tcp.end_input_stream();
+    update(id);
+}
+
+//! \param[in] socket is a listener or a connection
+void TCPStack::close(const SocketId socket) {
+    const auto listener = _listeners.find(socket);
+    if (listener != _listeners.end()) {
+        // end the connections no one will accept now (half-open ones are ended by update)
+        const auto ready = move(listener->second.ready);
+        _flows.erase(listener->second.key);
+        _listeners.erase(listener);
+        for (const SocketId id : ready) {
+            close(id);
+        }
+        return;
+    }
+
+    Connection &c = connection(socket);
+    c.closed = true;
+    c.callback = nullptr;
+    if (c.tcp.active()) {
+        c.tcp.end_input_stream();
+    }
+    update(socket);
+}
+
+size_t TCPStack::bytes_readable(const SocketId id) { return connection(id).tcp.inbound_stream().buffer_size(); }
+
+bool TCPStack::eof(const SocketId id) { return connection(id).tcp.inbound_stream().eof(); }
+
+size_t TCPStack::remaining_outbound_capacity(const SocketId id) const {
+    return connection(id).tcp.remaining_outbound_capacity();
+}
+
+TCPState TCPStack::state(const SocketId id) const { return connection(id).tcp.state(); }
@@ -0,0 +1,186 @@
+#ifndef SPONGE_LIBSPONGE_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_STACK_HH
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "flow_key.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "tcp_state.hh"
+#include "tun.hh"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+//! \brief Many TCP connections and listening sockets, sharing one TUN device, one thread and one EventLoop
+class TCPStack {
+  public:
+    using SocketId = uint64_t;                    //!< Identifies a connection or a listener (never reused)
+    using CallbackT = std::function<void(void)>;  //!< Called when something happens on a socket
+    using OwnsT = std::function<bool(const FlowKey &flow)>;  //!< Says whether a flow belongs to this stack
+    using ForwardT = std::function<void(const FlowKey &flow, InternetDatagram &&datagram)>;  //!< Takes the rest
+    using SendT = std::function<void(InternetDatagram &&datagram)>;  //!< Sends a datagram the stack wrote
+
+  private:
+    static constexpr uint64_t NEVER = UINT64_MAX;  //!< Timer expiry meaning "not set"
+    static constexpr SocketId NO_SOCKET = 0;       //!< Not a SocketId
+    static constexpr uint16_t FIRST_EPHEMERAL_PORT = 49152;
+
+    //! A connection, and what the stack keeps track of for it
+    struct Connection {
+        TCPConnection tcp;
+        FlowKey flow;
+        SocketId listener;               //!< While the handshake is in progress, the listener it arrived on
+        uint64_t last_tick;              //!< When it was last told the time (see timestamp_ms)
+        EventLoop::TimerHandle timer{};  //!< Expires at the connection's next deadline
+        uint64_t timer_expiry = NEVER;   //!< When the timer expires
+        CallbackT callback{};            //!< Set by the owner
+        bool closed = false;             //!< Has the owner closed it (or did no owner ever accept it)?
+
+        Connection(const TCPConfig &config, const FlowKey &key, const SocketId listener_id, const uint64_t now)
+            : tcp(config), flow(key), listener(listener_id), last_tick(now) {}
+    };
+
+    //! A listening socket
+    struct Listener {
+        FlowKey key;                   //!< Our address (or zero) and port, with a zero remote half
+        size_t backlog;                //!< Most connections that may be waiting (half-open or to be accepted)
+        size_t half_open = 0;          //!< Connections whose handshake is still in progress
+        std::deque<SocketId> ready{};  //!< Established connections, waiting for TCPStack::accept
+        CallbackT callback{};          //!< Set by the owner
+
+        Listener(const FlowKey &listen_key, const size_t max_waiting) : key(listen_key), backlog(max_waiting) {}
+    };
+
+    std::optional<TunFD> _tun;  //!< The device, unless datagrams go to and come from the owner
+    SendT _send;                //!< Where the datagrams the stack writes go
+    TCPConfig _config;
+    EventLoop _eventloop{EventLoop::Backend::Epoll};
+
+    std::unordered_map<SocketId, Connection> _connections{};
+    std::unordered_map<SocketId, Listener> _listeners{};
+    std::unordered_map<FlowKey, SocketId, FlowKeyHash> _flows{};  //!< Live connections and listeners, by flow
+
+    SocketId _next_id = 1;
+    uint16_t _next_port = FIRST_EPHEMERAL_PORT;
+
+    OwnsT _owns{};        //!< If set, which flows are this stack's (see TCPStack::set_sharding)
+    ForwardT _forward{};  //!< Takes datagrams read from the device for flows that are not
+
+    //! Read a datagram from the device, and handle it or forward it to the stack that owns its flow
+    void read_datagram();
+
+    //! Tell a connection how much time has passed since it was last told; returns the current time
+    uint64_t pass_time(Connection &c);
+
+    //! Wrap a segment in an IPv4 datagram for the given flow and send it
+    void send(const FlowKey &flow, TCPSegment &seg);
+
+    //! \brief Pass the time to a connection, send its segments and set its timer
+    //! \details Also hands a newly established connection to its listener, and deletes a finished one
+    //! once its owner has closed it.
+    void update(const SocketId id);
+
+    //! Call a connection's callback (something happened to it), then update it
+    void notify(const SocketId id);
+
+    //! The connection with this id (throws if there is none)
+    Connection &connection(const SocketId id);
+    const Connection &connection(const SocketId id) const;
+
+  public:
+    //! Serve connections on the given TUN device, each configured with `config`
+    explicit TCPStack(TunFD &&tun, const TCPConfig &config = {});
+
+    //! \brief Serve connections without a device: `send` takes the datagrams the stack writes, and the owner
+    //! hands it the datagrams it receives (see TCPStack::datagram_received)
+    explicit TCPStack(const SendT &send, const TCPConfig &config = {});
+
+    //! \brief Accept connections to `address` (whose IP may be "0" for any), holding up to `backlog` waiting
+    SocketId listen(const Address &address, const size_t backlog);
+
+    //! Take the oldest established connection from a listener, if there is one
+    std::optional<SocketId> accept(const SocketId listener);
+
+    //! Open a connection from `local` (with port 0 for any free port) to `remote`
+    SocketId connect(const Address &local, const Address &remote);
+
+    //! Set the callback called when a listener has connections to accept, or when a connection changes
+    void set_callback(const SocketId socket, const CallbackT &callback);
+
+    //! \brief Share the device with other stacks, each owning some of the flows
+    //! \details Datagrams read from the device for flows that `owns` rejects are handed to `forward`
+    //! (to pass to the stack that owns them, which calls TCPStack::datagram_received). Listeners should be
+    //! opened on every stack; TCPStack::connect only picks ports that make flows this stack owns.
+    void set_sharding(const OwnsT &owns, const ForwardT &forward);
+
+    //! Hand a datagram's segment to the connection (or listener) it belongs to
+    void datagram_received(const InternetDatagram &datagram);
+
+    //! \name Connection I/O
+    //!@{
+
+    //! Write as much of `data` as fits in the outbound stream; returns how much was written
+    size_t write(const SocketId id, const std::string &data);
+
+    //! Read up to `limit` bytes from the inbound stream
+    std::string read(const SocketId id, const size_t limit);
+
+    //! End the outbound stream
+    void shutdown(const SocketId id);
+
+    //! \brief Close a listener (ending its waiting connections) or a connection (ending its outbound stream)
+    //! \details A closed connection is forgotten once it finishes; its id must not be used again.
+    void close(const SocketId socket);
+    //!@}
+
+    //! \name Connection status
+    //!@{
+    size_t bytes_readable(const SocketId id);                     //!< Bytes waiting in the inbound stream
+    bool eof(const SocketId id);                                  //!< Has the whole inbound stream been read?
+    size_t remaining_outbound_capacity(const SocketId id) const;  //!< Bytes TCPStack::write would accept now
+    TCPState state(const SocketId id) const;                      //!< The connection's TCP state
+    //!@}
+
+    //! Number of connections (including those not yet accepted, and closed ones that are still finishing)
+    size_t connection_count() const { return _connections.size(); }
+
+    //! The stack's EventLoop, to which the owner may add its own rules and timers
+    EventLoop &eventloop() { return _eventloop; }
+
+    //! Wait for datagrams, timers and the owner's own events, and handle them (see EventLoop::wait_next_event)
+    EventLoop::Result wait_next_event(const int timeout_ms) { return _eventloop.wait_next_event(timeout_ms); }
+
+    //! \name
+    //! A TCPStack cannot be copied or moved (its EventLoop's rules and timers refer to it)
+
+    //!@{
+    TCPStack(const TCPStack &other) = delete;
+    TCPStack &operator=(const TCPStack &other) = delete;
+    //!@}
+};
+
+//! \class TCPStack
+//! Unlike TCPSpongeSocket, which gives every connection its own adapter, thread and event loop, a TCPStack
+//! serves any number of connections from the thread that calls TCPStack::wait_next_event. Incoming
+//! datagrams are demultiplexed with a hash table keyed by 4-tuple (FlowKey); a SYN that matches no
+//! connection goes to the listener on its destination address and port, or failing that on its port alone.
+//! Each connection's retransmission and linger deadlines are kept as EventLoop timers, so an idle
+//! connection costs nothing per wait.
+//!
+//! The owner's callbacks are called from TCPStack::wait_next_event, and may call any method of the stack
+//! (including TCPStack::close on the socket being notified). All methods must be called from that thread.
+//!
+//! A listener's backlog bounds the connections that are half-open or established but not yet accepted;
+//! SYNs beyond it are dropped, and the peer retransmits them.
+//!
+//! A stack built without a TUN device exchanges its datagrams with the owner instead, e.g. to run over
+//! another kind of link, or to connect two stacks back to back in a test.
+
+#endif  // SPONGE_LIBSPONGE_TCP_STACK_HH
@@ -1,7 +1,144 @@
 #include "tuntap_adapter.hh"
 
+#include "io_uring.hh"
+#include "parser.hh"
+
+#include <cstring>
+
 using namespace std;
 
+//! Most payload bytes in one segment handed to the kernel for segmentation (leaves room for the headers)
+static constexpr size_t MAX_OFFLOAD_PAYLOAD = 65000;
+
+optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::read() {
+    Buffer packet = _tun.read_buffer();
+
+    TunFD::VirtioNetHeader offload_info{};
+    if (_tun.offload()) {
+        if (packet.size() < sizeof(offload_info)) {
+            return {};
+        }
+        memcpy(&offload_info, packet.str().data(), sizeof(offload_info));
+        packet.remove_prefix(sizeof(offload_info));
+    }
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(move(packet)) != ParseResult::NoError) {
+        return {};
+    }
+
+    // the kernel marks packets whose checksum it has checked, or (for its own) hasn't computed at all
+    using VirtioNetHeader = TunFD::VirtioNetHeader;
+    const bool checksum_offloaded =
+        offload_info.flags & (VirtioNetHeader::F_NEEDS_CSUM | VirtioNetHeader::F_DATA_VALID);
+    return unwrap_tcp_in_ip(ip_dgram, not checksum_offloaded);
+}
+
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverTunFdAdapter::write(TCPSegment &&seg) {
+    if (_tun.offload()) {
+        vector<TCPSegment> run;
+        run.push_back(move(seg));
+        _tun.write(wrap_with_offload(run));
+    } else {
+        _tun.write(wrap_tcp_in_ip(seg).serialize());
+    }
+}
+
+vector<TCPSegment> TCPOverIPv4OverTunFdAdapter::read_batch() {
+    vector<TCPSegment> ret;
+    auto seg = read();
+    if (seg) {
+        ret.push_back(move(seg.value()));
+    }
+    return ret;
+}
+
+//! \param[in] head is the first segment of a run
+//! \param[in] prev is the last segment of the run so far
+//! \param[in] next is the candidate to extend the run
+//! \param[in] run_bytes is the payload size of the run so far
+//! \returns whether the kernel can recreate `next` by segmenting the run extended with it
+static bool continues_run(const TCPSegment &head,
+                          const TCPSegment &prev,
+                          const TCPSegment &next,
+                          const size_t run_bytes) {
+    const TCPHeader &h = head.header();
+    const TCPHeader &p = prev.header();
+    const TCPHeader &n = next.header();
+    const size_t segment_size = head.payload().size();
+
+    return prev.payload().size() == segment_size and next.payload().size() > 0 and
+           next.payload().size() <= segment_size and n.seqno == p.seqno + prev.payload().size() and not p.fin and
+           not n.syn and not n.rst and not n.urg and n.ack == h.ack and n.ackno == h.ackno and n.win == h.win and
+           n.doff == h.doff and run_bytes + next.payload().size() <= MAX_OFFLOAD_PAYLOAD;
+}
+
+//! \param[in,out] segments are the TCP segments to write; they are popped as they are written
+void TCPOverIPv4OverTunFdAdapter::write_batch(queue<TCPSegment> &segments) {
+    // submit all of the writes with one system call (if io_uring is available)
+    IOUringWriteBatch batch{};
+    while (not segments.empty()) {
+        if (not _tun.offload()) {
+            write(move(segments.front()));
+            segments.pop();
+            continue;
+        }
+
+        vector<TCPSegment> run;
+        size_t run_bytes = segments.front().payload().size();
+        run.push_back(move(segments.front()));
+        segments.pop();
+        const TCPHeader &h = run.front().header();
+        if (run_bytes > 0 and not h.syn and not h.rst and not h.urg) {
+            while (not segments.empty() and continues_run(run.front(), run.back(), segments.front(), run_bytes)) {
+                run_bytes += segments.front().payload().size();
+                run.push_back(move(segments.front()));
+                segments.pop();
+            }
+        }
+        _tun.write(wrap_with_offload(run));
+    }
+    batch.flush();
+}
+
+//! \param[in] run is one or more consecutive segments (all but the last of the same size)
+//! \returns the serialized TunTapFD::VirtioNetHeader and IPv4 datagram
+//! \details The datagram carries the first segment's header (with the last one's FIN and PSH flags) and all
+//! of the payloads, referenced rather than copied. Its TCP checksum is left for the kernel to compute.
+BufferList TCPOverIPv4OverTunFdAdapter::wrap_with_offload(vector<TCPSegment> &run) {
+    TCPSegment head;
+    head.header() = run.front().header();
+    head.header().fin = run.back().header().fin;
+    head.header().psh = run.back().header().psh;
+
+    size_t payload_size = 0;
+    for (const auto &seg : run) {
+        payload_size += seg.payload().size();
+    }
+
+    InternetDatagram ip_dgram = wrap_tcp_in_ip(head, true);
+    ip_dgram.header().len += payload_size;
+    ip_dgram.payload() = head.serialize(ip_dgram.header().pseudo_cksum(), true);
+    for (const auto &seg : run) {
+        ip_dgram.payload().append(seg.payload());
+    }
+
+    TunFD::VirtioNetHeader offload_info{};
+    offload_info.flags = TunFD::VirtioNetHeader::F_NEEDS_CSUM;
+    offload_info.csum_start = ip_dgram.header().hlen * 4;
+    offload_info.csum_offset = 16;  // offset of the TCP checksum field
+    if (run.size() > 1) {
+        offload_info.gso_type = TunFD::VirtioNetHeader::GSO_TCPV4;
+        offload_info.gso_size = run.front().payload().size();
+        offload_info.hdr_len = ip_dgram.header().hlen * 4 + head.header().doff * 4;
+    }
+
+    BufferList ret{string(reinterpret_cast<const char *>(&offload_info), sizeof(offload_info))};
+    ret.append(ip_dgram.serialize());
+    return ret;
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
@@ -19,7 +156,7 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
 optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // Read Ethernet frame from the raw device
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (frame.parse(_tap.read_buffer()) != ParseResult::NoError) {
         return {};
     }
 
@@ -43,7 +180,7 @@ void TCPOverIPv4OverEthernetAdapter::tick(const size_t ms_since_last_tick) {
 }
 
 //! \param[in] seg the TCPSegment to send
-void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
+void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &&seg) {
     _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
     send_pending();
 }
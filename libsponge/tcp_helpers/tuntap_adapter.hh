@@ -6,29 +6,37 @@
 #include "tun.hh"
 
 #include <optional>
+#include <queue>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details If the TunFD has offloads on (see TunTapFD::offload), the kernel hands over (and accepts)
+//! TCP segments of up to 64 KiB, and neither side computes TCP checksums the other will check.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
   private:
     TunFD _tun;
 
+    //! \brief Serialize a run of consecutive segments as one datagram, with a TunTapFD::VirtioNetHeader telling the
+    //! kernel to split it back into segments of the first segment's size (offloads only)
+    BufferList wrap_with_offload(std::vector<TCPSegment> &run);
+
   public:
     //! Construct from a TunFD
     explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-    std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
-            return {};
-        }
-        return unwrap_tcp_in_ip(ip_dgram);
-    }
+    std::optional<TCPSegment> read();
 
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    void write(TCPSegment &&seg);
+
+    //! Reads one datagram (with offloads, one may carry many segments' worth of payload)
+    std::vector<TCPSegment> read_batch();
+
+    //! Writes all of `segments` (leaving it empty); with offloads, runs of full-size segments are coalesced
+    void write_batch(std::queue<TCPSegment> &segments);
 
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
@@ -61,11 +69,14 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
     std::optional<TCPSegment> read();
 
     //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
-    void write(TCPSegment &seg);
+    void write(TCPSegment &&seg);
 
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
+    //! Milliseconds until tick() could next do something (see NetworkInterface::next_deadline)
+    std::optional<size_t> next_deadline() const { return _interface.next_deadline(); }
+
     //! Access the underlying raw Ethernet connection
     operator TapFD &() { return _tap; }
 
@@ -79,23 +79,28 @@ std::optional<TCPSegment> TCPSender::TCPFlightTracker::tick(const size_t ms_sinc
             }
         }
         _time = {0};
-        auto segment = *earliest;
+        auto segment = std::move(*earliest);
         _segments.erase(earliest);
-        return {segment};
+        return {std::move(segment)};
     }
     return std::nullopt;
 }
 
+std::optional<size_t> TCPSender::TCPFlightTracker::time_until_expiry() const {
+    if (!_time.has_value()) {
+        return std::nullopt;
+    }
+    return {_time.value() >= _rto ? 0 : _rto - _time.value()};
+}
+
 uint64_t TCPSender::TCPFlightTracker::max_seqno() const {
     if (_segments.empty()) {
         return _isn.raw_value();
     }
-    auto newest = _segments.front();
-    auto newest_seqno = unwrap(newest.header().seqno, _isn, _checkpoint);
-    for (auto segment : _segments) {
+    auto newest_seqno = unwrap(_segments.front().header().seqno, _isn, _checkpoint);
+    for (const auto &segment : _segments) {
         auto absolute_seqno = unwrap(segment.header().seqno, _isn, _checkpoint);
         if (absolute_seqno > newest_seqno) {
-            newest = segment;
             newest_seqno = absolute_seqno;
         }
     }
@@ -133,8 +138,7 @@ void TCPSender::fill_window() {
         TCPSegment segment;
         segment.header().seqno = _isn;
         segment.header().syn = true;
-        segment.payload() = Buffer{""};
-        send(segment);
+        send(std::move(segment));
         return;
     }
 
@@ -158,8 +162,7 @@ void TCPSender::fill_window() {
         TCPSegment segment;
         segment.header().seqno = wrap(_stream.bytes_read() + 1, _isn);
         segment.header().fin = true;
-        segment.payload() = Buffer{""};
-        send(segment);
+        send(std::move(segment));
         return;
     }
 
@@ -186,28 +189,28 @@ void TCPSender::fill_window() {
 }
 
 void TCPSender::send(std::string &&data, const WrappingInt32 &seqno, bool fin) {
-    Buffer segment_payload{std::move(data)};
     TCPSegment segment;
     segment.header().seqno = seqno;
     segment.header().fin = fin;
-    segment.payload() = segment_payload;
+    segment.payload() = Buffer{std::move(data)};
     if (segment.length_in_sequence_space() == 0) {
         // this send method doesn't send empty payload
         return;
     }
-    send(segment);
+    send(std::move(segment));
 }
 
-void TCPSender::send(const TCPSegment &segment, bool resend) {
+void TCPSender::send(TCPSegment &&segment, bool resend) {
     _checkpoint = _next_seqno;
+    const auto length = segment.length_in_sequence_space();
     if (!resend) {
-        _next_seqno += segment.length_in_sequence_space();
+        _next_seqno += length;
     }
-    _segments_out.push(segment);
-    if (segment.length_in_sequence_space()) {
-        // only tracking segments convey some data
+    if (length) {
+        // only tracking segments convey some data; the tracker keeps the one copy needed for retransmission
         _tracker.track(segment);
     }
+    _segments_out.emplace(std::move(segment));
 }
 
 //! \param ackno The remote receiver's ackno (acknowledgment number)
@@ -235,7 +238,7 @@ void TCPSender::tick(const size_t ms_since_last_tick) {
     auto segment = _tracker.tick(ms_since_last_tick);
     if (segment.has_value()) {
         // a. retransmit
-        send(segment.value(), true);
+        send(std::move(segment.value()), true);
         // b. if the window size is not zero
         if (_window_size != 0) {
             // i. Keep track of the number of consecutive retransmissions, and increment it
@@ -249,6 +252,5 @@ void TCPSender::tick(const size_t ms_since_last_tick) {
 void TCPSender::send_empty_segment() {
     TCPSegment segment;
     segment.header().seqno = wrap(_next_seqno, _isn);
-    segment.payload() = {""};
-    send(segment);
+    send(std::move(segment));
 }
@@ -8,6 +8,7 @@
 
 #include <functional>
 #include <list>
+#include <optional>
 #include <queue>
 
 //! \brief The "sender" part of a TCP implementation.
@@ -77,6 +78,9 @@ class TCPSender {
 
         std::optional<TCPSegment> tick(const size_t ms_since_last_tick);
 
+        //! \brief milliseconds until the timer expires, None as not running
+        std::optional<size_t> time_until_expiry() const;
+
         void track(const TCPSegment &segment);
 
         //! \brief make an exponential "backoff".
@@ -97,7 +101,7 @@ class TCPSender {
     //! \param[in] fin is supporting piggyback fin (fin contains data)
     void send(std::string &&data, const WrappingInt32 &seqno, bool fin = false);
     //! \param[in] resend when resend is true, we won't update the _next_seqno
-    void send(const TCPSegment &segment, bool resend = false);
+    void send(TCPSegment &&segment, bool resend = false);
 
     //!@}
 
@@ -140,6 +144,9 @@ class TCPSender {
     //! \brief Number of consecutive retransmissions that have occurred in a row
     unsigned int consecutive_retransmissions() const { return _consecutive_retransmissions; }
 
+    //! \brief Milliseconds until tick() could next do something (retransmit), if the timer is running
+    std::optional<size_t> next_deadline() const { return _tracker.time_until_expiry(); }
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
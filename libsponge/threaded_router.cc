@@ -0,0 +1,139 @@
+#include "threaded_router.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] router is the router, with all its interfaces added
+ThreadedRouter::ThreadedRouter(Router &router) : _router(router) {
+    const size_t count = router.interface_count();
+    for (size_t i = 0; i < count; i++) {
+        auto worker = make_unique<Worker>();
+        for (size_t j = 0; j < count; j++) {
+            worker->inbound.push_back(make_unique<SPSCRing<Forward>>(RING_CAPACITY));
+        }
+        _workers.push_back(move(worker));
+    }
+    for (size_t i = 0; i < count; i++) {
+        _workers[i]->thread = thread([this, i] { serve(i); });
+    }
+}
+
+ThreadedRouter::~ThreadedRouter() {
+    _stopping = true;
+    for (auto &worker : _workers) {
+        worker->thread.join();
+    }
+}
+
+size_t ThreadedRouter::forwarded() const {
+    size_t total = 0;
+    for (const auto &worker : _workers) {
+        total += worker->forwarded;
+    }
+    return total;
+}
+
+size_t ThreadedRouter::dropped() const {
+    size_t total = 0;
+    for (const auto &worker : _workers) {
+        total += worker->dropped;
+    }
+    return total;
+}
+
+//! \param[in] index is the worker (and interface)
+void ThreadedRouter::forward(const size_t index) {
+    Worker &self = *_workers[index];
+    AsyncNetworkInterface &interface = _router.interface(index);
+    auto &queue = interface.datagrams_out();
+    auto &datagrams = self.datagrams;
+    auto &destinations = self.destinations;
+    auto &hops = self.hops;
+    while (not queue.empty()) {
+        size_t count = 0;
+        for (; not queue.empty() and count < datagrams.size(); queue.pop(), count++) {
+            datagrams[count] = move(queue.front());
+            destinations[count] = as_const(datagrams[count]).header().dst;
+        }
+        _router.lookup_batch(datagrams.data(), destinations.data(), hops.data(), count);
+
+        for (size_t i = 0; i < count; i++) {
+            if (not hops[i].has_value() or as_const(datagrams[i]).header().ttl < 2) {
+                continue;
+            }
+            datagrams[i].decrement_ttl();
+            const uint32_t next_hop = hops[i]->address != 0 ? hops[i]->address : destinations[i];
+            const size_t egress = hops[i]->interface_num;
+            if (egress == index) {
+                interface.send_datagram(datagrams[i], Address::from_ipv4_numeric(next_hop));
+                self.forwarded.fetch_add(1, memory_order_relaxed);
+            } else if (not _workers.at(egress)->inbound[index]->push({move(datagrams[i]), next_hop})) {
+                self.dropped.fetch_add(1, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+//! \param[in] index is the worker (and interface) to run
+void ThreadedRouter::serve(const size_t index) {
+    Worker &self = *_workers[index];
+    AsyncNetworkInterface &interface = _router.interface(index);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % max(1U, thread::hardware_concurrency()), &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        cerr << "Warning: could not pin router worker " << index << "\n";
+    }
+
+    try {
+        uint64_t last_tick = timestamp_ms();
+        while (not _stopping) {
+            bool busy = false;
+
+            // keep the interface's clock running, so that it resends ARP requests and expires mappings
+            const uint64_t now = timestamp_ms();
+            if (now != last_tick) {
+                interface.tick(now - last_tick);
+                last_tick = now;
+            }
+
+            for (size_t n = 0; n < Router::DEFAULT_BATCH_SIZE; n++) {
+                auto frame = self.wire_in.pop();
+                if (not frame.has_value()) {
+                    break;
+                }
+                interface.recv_frame(frame.value());
+                busy = true;
+            }
+            forward(index);
+
+            for (auto &ring : self.inbound) {
+                while (auto next = ring->pop()) {
+                    interface.send_datagram(next->datagram, Address::from_ipv4_numeric(next->next_hop));
+                    self.forwarded.fetch_add(1, memory_order_relaxed);
+                    busy = true;
+                }
+            }
+
+            for (auto &frames = interface.frames_out(); not frames.empty(); frames.pop()) {
+                if (not self.wire_out.push(move(frames.front()))) {
+                    self.dropped.fetch_add(1, memory_order_relaxed);
+                }
+            }
+
+            if (not busy) {
+                this_thread::yield();
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in router worker " << index << ": " << e.what() << "\n";
+    }
+}
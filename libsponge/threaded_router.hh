@@ -0,0 +1,110 @@
+#ifndef SPONGE_LIBSPONGE_THREADED_ROUTER_HH
+#define SPONGE_LIBSPONGE_THREADED_ROUTER_HH
+
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "router.hh"
+#include "spsc_ring.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! \brief Forwards datagrams between a Router's interfaces with one pinned thread ("worker") per interface
+class ThreadedRouter {
+  public:
+    static constexpr size_t RING_CAPACITY = 1024;  //!< Frames or datagrams that can wait in each ring
+
+  private:
+    //! A datagram on its way from one worker to another, with the address to send it to
+    struct Forward {
+        InternetDatagram datagram{};
+        uint32_t next_hop = 0;
+    };
+
+    //! One interface's worker, and the rings it reads
+    struct Worker {
+        SPSCRing<EthernetFrame> wire_in{RING_CAPACITY};   //!< Frames arriving at the interface
+        SPSCRing<EthernetFrame> wire_out{RING_CAPACITY};  //!< Frames the interface has sent
+
+        //! Ring from each worker (by index; a worker's ring to itself is unused)
+        std::vector<std::unique_ptr<SPSCRing<Forward>>> inbound{};
+
+        std::atomic<size_t> forwarded{0};  //!< Datagrams this worker has sent
+        std::atomic<size_t> dropped{0};    //!< Datagrams or frames it dropped because a ring was full
+        std::thread thread{};
+
+        //! \name Space for forward() to work in
+        //!@{
+        std::array<InternetDatagram, Router::DEFAULT_BATCH_SIZE> datagrams{};
+        std::array<uint32_t, Router::DEFAULT_BATCH_SIZE> destinations{};
+        std::array<std::optional<Router::NextHop>, Router::DEFAULT_BATCH_SIZE> hops{};
+        //!@}
+    };
+
+    Router &_router;
+    std::vector<std::unique_ptr<Worker>> _workers{};
+    std::atomic<bool> _stopping{false};
+
+    //! Run one worker until the ThreadedRouter is destroyed
+    void serve(const size_t index);
+
+    //! Look up the datagrams that arrived at a worker's interface, and pass each to its egress worker
+    void forward(const size_t index);
+
+  public:
+    //! \brief Start a worker for each of `router`'s interfaces
+    //! \details Until the ThreadedRouter is destroyed, the workers own the interfaces: nothing else may
+    //! touch them (or call Router::route()). Routes may still be changed, from any thread.
+    explicit ThreadedRouter(Router &router);
+
+    //! Stop the workers
+    ~ThreadedRouter();
+
+    //! \brief Hand a frame to an interface, as if it had arrived on its link
+    //! \returns `false` (dropping the frame) if the interface's incoming ring is full
+    //! \note Each interface must be fed by only one thread.
+    bool deliver(const size_t interface, EthernetFrame &&frame) {
+        return _workers.at(interface)->wire_in.push(std::move(frame));
+    }
+
+    //! \brief Take a frame an interface has sent, if there is one
+    //! \note Each interface must be drained by only one thread.
+    std::optional<EthernetFrame> collect(const size_t interface) { return _workers.at(interface)->wire_out.pop(); }
+
+    //! Datagrams sent on to their next hop, in total
+    size_t forwarded() const;
+
+    //! Datagrams and frames dropped because a ring was full, in total
+    size_t dropped() const;
+
+    //! \name
+    //! A ThreadedRouter cannot be copied or moved (its threads refer to it)
+
+    //!@{
+    ThreadedRouter(const ThreadedRouter &other) = delete;
+    ThreadedRouter &operator=(const ThreadedRouter &other) = delete;
+    //!@}
+};
+
+//! \class ThreadedRouter
+//! Each worker owns one interface (a NetworkInterface is not thread-safe, so its ingress and egress run
+//! on the same thread). In a loop, it
+//! 1. tells the interface how much time has passed (NetworkInterface::tick()), and passes it the frames that
+//!    have arrived on its link,
+//! 2. looks up the datagrams they carried in batches (Router::lookup_batch(), which takes no lock) and
+//!    pushes each onto the lock-free SPSCRing to its egress worker (there is one ring for each ordered
+//!    pair of workers, so every ring has a single producer and a single consumer),
+//! 3. sends the datagrams the other workers have passed to it, and
+//! 4. moves the frames its interface sent onto its outgoing link.
+//!
+//! Workers poll, yielding the CPU when a round finds nothing to do. Like a NIC with a full ring, a worker
+//! drops what does not fit in a ring.
+
+#endif  // SPONGE_LIBSPONGE_THREADED_ROUTER_HH
@@ -1,15 +1,224 @@
 #include "buffer.hh"
 
+#include <cstring>
+#include <new>
+
 using namespace std;
 
+namespace {
+
+//! \brief A per-thread cache of free BufferStorage chunks
+//! \details Chunks are individually allocated, so a chunk freed on one thread can be reused by
+//! another; a thread's cache is only a bound on how many idle chunks it keeps around.
+class ChunkPool {
+  private:
+    static constexpr size_t MAX_CACHED_CHUNKS = 1024;  //!< Chunks beyond this go back to the heap
+
+    //! A free chunk reuses its own first bytes as the free-list link
+    struct FreeChunk {
+        FreeChunk *next;
+    };
+
+    FreeChunk *_free{nullptr};  //!< Head of the free list
+    size_t _count{0};           //!< Length of the free list
+
+  public:
+    ChunkPool() = default;
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+    ~ChunkPool();
+
+    void *acquire() {
+        if (_free) {
+            FreeChunk *chunk = _free;
+            _free = chunk->next;
+            --_count;
+            return chunk;
+        }
+        return ::operator new(BufferStorage::CHUNK_SIZE);
+    }
+
+    void release(void *ptr) noexcept {
+        if (_count >= MAX_CACHED_CHUNKS) {
+            ::operator delete(ptr);
+            return;
+        }
+        _free = new (ptr) FreeChunk{_free};
+        ++_count;
+    }
+};
+
+thread_local ChunkPool pool{};
+thread_local bool pool_destroyed = false;  // trivially destructible, so still readable during thread exit
+
+//! Reusable per-thread landing area for the part of a read that doesn't fit in a chunk
+thread_local string spill_area{};
+
+ChunkPool::~ChunkPool() {
+    while (_free) {
+        ::operator delete(exchange(_free, _free->next));
+    }
+    _count = 0;
+    pool_destroyed = true;
+}
+
+}  // namespace
+
+//! \param[in] str the string whose contents are stored (copied inline if small enough, otherwise adopted)
+BufferStorage::BufferStorage(string &&str) : _data(nullptr), _size(str.size()) {
+    if (_size <= inline_capacity()) {
+        memcpy(inline_data(), str.data(), _size);
+        _data = inline_data();
+    } else {
+        _owned = move(str);
+        _data = _owned.data();
+    }
+}
+
+BufferStorage::BufferStorage() : _data(inline_data()), _size(0) {}
+
+//! \param[in] n is the number of bytes written
+//! \param[in] spill is where the bytes beyond the inline area were written
+void BufferStorage::set_contents(const size_t n, const string_view spill) {
+    if (n <= inline_capacity()) {
+        _size = n;
+        return;
+    }
+    if (n - inline_capacity() > spill.size()) {
+        throw runtime_error("BufferStorage::set_contents: more bytes than were available");
+    }
+    _owned.reserve(n);
+    _owned.append(inline_data(), inline_capacity());
+    _owned.append(spill.data(), n - inline_capacity());
+    _data = _owned.data();
+    _size = n;
+}
+
+BufferStorage *BufferStorage::create(string &&str) {
+    void *chunk = pool_destroyed ? ::operator new(CHUNK_SIZE) : pool.acquire();
+    return new (chunk) BufferStorage(move(str));
+}
+
+BufferStorage *BufferStorage::create() {
+    void *chunk = pool_destroyed ? ::operator new(CHUNK_SIZE) : pool.acquire();
+    return new (chunk) BufferStorage();
+}
+
+void BufferStorage::destroy() noexcept {
+    this->~BufferStorage();
+    if (pool_destroyed) {
+        ::operator delete(static_cast<void *>(this));
+    } else {
+        pool.release(this);
+    }
+}
+
 void Buffer::remove_prefix(const size_t n) {
     if (n > str().size()) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
     if (_storage and _starting_offset == _storage->size()) {
-        _storage.reset();
+        _storage->release();
+        _storage = nullptr;
+        _starting_offset = 0;
+    }
+}
+
+char *Buffer::mutable_data() {
+    if (not _storage or _storage->_refcount != 1) {
+        return nullptr;
     }
+    // the bytes are the storage's own (its inline area or its adopted string), so they may be written
+    return const_cast<char *>(_storage->data()) + _starting_offset;
+}
+
+//! \param[in] str is the string to copy
+//! \returns a Buffer holding a copy of the bytes of `str` (empty if there were none)
+Buffer Buffer::copy_of(const string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    Buffer ret;
+    ret._storage = BufferStorage::create();
+    const size_t inline_len = min(str.size(), BufferStorage::inline_capacity());
+    memcpy(ret._storage->inline_data(), str.data(), inline_len);
+    ret._storage->set_contents(str.size(), str.substr(inline_len));
+    return ret;
+}
+
+//! \param[in] limit is the maximum number of bytes to read
+//! \param[in] read is the scatter-read operation; it must not report more bytes than the iovecs hold
+//! \returns a Buffer holding the bytes read (empty if there were none)
+//! \details The first iovec is the inline area of a fresh pooled chunk, so a read that fits (e.g. a
+//! packet) lands directly in the Buffer's storage with no copy and no zero-filling. Anything longer
+//! spills into a reusable per-thread area and is then gathered into one string.
+Buffer Buffer::read_from(const size_t limit, const ReadFunction &read) {
+    Buffer ret;
+    ret._storage = BufferStorage::create();
+
+    const size_t inline_len = min(limit, BufferStorage::inline_capacity());
+    array<iovec, 2> iovecs{{{ret._storage->inline_data(), inline_len}, {nullptr, 0}}};
+    int iovcnt = 1;
+    string_view spill{};
+    if (limit > inline_len) {
+        if (spill_area.size() < limit - inline_len) {
+            spill_area.resize(limit - inline_len);
+        }
+        spill = {spill_area.data(), limit - inline_len};
+        iovecs[1] = {spill_area.data(), spill.size()};
+        iovcnt = 2;
+    }
+
+    const size_t bytes_read = read(iovecs.data(), iovcnt);
+    if (bytes_read == 0) {
+        return {};
+    }
+    if (bytes_read > limit) {
+        throw runtime_error("Buffer::read_from: read more than requested");
+    }
+    ret._storage->set_contents(bytes_read, spill);
+    return ret;
+}
+
+//! \param[in] count is the maximum number of messages to read
+//! \param[in] limit is the maximum size of each message
+//! \param[in] read is the batched scatter-read operation
+//! \returns one Buffer per message read (an empty Buffer for an empty message)
+//! \details As with Buffer::read_from, each message lands in the inline area of its own pooled chunk,
+//! with only the part beyond that going to the per-thread spill area (one slice per message).
+vector<Buffer> Buffer::read_batch_from(const size_t count, const size_t limit, const BatchReadFunction &read) {
+    thread_local vector<iovec> iovecs{};
+    thread_local vector<size_t> lengths{};
+
+    const size_t inline_len = min(limit, BufferStorage::inline_capacity());
+    const size_t spill_len = limit - inline_len;
+    if (spill_area.size() < count * spill_len) {
+        spill_area.resize(count * spill_len);
+    }
+
+    vector<Buffer> ret(count);
+    iovecs.resize(2 * count);
+    lengths.assign(count, 0);
+    for (size_t i = 0; i < count; i++) {
+        ret[i]._storage = BufferStorage::create();
+        iovecs[2 * i] = {ret[i]._storage->inline_data(), inline_len};
+        iovecs[2 * i + 1] = {spill_len ? spill_area.data() + i * spill_len : nullptr, spill_len};
+    }
+
+    const size_t messages_read = min(read(iovecs.data(), count, lengths.data()), count);
+    ret.resize(messages_read);
+    for (size_t i = 0; i < messages_read; i++) {
+        if (lengths[i] > limit) {
+            throw runtime_error("Buffer::read_batch_from: read more than requested");
+        }
+        if (lengths[i] == 0) {
+            ret[i] = Buffer{};
+            continue;
+        }
+        ret[i]._storage->set_contents(lengths[i], {spill_area.data() + i * spill_len, spill_len});
+    }
+    return ret;
 }
 
 void BufferList::append(const BufferList &other) {
@@ -18,6 +227,13 @@ void BufferList::append(const BufferList &other) {
     }
 }
 
+void BufferList::append(BufferList &&other) {
+    for (auto &buf : other._buffers) {
+        _buffers.push_back(std::move(buf));
+    }
+    other._buffers.clear();
+}
+
 BufferList::operator Buffer() const {
     switch (_buffers.size()) {
         case 0:
@@ -2,26 +2,146 @@
 #define SPONGE_LIBSPONGE_BUFFER_HH
 
 #include <algorithm>
-#include <deque>
-#include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <numeric>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <sys/uio.h>
+#include <utility>
 #include <vector>
 
+//! \brief Reference-counted backing store of a Buffer
+//! \details Each BufferStorage lives at the start of a fixed-size chunk (BufferStorage::CHUNK_SIZE bytes)
+//! taken from a per-thread pool. Bytes that fit are stored inline in the rest of the chunk; a larger
+//! string is adopted (moved in, not copied). Chunks go back to the pool of whichever thread releases
+//! the last reference, so a Buffer may be freely handed between threads.
+//!
+//! The reference count is atomic unless the build defines `SPONGE_BUFFER_NONATOMIC_REFCOUNT`,
+//! which is only safe if no Buffer is ever shared between threads.
+class BufferStorage {
+  public:
+    static constexpr size_t CHUNK_SIZE = 2048;  //!< Size of each pooled chunk, including this header
+
+  private:
+#ifdef SPONGE_BUFFER_NONATOMIC_REFCOUNT
+    using RefCount = uint32_t;
+#else
+    using RefCount = std::atomic<uint32_t>;
+#endif
+
+    RefCount _refcount{1};  //!< Number of Buffers referring to this storage
+    std::string _owned{};   //!< An adopted string (empty if the bytes are stored inline)
+    const char *_data;      //!< Start of the bytes (inline area or `_owned`)
+    size_t _size;           //!< Number of bytes
+
+    //! Construct in a pooled chunk, taking ownership of `str`
+    explicit BufferStorage(std::string &&str);
+
+    //! Construct in a pooled chunk with no contents yet (filled in by Buffer::read_from)
+    BufferStorage();
+
+    //! \brief Record that `n` bytes have been written, starting in the inline area and continuing in `spill`
+    //! \details If they didn't all fit inline, the bytes are gathered into an adopted string.
+    void set_contents(const size_t n, const std::string_view spill);
+
+    friend class Buffer;
+
+    //! Return a chunk whose last reference has gone away to the pool
+    void destroy() noexcept;
+
+    //! Start of the inline byte area that follows the header in the chunk
+    char *inline_data() { return reinterpret_cast<char *>(this) + sizeof(BufferStorage); }
+
+  public:
+    //! Number of bytes that can be stored inline in one chunk
+    static constexpr size_t inline_capacity();
+
+    //! \brief Create storage holding the contents of `str`
+    //! \returns storage with a reference count of one
+    static BufferStorage *create(std::string &&str);
+
+    //! \brief Create empty storage whose inline area can be written directly
+    //! \returns storage with a reference count of one
+    static BufferStorage *create();
+
+    //! \name Reference counting
+    //!@{
+    void retain() noexcept { ++_refcount; }
+    void release() noexcept {
+        if (--_refcount == 0) {
+            destroy();
+        }
+    }
+    //!@}
+
+    //! \name Contents
+    //!@{
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+    //!@}
+
+    //! \name
+    //! Only ever handled through pointers
+
+    //!@{
+    ~BufferStorage() = default;
+    BufferStorage(const BufferStorage &) = delete;
+    BufferStorage &operator=(const BufferStorage &) = delete;
+    //!@}
+};
+
+constexpr size_t BufferStorage::inline_capacity() { return CHUNK_SIZE - sizeof(BufferStorage); }
+
 //! \brief A reference-counted read-only string that can discard bytes from the front
+//! \note An empty Buffer owns no storage at all, so empty payloads (e.g. pure ACKs) never allocate.
 class Buffer {
   private:
-    std::shared_ptr<std::string> _storage{};
+    BufferStorage *_storage{nullptr};
     size_t _starting_offset{};
 
   public:
     Buffer() = default;
 
     //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    //! \note An empty string is not stored; the result is the same as a default-constructed Buffer.
+    Buffer(std::string &&str) noexcept : _storage(str.empty() ? nullptr : BufferStorage::create(std::move(str))) {}
+
+    //! \name Copying shares the storage; moving transfers it
+    //!@{
+    Buffer(const Buffer &other) noexcept : _storage(other._storage), _starting_offset(other._starting_offset) {
+        if (_storage) {
+            _storage->retain();
+        }
+    }
+
+    Buffer(Buffer &&other) noexcept
+        : _storage(std::exchange(other._storage, nullptr)), _starting_offset(std::exchange(other._starting_offset, 0)) {}
+
+    Buffer &operator=(const Buffer &other) noexcept {
+        Buffer(other).swap(*this);
+        return *this;
+    }
+
+    Buffer &operator=(Buffer &&other) noexcept {
+        Buffer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~Buffer() {
+        if (_storage) {
+            _storage->release();
+        }
+    }
+
+    void swap(Buffer &other) noexcept {
+        std::swap(_storage, other._storage);
+        std::swap(_starting_offset, other._starting_offset);
+    }
+    //!@}
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -38,15 +158,156 @@ class Buffer {
     //! \brief Get character at location `n`
     uint8_t at(const size_t n) const { return str().at(n); }
 
+    //! \brief Writable access to the bytes, if no other Buffer refers to the same storage
+    //! \returns `nullptr` if the storage is shared (or there is none), since writing would change what
+    //! other Buffers hold
+    char *mutable_data();
+
     //! \brief Size of the string
     size_t size() const { return str().size(); }
 
+    //! \brief Is the string empty? (an empty Buffer holds no storage)
+    bool empty() const { return not _storage; }
+
     //! \brief Make a copy to a new std::string
     std::string copy() const { return std::string(str()); }
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Construct by copying `str` (into the inline area of a pooled chunk, if it fits)
+    static Buffer copy_of(const std::string_view str);
+
+    //! A scatter-read operation (e.g. a wrapper around [readv(2)](\ref man2::readv)) that fills the
+    //! given iovecs and returns the number of bytes it wrote
+    using ReadFunction = std::function<size_t(const iovec *iov, const int iovcnt)>;
+
+    //! \brief Construct by reading up to `limit` bytes with a scatter-read operation
+    static Buffer read_from(const size_t limit, const ReadFunction &read);
+
+    //! A batched scatter-read operation (e.g. a wrapper around [recvmmsg(2)](\ref man2::recvmmsg)) that reads
+    //! up to `count` messages, message `i` into `iov[2 * i]` and `iov[2 * i + 1]`, stores the length of each
+    //! in `lengths`, and returns the number of messages it read
+    using BatchReadFunction = std::function<size_t(const iovec *iov, const size_t count, size_t *lengths)>;
+
+    //! \brief Construct up to `count` Buffers, of at most `limit` bytes each, with one batched scatter-read
+    static std::vector<Buffer> read_batch_from(const size_t count, const size_t limit, const BatchReadFunction &read);
+};
+
+//! \brief A sequence that keeps up to `N` elements inline and spills to the heap beyond that
+//! \details Supports the operations BufferList and BufferViewList need: appending at the back,
+//! discarding from the front, and iteration. Discarding from the front is O(1).
+template <typename T, size_t N>
+class InlineVector {
+  private:
+    std::array<T, N> _inline{};  //!< Elements, while there are few enough
+    std::vector<T> _spilled{};   //!< Elements, once more than `N` have been stored
+    bool _is_spilled{false};     //!< Which of the two stores is in use
+    size_t _begin{0};            //!< Index of the first live element
+    size_t _end{0};              //!< One past the index of the last live element
+
+    T *base() { return _is_spilled ? _spilled.data() : _inline.data(); }
+    const T *base() const { return _is_spilled ? _spilled.data() : _inline.data(); }
+
+  public:
+    InlineVector() = default;
+
+    InlineVector(const InlineVector &other) : InlineVector() {
+        for (const auto &x : other) {
+            push_back(x);
+        }
+    }
+
+    InlineVector(InlineVector &&other) noexcept
+        : _inline(std::move(other._inline))
+        , _spilled(std::move(other._spilled))
+        , _is_spilled(other._is_spilled)
+        , _begin(other._begin)
+        , _end(other._end) {
+        other._spilled.clear();
+        other._is_spilled = false;
+        other._begin = other._end = 0;
+    }
+
+    InlineVector &operator=(const InlineVector &other) {
+        if (this != &other) {
+            clear();
+            for (const auto &x : other) {
+                push_back(x);
+            }
+        }
+        return *this;
+    }
+
+    InlineVector &operator=(InlineVector &&other) noexcept {
+        if (this != &other) {
+            _inline = std::move(other._inline);
+            _spilled = std::move(other._spilled);
+            _is_spilled = other._is_spilled;
+            _begin = other._begin;
+            _end = other._end;
+            other._spilled.clear();
+            other._is_spilled = false;
+            other._begin = other._end = 0;
+        }
+        return *this;
+    }
+
+    ~InlineVector() = default;
+
+    size_t size() const { return _end - _begin; }
+    bool empty() const { return _begin == _end; }
+
+    T *begin() { return base() + _begin; }
+    T *end() { return base() + _end; }
+    const T *begin() const { return base() + _begin; }
+    const T *end() const { return base() + _end; }
+
+    T &front() { return *begin(); }
+    const T &front() const { return *begin(); }
+    T &operator[](const size_t n) { return begin()[n]; }
+    const T &operator[](const size_t n) const { return begin()[n]; }
+
+    void push_back(T value) {
+        if (not _is_spilled) {
+            if (_end == N and _begin > 0) {
+                // slide the live elements back to the start of the inline store
+                std::move(_inline.begin() + _begin, _inline.end(), _inline.begin());
+                _end -= _begin;
+                std::fill(_inline.begin() + _end, _inline.end(), T{});
+                _begin = 0;
+            }
+            if (_end < N) {
+                _inline[_end++] = std::move(value);
+                return;
+            }
+
+            // out of inline room: move everything to the heap
+            _spilled.reserve(2 * N);
+            for (auto &x : _inline) {
+                _spilled.push_back(std::move(x));
+                x = T{};
+            }
+            _is_spilled = true;
+        }
+        _spilled.push_back(std::move(value));
+        ++_end;
+    }
+
+    void pop_front() {
+        front() = T{};
+        if (++_begin == _end) {
+            clear();
+        }
+    }
+
+    void clear() {
+        std::fill(_inline.begin(), _inline.end(), T{});
+        _spilled.clear();
+        _is_spilled = false;
+        _begin = _end = 0;
+    }
 };
 
 //! \brief A reference-counted discontiguous string that can discard bytes from the front
@@ -55,8 +316,15 @@ class Buffer {
 //! encapsulate a TCP payload in a TCPSegment, and then encapsulate
 //! the TCPSegment in an IPv4Datagram) without copying the payload.
 class BufferList {
+  public:
+    //! Up to this many slices (e.g. Ethernet + IP + TCP headers + payload) are stored without a heap allocation
+    static constexpr size_t INLINE_SLICES = 4;
+
+    //! The container holding the Buffers
+    using Slices = InlineVector<Buffer, INLINE_SLICES>;
+
   private:
-    std::deque<Buffer> _buffers{};
+    Slices _buffers{};
 
   public:
     //! \name Constructors
@@ -64,22 +332,26 @@ class BufferList {
 
     BufferList() = default;
 
-    //! \brief Construct from a Buffer
-    BufferList(Buffer buffer) : _buffers{buffer} {}
+    //! \brief Construct from a Buffer (an empty Buffer contributes no slice)
+    BufferList(Buffer buffer) {
+        if (not buffer.empty()) {
+            _buffers.push_back(std::move(buffer));
+        }
+    }
 
     //! \brief Construct by taking ownership of a std::string
-    BufferList(std::string &&str) noexcept {
-        Buffer buf{std::move(str)};
-        append(buf);
-    }
+    BufferList(std::string &&str) noexcept : BufferList(Buffer{std::move(str)}) {}
     //!@}
 
-    //! \brief Access the underlying queue of Buffers
-    const std::deque<Buffer> &buffers() const { return _buffers; }
+    //! \brief Access the underlying sequence of Buffers
+    const Slices &buffers() const { return _buffers; }
 
     //! \brief Append a BufferList
     void append(const BufferList &other);
 
+    //! \brief Append a BufferList, taking over its Buffers without touching their reference counts
+    void append(BufferList &&other);
+
     //! \brief Transform to a Buffer
     //! \note Throws an exception unless BufferList is contiguous
     operator Buffer() const;
@@ -96,7 +368,7 @@ class BufferList {
 
 //! \brief A non-owning temporary view (similar to std::string_view) of a discontiguous string
 class BufferViewList {
-    std::deque<std::string_view> _views{};
+    InlineVector<std::string_view, BufferList::INLINE_SLICES> _views{};
 
   public:
     //! \name Constructors
@@ -0,0 +1,201 @@
+#include "dir24_8_table.hh"
+
+#include "epoch.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+Dir24_8Table::Dir24_8Table() : _tbl24(size_t(1) << 24, NONE) {}
+
+//! \param[in] entry is the entry to copy into each of the group's entries
+uint16_t Dir24_8Table::allocate_group(const uint16_t entry) {
+    uint16_t group;
+    if (not _free.empty()) {
+        group = _free.back();
+        _free.pop_back();
+    } else {
+        if (_tbl8.size() / GROUP_SIZE >= EXTENDED) {
+            throw length_error("Dir24_8Table: too many prefixes longer than /24");
+        }
+        group = _tbl8.size() / GROUP_SIZE;
+        _tbl8.resize(_tbl8.size() + GROUP_SIZE);
+    }
+    fill_n(_tbl8.begin() + group * GROUP_SIZE, GROUP_SIZE, entry);
+    return group;
+}
+
+//! \param[in] prefix is the prefix
+//! \param[in] length is its length
+//! \param[in] value is the entry to store
+//! \note Prefixes must be painted shortest first, so that every prefix up to /24 is painted before any
+//! group is made.
+void Dir24_8Table::paint(const uint32_t prefix, const uint8_t length, const uint16_t value) {
+    if (length <= 24) {
+        fill_n(_tbl24.begin() + (prefix >> 8), size_t(1) << (24 - length), value);
+        return;
+    }
+    uint16_t &entry = _tbl24[prefix >> 8];
+    if (not(entry & EXTENDED)) {
+        entry = EXTENDED | allocate_group(entry);
+    }
+    fill_n(_tbl8.begin() + (entry & ~EXTENDED) * GROUP_SIZE + (prefix & 0xff), size_t(1) << (32 - length), value);
+}
+
+//! \param[in] routes are the routes, already changed
+//! \param[in] prefix is the prefix that was inserted, changed or removed
+//! \param[in] length is its length
+//! \details Recompiles the entries for the /24s the prefix covers (or, for a longer prefix, for the /24 it
+//! falls in): fills them with the longest prefix covering all of them, then paints the prefixes inside.
+//! Updating the prefix `0.0.0.0/0` recompiles the whole table.
+void Dir24_8Table::update(const LPMTrie &routes, const uint32_t prefix, const uint8_t length) {
+    const uint8_t block_length = min(length, uint8_t(24));
+    const uint32_t block = prefix & LPMTrie::mask(block_length);
+    const auto first = _tbl24.begin() + (block >> 8);
+    const auto last = first + (size_t(1) << (24 - block_length));
+
+    for (auto entry = first; entry != last; ++entry) {
+        if (*entry & EXTENDED) {
+            _free.push_back(*entry & ~EXTENDED);
+        }
+    }
+
+    const auto encode = [](const optional<uint32_t> value) -> uint16_t {
+        if (value.value_or(0) > MAX_VALUE) {
+            throw out_of_range("Dir24_8Table: value too large");
+        }
+        return value.has_value() ? value.value() : NONE;
+    };
+    fill(first, last, block_length == 0 ? NONE : encode(routes.lookup(block, block_length - 1)));
+
+    vector<tuple<uint8_t, uint32_t, uint32_t>> inside;
+    routes.for_each(block, block_length, [&](const uint32_t p, const uint8_t l, const uint32_t v) {
+        inside.emplace_back(l, p, v);
+    });
+    sort(inside.begin(), inside.end());
+    for (const auto &[l, p, v] : inside) {
+        paint(p, l, encode(v));
+    }
+}
+
+//! \param[in] addresses are the addresses to look up
+//! \param[out] values receives the value of the longest prefix matching each address, if any
+//! \param[in] count is the number of addresses
+//! \details Prefetches the first-level entries of up to LOOKUP_BATCH addresses, then reads them and
+//! prefetches the second-level entries they point to, then reads those: so the lookups of a batch wait for
+//! memory together rather than one after another.
+void Dir24_8Table::lookup_batch(const uint32_t *addresses, optional<uint32_t> *values, const size_t count) const {
+    array<uint16_t, LOOKUP_BATCH> entries{};
+    for (size_t first = 0; first < count; first += LOOKUP_BATCH) {
+        const size_t batch = min(LOOKUP_BATCH, count - first);
+        for (size_t i = 0; i < batch; i++) {
+            __builtin_prefetch(&_tbl24[addresses[first + i] >> 8]);
+        }
+        for (size_t i = 0; i < batch; i++) {
+            const uint32_t address = addresses[first + i];
+            entries[i] = _tbl24[address >> 8];
+            if (entries[i] & EXTENDED) {
+                __builtin_prefetch(&_tbl8[(entries[i] & ~EXTENDED) * GROUP_SIZE + (address & 0xff)]);
+            }
+        }
+        for (size_t i = 0; i < batch; i++) {
+            uint16_t entry = entries[i];
+            if (entry & EXTENDED) {
+                entry = _tbl8[(entry & ~EXTENDED) * GROUP_SIZE + (addresses[first + i] & 0xff)];
+            }
+            values[first + i] = entry == NONE ? optional<uint32_t>{} : entry;
+        }
+    }
+}
+
+size_t Dir24_8Table::memory_usage() const {
+    return (_tbl24.capacity() + _tbl8.capacity() + _free.capacity()) * sizeof(uint16_t);
+}
+
+//! \param[in] routes are the routes to compile
+//! \param[in] version is the version of the routes (see Dir24_8Table::version)
+Dir24_8Builder::Dir24_8Builder(const LPMTrie &routes, const uint64_t version) : _routes(routes), _table(nullptr) {
+    auto table = make_unique<Dir24_8Table>();
+    table->update(_routes, 0, 0);
+    table->set_version(version);
+    _table = table.release();
+    _thread = thread([this] { build_loop(); });
+}
+
+Dir24_8Builder::~Dir24_8Builder() {
+    {
+        const lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_one();
+    _thread.join();
+    delete _table.load();
+}
+
+//! \param[in] prefix is the prefix
+//! \param[in] length is its length
+//! \param[in] value is its new value, or empty if it was removed
+//! \param[in] version is the version of the routes with the change (see Dir24_8Table::version)
+void Dir24_8Builder::update(const uint32_t prefix,
+                            const uint8_t length,
+                            const optional<uint32_t> value,
+                            const uint64_t version) {
+    {
+        const lock_guard<mutex> lock(_mutex);
+        if (_failed) {
+            return;
+        }
+        _pending.push_back({prefix, length, value, version});
+    }
+    _changed.notify_one();
+}
+
+//! \details Changes that arrive while a table is being built are applied together to the next one. If
+//! applying them fails, the table is withdrawn (so that readers fall back to the routes) and the thread exits.
+void Dir24_8Builder::build_loop() {
+    try {
+        while (true) {
+            vector<Change> changes;
+            {
+                unique_lock<mutex> lock(_mutex);
+                _changed.wait(lock, [&] { return _stopping or not _pending.empty(); });
+                if (_stopping) {
+                    return;
+                }
+                changes.swap(_pending);
+            }
+
+            for (const auto &change : changes) {
+                if (change.value.has_value()) {
+                    _routes.insert(change.prefix, change.length, change.value.value());
+                } else {
+                    _routes.erase(change.prefix, change.length);
+                }
+            }
+
+            // readers may still be using the current table, so change a copy (only this thread replaces
+            // the table, so it needs no guard to read it)
+            auto next = make_unique<Dir24_8Table>(*_table.load());
+            for (const auto &change : changes) {
+                next->update(_routes, change.prefix, change.length);
+            }
+            next->set_version(changes.back().version);
+            Epoch::retire(_table.exchange(next.release()));
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in Dir24_8Builder: " << e.what() << "\n";
+        {
+            const lock_guard<mutex> lock(_mutex);
+            _failed = true;
+            _pending.clear();
+        }
+        Epoch::retire(_table.exchange(nullptr));
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef SPONGE_LIBSPONGE_DIR24_8_TABLE_HH
+#define SPONGE_LIBSPONGE_DIR24_8_TABLE_HH
+
+#include "lpm_trie.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+//! \brief A DIR-24-8 forwarding table: the routes of an LPMTrie compiled into flat arrays
+//! \details One 16-bit entry for each /24 holds the value of the longest matching prefix, or, if prefixes
+//! longer than /24 fall inside it, the number of a group of 256 entries (one per address in the /24) in a
+//! second array. So a lookup is one memory access, or two. The first array takes 32 MiB.
+class Dir24_8Table {
+  public:
+    static constexpr uint32_t MAX_VALUE = 0x7ffe;  //!< Largest value (e.g. next-hop index) that can be stored
+
+  private:
+    static constexpr uint16_t EXTENDED = 0x8000;  //!< Flag: the entry is the number of a group of /32 entries
+    static constexpr uint16_t NONE = 0x7fff;      //!< Entry for addresses that match no prefix
+    static constexpr size_t GROUP_SIZE = 256;     //!< Entries per group (one per address in a /24)
+    static constexpr size_t LOOKUP_BATCH = 32;    //!< Most lookups lookup_batch() interleaves at once
+
+    std::vector<uint16_t> _tbl24;   //!< Entry for each /24
+    std::vector<uint16_t> _tbl8{};  //!< The groups of /32 entries
+    std::vector<uint16_t> _free{};  //!< Groups that are no longer used
+    uint64_t _version = 0;          //!< Version of the routes the table was compiled from
+
+    //! Take an unused group, filled with `entry`
+    uint16_t allocate_group(const uint16_t entry);
+
+    //! Store `value` for the addresses covered by one prefix, over whatever shorter prefixes stored
+    void paint(const uint32_t prefix, const uint8_t length, const uint16_t value);
+
+  public:
+    //! An empty table (every lookup fails)
+    Dir24_8Table();
+
+    //! \brief Recompile the part of the table covered by a prefix, from `routes`
+    //! \details Call after inserting or removing the prefix in `routes`.
+    void update(const LPMTrie &routes, const uint32_t prefix, const uint8_t length);
+
+    //! The value of the longest prefix matching `address`, if any
+    std::optional<uint32_t> lookup(const uint32_t address) const {
+        uint16_t entry = _tbl24[address >> 8];
+        if (entry & EXTENDED) {
+            entry = _tbl8[(entry & ~EXTENDED) * GROUP_SIZE + (address & 0xff)];
+        }
+        if (entry == NONE) {
+            return {};
+        }
+        return entry;
+    }
+
+    //! \brief Look up `count` addresses at once, storing the result for `addresses[i]` in `values[i]`
+    //! \details Faster than separate lookups when the table is not in the cache.
+    void lookup_batch(const uint32_t *addresses, std::optional<uint32_t> *values, const size_t count) const;
+
+    //! \name Version of the routes the table was compiled from (kept for the owner's use)
+    //!@{
+    uint64_t version() const { return _version; }
+    void set_version(const uint64_t version) { _version = version; }
+    //!@}
+
+    //! Bytes of memory held by the table
+    size_t memory_usage() const;
+};
+
+//! \brief Keeps a Dir24_8Table compiled from a changing set of routes, recompiling on a background thread
+//! \details The owner reports each change to its routes with update(). The builder thread applies the
+//! changes to its own copy of the routes and to a copy of the current table (recompiling only the parts
+//! the changed prefixes cover), then publishes the new table with an atomic swap and retires the old one
+//! (see Epoch). Readers take the current table with table(), inside an Epoch::Guard.
+//!
+//! If a change cannot be compiled (e.g. there are too many prefixes longer than /24), the builder withdraws
+//! the table rather than leave a stale one published: table() returns null from then on, and readers must
+//! use the routes themselves.
+class Dir24_8Builder {
+    //! A change reported by the owner
+    struct Change {
+        uint32_t prefix;                //!< The prefix that changed
+        uint8_t length;                 //!< Its length
+        std::optional<uint32_t> value;  //!< Its new value, or empty if it was removed
+        uint64_t version;               //!< The version of the routes after the change
+    };
+
+    LPMTrie _routes;                           //!< The builder thread's copy of the routes
+    std::atomic<const Dir24_8Table *> _table;  //!< The current table (owned)
+
+    std::mutex _mutex{};
+    std::condition_variable _changed{};
+    std::vector<Change> _pending{};  //!< Changes not yet applied (protected by _mutex)
+    bool _stopping = false;          //!< Set to stop the builder thread (protected by _mutex)
+    bool _failed = false;            //!< Set if the builder thread failed (protected by _mutex)
+    std::thread _thread{};
+
+    //! Main loop of the builder thread
+    void build_loop();
+
+  public:
+    //! Compile `routes` (on the calling thread), and start the builder thread
+    Dir24_8Builder(const LPMTrie &routes, const uint64_t version);
+
+    //! Stop the builder thread (dropping any changes not yet applied), and free the current table
+    //! \note There must be no readers left.
+    ~Dir24_8Builder();
+
+    //! \brief Report that a prefix was added or changed (`value`), or removed (empty), making `version` of the
+    //! routes
+    //! \details Does nothing once the builder thread has failed.
+    void update(const uint32_t prefix,
+                const uint8_t length,
+                const std::optional<uint32_t> value,
+                const uint64_t version);
+
+    //! \brief The current table (from any thread); it may be used until the caller's Epoch::Guard is released
+    //! \returns null if the builder thread failed to apply a change, and withdrew the table
+    const Dir24_8Table *table() const { return _table.load(std::memory_order_acquire); }
+
+    //! \name
+    //! A Dir24_8Builder cannot be copied or moved (its thread refers to it)
+
+    //!@{
+    Dir24_8Builder(const Dir24_8Builder &other) = delete;
+    Dir24_8Builder &operator=(const Dir24_8Builder &other) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_DIR24_8_TABLE_HH
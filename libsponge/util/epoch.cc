@@ -0,0 +1,146 @@
+#include "epoch.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t MAX_THREADS = 512;         //!< Most threads that can hold guards at once
+constexpr uint64_t QUIESCENT = UINT64_MAX;  //!< A thread's epoch while it holds no guard
+
+//! What one thread publishes about its guards, on a cache line of its own
+struct alignas(64) Slot {
+    atomic<uint64_t> epoch{QUIESCENT};  //!< The global epoch when the thread entered its outermost guard
+    atomic<bool> in_use{false};         //!< Whether a thread has claimed the slot
+};
+
+//! The state shared by all threads
+struct Domain {
+    atomic<uint64_t> epoch{0};       //!< Advanced by every retirement
+    array<Slot, MAX_THREADS> slots{};
+
+    mutex retired_mutex{};                               //!< Protects `retired` (never taken by readers)
+    vector<pair<uint64_t, function<void()>>> retired{};  //!< Deleters, with the epoch they were retired in
+
+    //! Free everything retired since no thread can still be reading (at exit)
+    ~Domain() {
+        for (auto &[epoch_retired, deleter] : retired) {
+            deleter();
+        }
+    }
+
+    //! Take the deleters of the objects no guard can still see (with `retired_mutex` held)
+    vector<function<void()>> take_reclaimable() {
+        atomic_thread_fence(memory_order_seq_cst);
+        uint64_t oldest = QUIESCENT;
+        for (const auto &slot : slots) {
+            oldest = min(oldest, slot.epoch.load());
+        }
+
+        // an object retired in epoch `e` was unpublished before the epoch advanced past `e`, so a guard
+        // entered in a later epoch cannot have loaded it
+        const auto safe = partition(retired.begin(), retired.end(), [&](const auto &r) { return r.first >= oldest; });
+        vector<function<void()>> deleters;
+        for (auto it = safe; it != retired.end(); ++it) {
+            deleters.push_back(move(it->second));
+        }
+        retired.erase(safe, retired.end());
+        return deleters;
+    }
+};
+
+Domain &domain() {
+    static Domain instance;
+    return instance;
+}
+
+//! The calling thread's slot (claimed on first use, and released when the thread exits) and guard depth
+struct ThreadSlot {
+    Slot *slot = nullptr;
+    size_t depth = 0;
+
+    ThreadSlot() = default;
+    ThreadSlot(const ThreadSlot &other) = delete;
+    ThreadSlot &operator=(const ThreadSlot &other) = delete;
+
+    ~ThreadSlot() {
+        if (slot) {
+            slot->in_use.store(false, memory_order_release);
+        }
+    }
+
+    Slot &get() {
+        if (not slot) {
+            for (auto &candidate : domain().slots) {
+                bool expected = false;
+                if (candidate.in_use.compare_exchange_strong(expected, true)) {
+                    slot = &candidate;
+                    return *slot;
+                }
+            }
+            throw runtime_error("Epoch: too many threads");
+        }
+        return *slot;
+    }
+};
+
+thread_local ThreadSlot this_thread_slot;
+
+}  // namespace
+
+//! \details The store of the epoch is followed by a full fence, so that whatever the guarded code loads
+//! is loaded after a writer scanning the slots could see that this thread is reading.
+Epoch::Guard::Guard() {
+    if (this_thread_slot.depth++ == 0) {
+        this_thread_slot.get().epoch.store(domain().epoch.load());
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+}
+
+Epoch::Guard::~Guard() {
+    if (--this_thread_slot.depth == 0) {
+        this_thread_slot.slot->epoch.store(QUIESCENT, memory_order_release);
+    }
+}
+
+//! \param[in] deleter frees the retired object; it is called on whichever thread next reclaims (with no
+//! lock held, so it may retire objects itself)
+//! \note Call only after the object has been unpublished (so that no new guard can load it).
+void Epoch::retire_with(function<void()> &&deleter) {
+    Domain &d = domain();
+    vector<function<void()>> deleters;
+    {
+        const lock_guard<mutex> lock(d.retired_mutex);
+        d.retired.emplace_back(d.epoch.fetch_add(1), move(deleter));
+        deleters = d.take_reclaimable();
+    }
+    for (auto &reclaimable : deleters) {
+        reclaimable();
+    }
+}
+
+void Epoch::reclaim() {
+    Domain &d = domain();
+    vector<function<void()>> deleters;
+    {
+        const lock_guard<mutex> lock(d.retired_mutex);
+        deleters = d.take_reclaimable();
+    }
+    for (auto &deleter : deleters) {
+        deleter();
+    }
+}
+
+size_t Epoch::pending() {
+    Domain &d = domain();
+    const lock_guard<mutex> lock(d.retired_mutex);
+    return d.retired.size();
+}
@@ -0,0 +1,52 @@
+#ifndef SPONGE_LIBSPONGE_EPOCH_HH
+#define SPONGE_LIBSPONGE_EPOCH_HH
+
+#include <cstddef>
+#include <functional>
+
+//! \brief Epoch-based reclamation: readers use shared objects without taking locks, and writers free the
+//! objects they replace once no reader can still be using them
+//! \details A writer publishes a new version of an object by swapping an atomic pointer, then retires the
+//! old version. A reader holds an Epoch::Guard while it uses what it loaded from such a pointer. The old
+//! version is freed (by a later call to retire() or reclaim()) once every guard that was held when it was
+//! retired has been released.
+//!
+//! Entering and leaving a guard costs two stores to a cache line of the reader's own; readers never wait.
+class Epoch {
+  public:
+    //! \brief A read-side critical section (guards on one thread may nest)
+    //! \details Objects loaded while it is held are not freed until it is released.
+    class Guard {
+      public:
+        //! Enter the critical section
+        Guard();
+
+        //! Leave the critical section
+        ~Guard();
+
+        //! \name
+        //! A Guard belongs to the scope (and thread) that made it
+
+        //!@{
+        Guard(const Guard &other) = delete;
+        Guard &operator=(const Guard &other) = delete;
+        //!@}
+    };
+
+    //! Delete `object` once no reader can still be using it
+    template <typename T>
+    static void retire(const T *object) {
+        retire_with([object] { delete object; });
+    }
+
+    //! Call `deleter` once no reader can still be using what it frees
+    static void retire_with(std::function<void()> &&deleter);
+
+    //! Free whatever retired objects no reader can still be using
+    static void reclaim();
+
+    //! Number of retired objects not yet freed
+    static size_t pending();
+};
+
+#endif  // SPONGE_LIBSPONGE_EPOCH_HH
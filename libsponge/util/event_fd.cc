@@ -0,0 +1,23 @@
+#include "event_fd.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventFD::EventFD() : FileDescriptor(SystemCall("eventfd", eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))) {}
+
+void EventFD::raise() {
+    const uint64_t one = 1;
+    // not counted as a write (see FileDescriptor::register_write): the count is not atomic, and raise() is
+    // called from other threads than the one that owns the descriptor
+    SystemCall("write", ::write(fd_num(), &one, sizeof(one)));
+}
+
+void EventFD::lower() {
+    uint64_t count;
+    SystemCall("read", ::read(fd_num(), &count, sizeof(count)), EAGAIN);
+    register_read();
+}
@@ -0,0 +1,24 @@
+#ifndef SPONGE_LIBSPONGE_EVENT_FD_HH
+#define SPONGE_LIBSPONGE_EVENT_FD_HH
+
+#include "file_descriptor.hh"
+
+//! \brief An [eventfd](\ref man2::eventfd) used as a flag: readable while raised
+//! \details Lets one thread wake another thread's EventLoop (e.g. to say that a queue it reads is not empty).
+class EventFD : public FileDescriptor {
+  public:
+    //! Create a lowered flag
+    EventFD();
+
+    //! \brief Make the descriptor readable (safe to call from any thread)
+    //! \note Not counted in write_count(), so an EventLoop rule cannot wait to raise the flag.
+    void raise();
+
+    //! Make the descriptor unreadable (does nothing if it was not raised)
+    void lower();
+
+    //! Count consuming what the flag announced as a read, without lowering it (see EventLoop)
+    using FileDescriptor::register_read;
+};
+
+#endif  // SPONGE_LIBSPONGE_EVENT_FD_HH
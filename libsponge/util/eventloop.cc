@@ -2,7 +2,9 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <cerrno>
+#include <climits>
 #include <stdexcept>
 #include <system_error>
 #include <utility>
@@ -14,78 +16,236 @@ unsigned int EventLoop::Rule::service_count() const {
     return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+//! \param[in] backend selects how wait_next_event waits for ready file descriptors
+EventLoop::EventLoop(const Backend backend) : _backend(backend), _timers(timestamp_ms()) {
+    if (_backend == Backend::IOUring) {
+        if (::IOUring::available()) {
+            _uring.emplace(256, 1024);
+            return;
+        }
+        _backend = Backend::Epoll;
+    }
+    if (_backend == Backend::Epoll) {
+        _epoll.emplace(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC)));
+        _ready.resize(256);
+    }
+}
+
 //! \param[in] fd is the FileDescriptor to be polled
 //! \param[in] direction indicates whether to poll for reading (Direction::In) or writing (Direction::Out)
 //! \param[in] callback is called when `fd` is ready.
-//! \param[in] interest is called by EventLoop::wait_next_event. If it returns `true`, `fd` will
-//!                     be polled, otherwise `fd` will be ignored only for this execution of `wait_next_event.
+//! \param[in] interest is consulted (according to `mode`) to decide whether `fd` should be polled. If it is
+//!                     empty, the rule is interested until EventLoop::set_interest says otherwise.
 //! \param[in] cancel is called when the rule is cancelled (e.g. on hangup, EOF, or closure).
-void EventLoop::add_rule(const FileDescriptor &fd,
-                         const Direction direction,
-                         const CallbackT &callback,
-                         const InterestT &interest,
-                         const CallbackT &cancel) {
-    _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+//! \param[in] mode says whether `interest` is called before every wait (InterestMode::Polled), or only
+//!                 after `callback` and on EventLoop::notify (InterestMode::Notified).
+//! \returns a handle for EventLoop::set_interest and EventLoop::notify
+EventLoop::RuleHandle EventLoop::add_rule(const FileDescriptor &fd,
+                                          const Direction direction,
+                                          const CallbackT &callback,
+                                          const InterestT &interest,
+                                          const CallbackT &cancel,
+                                          const InterestMode mode) {
+    Rule rule{fd.duplicate(), direction, callback, interest, cancel, mode, false};
+    auto &rules = rule.polled() ? _polled_rules : _rules;
+    const auto it = rules.insert(rules.end(), move(rule));
+
+    if (_backend != Backend::Poll) {
+        try {
+            register_rule(it);
+        } catch (...) {
+            rules.erase(it);
+            throw;
+        }
+    }
+    if (not it->polled()) {
+        set_rule_interest(*it, it->interest ? it->interest() : true);
+    }
+
+    return RuleHandle{it};
+}
+
+//! \param[in] rule is a rule that was added without an interest callback (or in InterestMode::Notified,
+//!                 in which case its callback will override this the next time it is consulted)
+//! \param[in] interested is whether the rule's fd should be polled
+void EventLoop::set_interest(const RuleHandle &rule, const bool interested) {
+    if (rule._rule->polled()) {
+        throw runtime_error("EventLoop::set_interest: rule's interest is polled");
+    }
+    set_rule_interest(*rule._rule, interested);
+}
+
+//! \param[in] rule is a rule whose interest callback's answer may have changed (ignored unless the rule
+//!                 is in InterestMode::Notified)
+void EventLoop::notify(const RuleHandle &rule) {
+    Rule &this_rule = *rule._rule;
+    if (this_rule.interest and not this_rule.polled()) {
+        set_rule_interest(this_rule, this_rule.interest());
+    }
+}
+
+void EventLoop::set_rule_interest(Rule &rule, const bool interested) {
+    if (rule.interested == interested) {
+        return;
+    }
+    rule.interested = interested;
+    if (not rule.polled()) {
+        interested ? ++_interested_count : --_interested_count;
+    }
+    if (_backend != Backend::Poll and not rule.fd.closed()) {
+        update_registration(rule.fd.fd_num());
+    }
 }
 
-//! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll); `wait_next_event`
-//!                       returns Result::Timeout if no fd is ready after the timeout expires.
+EventLoop::RuleIterator EventLoop::cancel_rule(const RuleIterator rule) {
+    rule->cancel();
+    if (rule->interested and not rule->polled()) {
+        --_interested_count;
+    }
+    if (_backend != Backend::Poll) {
+        unregister_rule(rule);
+    }
+    auto &rules = rule->polled() ? _polled_rules : _rules;
+    return rules.erase(rule);
+}
+
+void EventLoop::service_rule(Rule &rule) {
+    const auto count_before = rule.service_count();
+    rule.callback();
+
+    if (rule.interest and not rule.polled()) {
+        set_rule_interest(rule, rule.interest());
+    }
+
+    // only check for busy wait if we're not canceling or exiting
+    const bool still_interested = rule.polled() ? rule.interest() : rule.interested;
+    if (count_before == rule.service_count() and still_interested) {
+        throw runtime_error("EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+    }
+}
+
+//! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll) or
+//!                       [epoll_wait(2)](\ref man2::epoll_wait); `wait_next_event` returns
+//!                       Result::Timeout if no fd is ready after the timeout expires.
 //! \returns Eventloop::Result indicating success, timeout, or no more Rule objects to poll.
 //!
-//! For each Rule, this function first calls Rule::interest; if `true`, Rule::fd is added to the
-//! list of file descriptors to be polled for readability (if Rule::direction == Direction::In) or
-//! writability (if Rule::direction == Direction::Out) unless Rule::fd has reached EOF, in which case
-//! the Rule is canceled (i.e., deleted from EventLoop::_rules).
+//! For each InterestMode::Polled Rule, this function first calls Rule::interest; if `true`, Rule::fd is
+//! polled for readability (if Rule::direction == Direction::In) or writability (if Rule::direction ==
+//! Direction::Out) unless Rule::fd has reached EOF, in which case the Rule is canceled (i.e., deleted from
+//! EventLoop::_polled_rules). Other rules are polled if they are currently interested.
 //!
-//! Next, this function calls [poll(2)](\ref man2::poll) with timeout value `timeout_ms`.
+//! Next, this function waits for a ready fd with timeout value `timeout_ms`, or until the next timer
+//! (see EventLoop::add_timer) expires if that is sooner.
 //!
-//! Then, for each ready file descriptor, this function calls Rule::callback. If fd reaches EOF or
-//! if the Rule was registered using EventLoop::add_cancelable_rule and Rule::callback returns true,
-//! this Rule is canceled.
+//! Then, for each ready file descriptor, this function calls Rule::callback. If fd reaches EOF,
+//! this Rule is canceled. Then it calls the callback of each expired timer.
 //!
 //! If an error occurs during polling, this function throws a std::runtime_error.
 //!
-//! If a [signal(7)](\ref man7::signal) was caught during polling or if EventLoop::_rules becomes empty,
-//! this function returns Result::Exit.
+//! If a [signal(7)](\ref man7::signal) was caught during polling or if no Rule is interested (and no
+//! timer is pending), this function returns Result::Exit.
 //!
-//! If a timeout occurred while polling (i.e., no fd became ready), this function returns Result::Timeout.
+//! If a timeout occurred while polling (i.e., no fd became ready and no timer expired), this function
+//! returns Result::Timeout.
 //!
 //! Otherwise, this function returns Result::Success.
 //!
-//! \b IMPORTANT: every call to Rule::callback must read from or write to Rule::fd, or the `interest`
-//! callback must stop returning true after the callback completes.
+//! \b IMPORTANT: every call to Rule::callback must read from or write to Rule::fd, or the Rule must
+//! stop being interested after the callback completes.
 //! If none of these conditions occur, EventLoop::wait_next_event will throw std::runtime_error. This is
-//! because [poll(2)](\ref man2::poll) is level triggered, so failing to act on a ready file descriptor
+//! because both backends are level triggered, so failing to act on a ready file descriptor
 //! will result in a busy loop (poll returns on a ready file descriptor; file descriptor is not read or
 //! written, so it is still ready; the next call to poll will immediately return).
 EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
+    // fire the timers that are already due, and wait no longer than until the next one
+    uint64_t now = timestamp_ms();
+    const bool timers_fired = _timers.advance(now) > 0;
+    int wait_ms = timers_fired ? 0 : timeout_ms;
+    const auto next_timer = _timers.next_expiry();
+    if (next_timer) {
+        const uint64_t until_next_timer =
+            min(next_timer.value() > now ? next_timer.value() - now : 0, uint64_t(INT_MAX));
+        if (wait_ms < 0 or until_next_timer < uint64_t(wait_ms)) {
+            wait_ms = int(until_next_timer);
+        }
+    }
+
+    _interrupted = false;
+    Result result;
+    switch (_backend) {
+        case Backend::Epoll:
+            result = wait_next_event_epoll(wait_ms);
+            break;
+        case Backend::IOUring:
+            result = wait_next_event_uring(wait_ms);
+            break;
+        default:
+            result = wait_next_event_poll(wait_ms);
+    }
+
+    if (result == Result::Exit) {
+        if (_interrupted or _timers.size() == 0) {
+            return Result::Exit;
+        }
+        // no rules to wait on, but timers still pending: just sleep
+        try {
+            SystemCall("poll", ::poll(nullptr, 0, wait_ms));
+        } catch (unix_error const &e) {
+            if (e.code().value() == EINTR) {
+                return Result::Exit;
+            }
+            throw;
+        }
+        result = Result::Timeout;
+    }
+
+    now = timestamp_ms();
+    if (_timers.advance(now) > 0 or timers_fired) {
+        return Result::Success;
+    }
+    return result;
+}
+
+//! \param[in] delay_ms is how long to wait (at millisecond resolution) before calling `callback`
+//! \param[in] callback is called from EventLoop::wait_next_event when the timer expires
+//! \returns a handle for EventLoop::cancel_timer
+EventLoop::TimerHandle EventLoop::add_timer(const uint64_t delay_ms, const CallbackT &callback) {
+    return _timers.add(timestamp_ms() + delay_ms, callback);
+}
+
+//! \param[in] timer is the handle returned by EventLoop::add_timer
+void EventLoop::cancel_timer(const TimerHandle &timer) { _timers.cancel(timer); }
+
+EventLoop::Result EventLoop::wait_next_event_poll(const int timeout_ms) {
     vector<pollfd> pollfds{};
-    pollfds.reserve(_rules.size());
+    vector<RuleIterator> polled{};
+    pollfds.reserve(_polled_rules.size() + _rules.size());
+    polled.reserve(_polled_rules.size() + _rules.size());
     bool something_to_poll = false;
 
     // set up the pollfd for each rule
-    for (auto it = _rules.cbegin(); it != _rules.cend();) {  // NOTE: it gets erased or incremented in loop body
-        const auto &this_rule = *it;
-        if (this_rule.direction == Direction::In && this_rule.fd.eof()) {
-            // no more reading on this rule, it's reached eof
-            this_rule.cancel();
-            it = _rules.erase(it);
-            continue;
-        }
+    for (auto *rules : {&_polled_rules, &_rules}) {
+        for (auto it = rules->begin(); it != rules->end();) {  // NOTE: it gets erased or incremented in loop body
+            auto &this_rule = *it;
+            if (this_rule.defunct()) {
+                // no more reading on this rule (it's reached eof), or the fd has been closed
+                it = cancel_rule(it);
+                continue;
+            }
 
-        if (this_rule.fd.closed()) {
-            this_rule.cancel();
-            it = _rules.erase(it);
-            continue;
-        }
+            if (this_rule.polled()) {
+                set_rule_interest(this_rule, this_rule.interest());
+            }
 
-        if (this_rule.interest()) {
-            pollfds.push_back({this_rule.fd.fd_num(), static_cast<short>(this_rule.direction), 0});
-            something_to_poll = true;
-        } else {
-            pollfds.push_back({this_rule.fd.fd_num(), 0, 0});  // placeholder --- we still want errors
+            if (this_rule.interested) {
+                pollfds.push_back({this_rule.fd.fd_num(), static_cast<short>(this_rule.direction), 0});
+                something_to_poll = true;
+            } else {
+                pollfds.push_back({this_rule.fd.fd_num(), 0, 0});  // placeholder --- we still want errors
+            }
+            polled.push_back(it);
+            ++it;
         }
-        ++it;
     }
 
     // quit if there is nothing left to poll
@@ -100,13 +260,13 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
         }
     } catch (unix_error const &e) {
         if (e.code().value() == EINTR) {
+            _interrupted = true;
             return Result::Exit;
         }
     }
 
     // go through the poll results
-
-    for (auto [it, idx] = make_pair(_rules.begin(), size_t(0)); it != _rules.end(); ++idx) {
+    for (size_t idx = 0; idx < pollfds.size(); ++idx) {
         const auto &this_pollfd = pollfds[idx];
 
         const auto poll_error = static_cast<bool>(this_pollfd.revents & (POLLERR | POLLNVAL));
@@ -114,32 +274,306 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
             throw runtime_error("EventLoop: error on polled file descriptor");
         }
 
-        const auto &this_rule = *it;
         const auto poll_ready = static_cast<bool>(this_pollfd.revents & this_pollfd.events);
         const auto poll_hup = static_cast<bool>(this_pollfd.revents & POLLHUP);
         if (poll_hup && this_pollfd.events && !poll_ready) {
             // if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
             //   - if it was POLLIN and nothing is readable, no more will ever be readable
             //   - if it was POLLOUT, it will not be writable again
-            this_rule.cancel();
-            it = _rules.erase(it);
+            cancel_rule(polled[idx]);
             continue;
         }
 
         if (poll_ready) {
             // we only want to call callback if revents includes the event we asked for
-            const auto count_before = this_rule.service_count();
-            this_rule.callback();
+            service_rule(*polled[idx]);
+        }
+    }
 
-            // only check for busy wait if we're not canceling or exiting
-            if (count_before == this_rule.service_count() and this_rule.interest()) {
-                throw runtime_error(
-                    "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+    return Result::Success;
+}
+
+//! Adds the rule to the registration for its fd number, creating the kernel registration if needed.
+//! A rule left behind by an fd that has since been closed (and whose number was reused) is canceled first.
+void EventLoop::register_rule(const RuleIterator rule) {
+    const int fd_num = rule->fd.fd_num();
+    auto reg = _registrations.find(fd_num);
+    if (reg != _registrations.end()) {
+        for (const auto &existing : {reg->second.in, reg->second.out}) {
+            if (existing and (*existing)->fd.closed()) {
+                cancel_rule(*existing);
             }
         }
+        reg = _registrations.find(fd_num);
+    }
 
-        ++it;  // if we got here, it means we didn't call _rules.erase()
+    if (reg == _registrations.end() and _backend == Backend::IOUring) {
+        reg = _registrations.emplace(fd_num, Registration{}).first;  // polls are posted once the rule is interested
+    } else if (reg == _registrations.end()) {
+        epoll_event event{};
+        event.data.fd = fd_num;
+        const bool pollable =
+            SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event), EPERM) == 0;
+        reg = _registrations.emplace(fd_num, Registration{}).first;
+        if (not pollable) {
+            // epoll doesn't support this kind of fd (e.g., a regular file); like poll(2), treat it as always ready
+            reg->second.pollable = false;
+            _unpollable.push_back(fd_num);
+        }
+    }
+
+    auto &slot = rule->direction == Direction::In ? reg->second.in : reg->second.out;
+    if (slot) {
+        throw runtime_error("EventLoop: fd already has a rule for this direction");
+    }
+    slot = rule;
+}
+
+void EventLoop::unregister_rule(const RuleIterator rule) {
+    const int fd_num = rule->fd.fd_num();
+    const auto reg = _registrations.find(fd_num);
+    if (reg == _registrations.end()) {
+        return;
+    }
+    auto &slot = rule->direction == Direction::In ? reg->second.in : reg->second.out;
+    if (slot != rule) {
+        return;
+    }
+    slot.reset();
+
+    if (reg->second.in or reg->second.out) {
+        if (not rule->fd.closed()) {
+            update_registration(fd_num);
+        }
+        return;
+    }
+
+    if (_backend == Backend::IOUring) {
+        update_uring_poll(reg->second, fd_num, 0);  // even if the fd is closed: the poll holds a reference to it
+    } else if (reg->second.pollable) {
+        if (not rule->fd.closed()) {
+            ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr);  // failure just means it's already gone
+        }
+    } else {
+        _unpollable.erase(find(_unpollable.begin(), _unpollable.end(), fd_num));
+    }
+    _registrations.erase(reg);
+}
+
+//! Recomputes the events requested for an fd number, and tells the kernel if they changed.
+void EventLoop::update_registration(const int fd_num) {
+    const auto reg = _registrations.find(fd_num);
+    if (reg == _registrations.end()) {
+        return;
+    }
+    auto &registration = reg->second;
+
+    uint32_t events = 0;
+    if (registration.in and (*registration.in)->interested) {
+        events |= EPOLLIN;
+    }
+    if (registration.out and (*registration.out)->interested) {
+        events |= EPOLLOUT;
+    }
+    if (_backend == Backend::IOUring) {
+        update_uring_poll(registration, fd_num, events);
+        return;
+    }
+
+    if (events == registration.events) {
+        return;
+    }
+    registration.events = events;
+
+    if (registration.pollable) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd_num;
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event));
+    }
+}
+
+//! Calls the callback of each interested rule on `fd_num` that `revents` says is ready.
+void EventLoop::dispatch(const int fd_num, const uint32_t revents) {
+    if (revents & (EPOLLERR | POLLNVAL)) {
+        throw runtime_error("EventLoop: error on polled file descriptor");
+    }
+
+    for (const auto direction : {Direction::In, Direction::Out}) {
+        // look the registration up again each time: servicing or canceling a rule may have changed it
+        const auto reg = _registrations.find(fd_num);
+        if (reg == _registrations.end()) {
+            return;
+        }
+        const auto slot = direction == Direction::In ? reg->second.in : reg->second.out;
+        if (not slot or not(*slot)->interested) {
+            continue;
+        }
+        const RuleIterator rule = *slot;
+
+        const bool ready = revents & (direction == Direction::In ? EPOLLIN : EPOLLOUT);
+        if (rule->defunct() or (not ready and (revents & EPOLLHUP))) {
+            // as with poll: a hangup with nothing to read (or on an output) means the fd is defunct
+            cancel_rule(rule);
+            continue;
+        }
+
+        if (ready) {
+            service_rule(*rule);
+            if (rule->defunct()) {
+                cancel_rule(rule);
+            }
+        }
+    }
+}
+
+//! \details Also cancels defunct rules in EventLoop::_rules, as the Poll backend does. The kernel says
+//! nothing when an fd is closed (or a rule's input reaches EOF) outside the rule's own callback, so such
+//! a rule would otherwise stay interested, and wait_next_event would never return Result::Exit. Those
+//! rules are looked for only if some fd has been closed or reached EOF since the last sweep (see
+//! FileDescriptor::finished_count), so waits stay independent of the number of idle rules.
+size_t EventLoop::refresh_rules() {
+    const uint64_t finished = FileDescriptor::finished_count();
+    if (finished != _swept_at) {
+        _swept_at = finished;
+        for (auto it = _rules.begin(); it != _rules.end();) {
+            it = it->defunct() ? cancel_rule(it) : next(it);
+        }
+    }
+
+    size_t polled_interested = 0;
+    for (auto it = _polled_rules.begin(); it != _polled_rules.end();) {
+        if (it->defunct()) {
+            it = cancel_rule(it);
+            continue;
+        }
+        set_rule_interest(*it, it->interest());
+        polled_interested += it->interested;
+        ++it;
+    }
+    return polled_interested;
+}
+
+EventLoop::Result EventLoop::wait_next_event_epoll(const int timeout_ms) {
+    // quit if there is nothing left to poll
+    if (refresh_rules() + _interested_count == 0) {
+        return Result::Exit;
+    }
+
+    // fds that epoll can't watch are always ready for whatever they're interested in
+    vector<pair<int, uint32_t>> always_ready{};
+    for (const int fd_num : _unpollable) {
+        if (const uint32_t events = _registrations.at(fd_num).events) {
+            always_ready.emplace_back(fd_num, events);
+        }
+    }
+
+    int ready_count = 0;
+    try {
+        ready_count = SystemCall(
+            "epoll_wait",
+            ::epoll_wait(_epoll->fd_num(), _ready.data(), _ready.size(), always_ready.empty() ? timeout_ms : 0));
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            _interrupted = true;
+            return Result::Exit;
+        }
+        throw;
+    }
+
+    if (ready_count == 0 and always_ready.empty()) {
+        return Result::Timeout;
+    }
+
+    for (int i = 0; i < ready_count; ++i) {
+        dispatch(_ready[i].data.fd, _ready[i].events);
+    }
+    for (const auto &[fd_num, events] : always_ready) {
+        dispatch(fd_num, events);
     }
 
     return Result::Success;
 }
+
+//! Replaces the fd's outstanding poll (if any) with one for `events` (if nonzero). Both requests are only
+//! queued; they reach the kernel with the next submission, normally the one that waits.
+void EventLoop::update_uring_poll(Registration &registration, const int fd_num, const uint32_t events) {
+    const auto user_data = [fd_num](const uint32_t poll_id) { return (uint64_t(poll_id) << 32) | uint32_t(fd_num); };
+
+    if (events == registration.events) {
+        return;
+    }
+    if (registration.events) {
+        io_uring_sqe &sqe = _uring->prepare(IORING_OP_POLL_REMOVE, -1, 0);
+        sqe.addr = user_data(registration.poll_id);
+    }
+    registration.events = events;
+    if (events) {
+        if (++_next_poll_id == 0) {
+            ++_next_poll_id;  // zero is reserved for completions of IORING_OP_POLL_REMOVE
+        }
+        registration.poll_id = _next_poll_id;
+        io_uring_sqe &sqe = _uring->prepare(IORING_OP_POLL_ADD, fd_num, user_data(registration.poll_id));
+        sqe.poll32_events = events;
+    }
+}
+
+EventLoop::Result EventLoop::wait_next_event_uring(const int timeout_ms) {
+    // quit if there is nothing left to poll
+    if (refresh_rules() + _interested_count == 0) {
+        return Result::Exit;
+    }
+
+    try {
+        _uring->submit(1, timeout_ms);
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            _interrupted = true;
+            return Result::Exit;
+        }
+        throw;
+    }
+
+    vector<pair<int, uint32_t>> ready{};
+    while (const auto cqe = _uring->pop_completion()) {
+        const int fd_num = static_cast<int>(cqe->user_data & 0xffffffff);
+        const auto poll_id = static_cast<uint32_t>(cqe->user_data >> 32);
+        const auto reg = _registrations.find(fd_num);
+        if (poll_id == 0 or reg == _registrations.end() or reg->second.poll_id != poll_id or
+            reg->second.events == 0) {
+            continue;  // a removal, or a poll that has since been replaced
+        }
+
+        // the poll was one-shot, so it has to be posted again (after the callbacks have run)
+        reg->second.events = 0;
+        _rearm.push_back(fd_num);
+
+        if (cqe->res == -ECANCELED) {
+            continue;
+        }
+        if (cqe->res < 0) {
+            throw unix_error("io_uring poll", -cqe->res);
+        }
+        ready.emplace_back(fd_num, static_cast<uint32_t>(cqe->res));
+    }
+
+    for (const auto &[fd_num, revents] : ready) {
+        dispatch(fd_num, revents);
+    }
+
+    for (const int fd_num : _rearm) {
+        const auto reg = _registrations.find(fd_num);
+        if (reg == _registrations.end()) {
+            continue;
+        }
+        const auto &registration = reg->second;
+        if ((registration.in and (*registration.in)->fd.closed()) or
+            (registration.out and (*registration.out)->fd.closed())) {
+            continue;  // don't poll an fd that has been closed
+        }
+        update_registration(fd_num);
+    }
+    _rearm.clear();
+
+    return ready.empty() ? Result::Timeout : Result::Success;
+}
@@ -2,11 +2,18 @@
 #define SPONGE_LIBSPONGE_EVENTLOOP_HH
 
 #include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "timing_wheel.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <optional>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
@@ -17,44 +24,173 @@ class EventLoop {
         Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    //! Returned by each call to EventLoop::wait_next_event.
+    enum class Result {
+        Success,  //!< At least one Rule was triggered.
+        Timeout,  //!< No rules were triggered before timeout.
+        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    };
+
+    //! Selects the kernel interface that EventLoop::wait_next_event uses.
+    enum class Backend {
+        Poll,    //!< Build a [poll(2)](\ref man2::poll) set from every Rule on each call (cost grows with #rules)
+        Epoll,   //!< Keep registrations in an [epoll(7)](\ref man7::epoll) instance (cost grows with #ready fds)
+        IOUring  //!< Post polls to an [io_uring(7)](\ref man7::io_uring), re-arming them as part of each wait
+    };
+
+    //! For a Rule with an interest callback, selects when the callback is consulted.
+    enum class InterestMode {
+        Polled,   //!< Before every call to EventLoop::wait_next_event (compatibility mode)
+        Notified  //!< When the Rule is added, after its callback runs, and on EventLoop::notify
+    };
+
   private:
     using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
     using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
 
     //! \brief Specifies a condition and callback that an EventLoop should handle.
-    //! \details Created by calling EventLoop::add_rule() or EventLoop::add_cancelable_rule().
+    //! \details Created by calling EventLoop::add_rule().
     class Rule {
       public:
         FileDescriptor fd;    //!< FileDescriptor to monitor for activity.
         Direction direction;  //!< Direction::In for reading from fd, Direction::Out for writing to fd.
         CallbackT callback;   //!< A callback that reads or writes fd.
-        InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
+        InterestT interest;   //!< A callback that returns `true` whenever fd should be polled (may be empty).
         CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        InterestMode mode;    //!< When Rule::interest is consulted
+        bool interested;      //!< Whether fd is currently being waited on
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
         unsigned int service_count() const;
+
+        //! `true` if Rule::interest must be consulted before every wait
+        bool polled() const { return interest and mode == InterestMode::Polled; }
+
+        //! `true` if the rule can never be serviced again (EOF on an input, or fd closed)
+        bool defunct() const { return (direction == Direction::In and fd.eof()) or fd.closed(); }
     };
 
-    std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
+    using RuleIterator = std::list<Rule>::iterator;
 
   public:
-    //! Returned by each call to EventLoop::wait_next_event.
-    enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
-        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    //! \brief Refers to a Rule added with EventLoop::add_rule
+    //! \note A RuleHandle must not be used after the Rule's cancel callback has run.
+    class RuleHandle {
+        friend class EventLoop;
+        RuleIterator _rule{};
+
+        explicit RuleHandle(const RuleIterator rule) : _rule(rule) {}
+
+      public:
+        RuleHandle() = default;
+    };
+
+    //! \brief Refers to a timer added with EventLoop::add_timer
+    //! \note Canceling a timer that has already fired (or been canceled) does nothing.
+    using TimerHandle = TimingWheel::TimerId;
+
+  private:
+    //! \brief The rules that wait on one fd number (an epoll instance holds each fd only once)
+    struct Registration {
+        std::optional<RuleIterator> in{};   //!< Rule with Direction::In, if any
+        std::optional<RuleIterator> out{};  //!< Rule with Direction::Out, if any
+        uint32_t events = 0;                //!< Events currently requested from the kernel
+        bool pollable = true;               //!< `false` if epoll refused the fd (e.g., a regular file)
+        uint32_t poll_id = 0;               //!< Identifies the outstanding io_uring poll (if `events` is nonzero)
     };
 
+    Backend _backend;
+
+    std::list<Rule> _polled_rules{};  //!< Rules whose interest is consulted before every wait
+    std::list<Rule> _rules{};         //!< Rules whose interest changes only when the EventLoop is told
+    size_t _interested_count = 0;     //!< Number of interested Rule objects in EventLoop::_rules
+    uint64_t _swept_at = 0;           //!< FileDescriptor::finished_count when _rules was last swept
+
+    //! \name Epoll backend state
+    //!@{
+    std::optional<FileDescriptor> _epoll{};                   //!< The epoll instance
+    std::unordered_map<int, Registration> _registrations{};  //!< Rules by fd number
+    std::vector<int> _unpollable{};                           //!< fd numbers epoll refused; treated as always ready
+    std::vector<epoll_event> _ready{};                        //!< Results of the most recent epoll_wait
+    //!@}
+
+    TimingWheel _timers;  //!< Timers added with EventLoop::add_timer
+
+    bool _interrupted = false;  //!< Whether the last wait was interrupted by a signal (rather than out of rules)
+
+    //! \name IOUring backend state (shares EventLoop::_registrations)
+    //!@{
+    std::optional<::IOUring> _uring{};  //!< The ring (polls are one-shot, so they are level triggered)
+    uint32_t _next_poll_id = 0;         //!< Distinguishes a poll's completion from those of polls it replaced
+    std::vector<int> _rearm{};          //!< fd numbers whose polls completed during this wait
+    //!@}
+
+    //! Mark a rule (un)interested, keeping the count and any kernel registration in sync
+    void set_rule_interest(Rule &rule, const bool interested);
+
+    //! Call a rule's cancel callback and delete it; returns the next rule in the same list
+    RuleIterator cancel_rule(const RuleIterator rule);
+
+    //! Run a ready rule's callback and refresh its interest, detecting busy waits
+    void service_rule(Rule &rule);
+
+    //! \brief Cancel defunct rules, and consult the interest callback of each InterestMode::Polled rule
+    //! \returns how many InterestMode::Polled rules are interested
+    size_t refresh_rules();
+
+    //! \name Epoll backend helpers
+    //!@{
+    void register_rule(const RuleIterator rule);
+    void unregister_rule(const RuleIterator rule);
+    void update_registration(const int fd_num);
+    void update_uring_poll(Registration &registration, const int fd_num, const uint32_t events);
+    void dispatch(const int fd_num, const uint32_t revents);
+    //!@}
+
+    //! \name Per-backend implementations of EventLoop::wait_next_event
+    //!@{
+    Result wait_next_event_poll(const int timeout_ms);
+    Result wait_next_event_epoll(const int timeout_ms);
+    Result wait_next_event_uring(const int timeout_ms);
+    //!@}
+
+  public:
+    //! Construct an EventLoop that waits using the given Backend (IOUring falls back to Epoll if unavailable)
+    explicit EventLoop(const Backend backend = Backend::Poll);
+
     //! Add a rule whose callback will be called when `fd` is ready in the specified Direction.
-    void add_rule(const FileDescriptor &fd,
-                  const Direction direction,
-                  const CallbackT &callback,
-                  const InterestT &interest = [] { return true; },
-                  const CallbackT &cancel = [] {});
+    RuleHandle add_rule(const FileDescriptor &fd,
+                        const Direction direction,
+                        const CallbackT &callback,
+                        const InterestT &interest = {},
+                        const CallbackT &cancel = [] {},
+                        const InterestMode mode = InterestMode::Polled);
+
+    //! Set whether a rule without an interest callback should be polled
+    void set_interest(const RuleHandle &rule, const bool interested);
+
+    //! Consult the interest callback of an InterestMode::Notified rule now
+    void notify(const RuleHandle &rule);
+
+    //! \brief Call `callback` (from EventLoop::wait_next_event) once `delay_ms` milliseconds have passed
+    TimerHandle add_timer(const uint64_t delay_ms, const CallbackT &callback);
+
+    //! Cancel a timer added with EventLoop::add_timer, if it has not fired yet
+    void cancel_timer(const TimerHandle &timer);
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! Waits for a ready fd (using the configured Backend) or an expired timer, and then executes callback for each.
     Result wait_next_event(const int timeout_ms);
+
+    //! \name
+    //! An EventLoop cannot be copied (its registrations refer to its own rules)
+
+    //!@{
+    EventLoop(const EventLoop &other) = delete;
+    EventLoop &operator=(const EventLoop &other) = delete;
+    //!@}
+
+    ~EventLoop() = default;
 };
 
 using Direction = EventLoop::Direction;
@@ -62,15 +198,34 @@ using Direction = EventLoop::Direction;
 //! \class EventLoop
 //!
 //! An EventLoop holds a std::list of Rule objects. Each time EventLoop::wait_next_event is
-//! executed, the EventLoop uses the Rule objects to construct a call to [poll(2)](\ref man2::poll).
+//! executed, the EventLoop waits until at least one interested Rule::fd is ready, and then
+//! calls the Rule::callback of each ready Rule.
 //!
 //! When a Rule is installed using EventLoop::add_rule, it will be polled for the specified Rule::direction
-//! whenver the Rule::interest callback returns `true`, until Rule::fd is no longer readable
-//! (for Rule::direction == Direction::In) or writable (for Rule::direction == Direction::Out).
-//! Once this occurs, the Rule is canceled, i.e., the EventLoop deletes it.
+//! whenever it is interested, until Rule::fd is no longer readable (for Rule::direction == Direction::In)
+//! or writable (for Rule::direction == Direction::Out). Once this occurs, the Rule is canceled, i.e.,
+//! the EventLoop calls Rule::cancel and deletes it.
+//!
+//! Whether a Rule is interested is decided in one of three ways:
+//!
+//! - A Rule with an interest callback in InterestMode::Polled (the default) calls the callback before
+//!   every wait. This is the original behavior, and costs one call per Rule per wait.
+//! - A Rule with an interest callback in InterestMode::Notified calls it only when added, after
+//!   Rule::callback runs, and when EventLoop::notify is called for it.
+//! - A Rule without an interest callback starts out interested, and is changed with EventLoop::set_interest.
+//!
+//! With Backend::Poll, every call to EventLoop::wait_next_event builds a [poll(2)](\ref man2::poll)
+//! set from all the rules. With Backend::Epoll, rules are registered once with an [epoll(7)](\ref man7::epoll)
+//! instance and only updated when their interest changes, so a wait costs time proportional to the
+//! number of ready fds (plus the number of InterestMode::Polled rules), not the number of registered fds.
+//! Backend::IOUring is similar, but queues its poll requests in an [io_uring(7)](\ref man7::io_uring) and
+//! submits them with the same system call that waits, so changes in interest cost no extra system calls.
+//! If io_uring is unavailable, it falls back to Backend::Epoll.
+//! The epoll and io_uring backends allow at most one Rule per direction per fd.
 //!
-//! A Rule installed using EventLoop::add_cancelable_rule will be polled and canceled under the
-//! same conditions, with the additional condition that if Rule::callback returns `true`, the
-//! Rule will be canceled.
+//! Timers (EventLoop::add_timer) are kept in a TimingWheel, so a loop can hold one or more per connection
+//! (retransmission, linger, ARP expiry, ...) for many connections: adding or canceling one costs O(1), and
+//! a wait costs time proportional to the number of timers that expire, not the number pending. Each wait
+//! sleeps no longer than until the next timer expires, and fires expired timers before returning.
 
 #endif  // SPONGE_LIBSPONGE_EVENTLOOP_HH
@@ -1,8 +1,10 @@
 #include "file_descriptor.hh"
 
+#include "io_uring.hh"
 #include "util.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
@@ -18,9 +20,15 @@ FileDescriptor::FDWrapper::FDWrapper(const int fd) : _fd(fd) {
     }
 }
 
+//! Counts FileDescriptor::finished_count
+static atomic<uint64_t> finished{0};
+
+uint64_t FileDescriptor::finished_count() { return finished.load(memory_order_relaxed); }
+
 void FileDescriptor::FDWrapper::close() {
     SystemCall("close", ::close(_fd));
     _eof = _closed = true;
+    finished.fetch_add(1, memory_order_relaxed);
 }
 
 FileDescriptor::FDWrapper::~FDWrapper() {
@@ -45,35 +53,46 @@ FileDescriptor::FileDescriptor(shared_ptr<FDWrapper> other_shared_ptr) : _intern
 FileDescriptor FileDescriptor::duplicate() const { return FileDescriptor(_internal_fd); }
 
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
-//! \param[out] str is the string to be read
-void FileDescriptor::read(std::string &str, const size_t limit) {
+//! \returns a Buffer holding the bytes read
+//! \details The bytes land directly in a pooled chunk when they fit (see Buffer::read_from),
+//! so neither the full `limit` nor a fresh string is allocated or zero-filled per call.
+Buffer FileDescriptor::read_buffer(const size_t limit) {
     constexpr size_t BUFFER_SIZE = 1024 * 1024;  // maximum size of a read
     const size_t size_to_read = min(BUFFER_SIZE, limit);
-    str.resize(size_to_read);
 
-    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read));
-    if (limit > 0 && bytes_read == 0) {
+    Buffer ret = Buffer::read_from(size_to_read, [&](const iovec *iov, const int iovcnt) {
+        const ssize_t bytes_read = SystemCall("readv", ::readv(fd_num(), iov, iovcnt));
+        if (bytes_read > static_cast<ssize_t>(size_to_read)) {
+            throw runtime_error("read() read more than requested");
+        }
+        return size_t(bytes_read);
+    });
+    if (limit > 0 && ret.size() == 0 && not _internal_fd->_eof) {
         _internal_fd->_eof = true;
+        finished.fetch_add(1, memory_order_relaxed);
     }
-    if (bytes_read > static_cast<ssize_t>(size_to_read)) {
-        throw runtime_error("read() read more than requested");
-    }
-    str.resize(bytes_read);
 
     register_read();
+    return ret;
 }
 
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
-//! \returns a vector of bytes read
-string FileDescriptor::read(const size_t limit) {
-    string ret;
-
-    read(ret, limit);
+//! \param[out] str is the string to be read
+void FileDescriptor::read(std::string &str, const size_t limit) { str.assign(read_buffer(limit).str()); }
 
-    return ret;
-}
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
+//! \returns a vector of bytes read
+string FileDescriptor::read(const size_t limit) { return read_buffer(limit).copy(); }
 
+//! \param[in] buffer is the data to write
+//! \param[in] write_all is `true` to keep writing until all of `buffer` is written
 size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
+    // only a write that must complete anyway can be deferred: flush() finishes any short write
+    if (write_all and IOUringWriteBatch::queue(*this, buffer)) {
+        register_write();
+        return buffer.size();
+    }
+
     size_t total_bytes_written = 0;
 
     do {
@@ -5,6 +5,7 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
 
@@ -61,13 +62,20 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read up to `limit` bytes into a pooled Buffer (no copy for reads that fit in one chunk)
+    Buffer read_buffer(const size_t limit = std::numeric_limits<size_t>::max());
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
     //! Write a string, possibly blocking until all is written
     size_t write(const std::string &str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
-    //! Write a buffer (or list of buffers), possibly blocking until all is written
+    //! \brief Write a buffer (or list of buffers), possibly blocking until all is written
+    //! \returns the number of bytes written (with `write_all`, all of them)
+    //! \note With `write_all`, while an IOUringWriteBatch is active on this thread, the write may instead
+    //! be queued and performed by IOUringWriteBatch::flush, which then throws any error. A write with
+    //! `write_all` false is always made directly, so it can report a partial write (or throw) itself.
     size_t write(BufferViewList buffer, const bool write_all = true);
 
     //! Close the underlying file descriptor
@@ -98,6 +106,10 @@ class FileDescriptor {
     unsigned int write_count() const { return _internal_fd->_write_count; }
     //!@}
 
+    //! \brief Number of times any FileDescriptor (in any thread) has reached EOF or been closed
+    //! \details Lets EventLoop look for rules whose fd has done so only when there can be some.
+    static uint64_t finished_count();
+
     //! \name Copy/move constructor/assignment operators
     //! FileDescriptor can be moved, but cannot be copied (but see duplicate())
     //!@{
@@ -0,0 +1,34 @@
+#include "flow_cache.hh"
+
+using namespace std;
+
+//! \param[in] capacity is the least number of entries to hold
+FlowCache::FlowCache(const size_t capacity) : _entries(), _set_bits(0) {
+    while ((size_t(1) << _set_bits) * WAYS < capacity) {
+        _set_bits++;
+    }
+    _entries.assign((size_t(1) << _set_bits) * WAYS, {0, 0, NO_VALUE});
+}
+
+//! \param[in] address is the address that was looked up
+//! \param[in] generation is the generation the lookup was made in
+//! \param[in] value is the result, if any
+//! \details Replaces the address's entry if it has one, else an empty or out-of-date entry in its set,
+//! else (with the set full) one of the set's entries in turn.
+void FlowCache::insert(const uint32_t address, const uint64_t generation, const optional<uint32_t> value) {
+    Entry *const set = set_of(address);
+    Entry *slot = nullptr;
+    for (size_t way = 0; way < WAYS; way++) {
+        if (set[way].address == address and set[way].generation != 0) {
+            slot = &set[way];
+            break;
+        }
+        if (not slot and set[way].generation != generation + 1) {
+            slot = &set[way];
+        }
+    }
+    if (not slot) {
+        slot = &set[_victim++ % WAYS];
+    }
+    *slot = {generation + 1, address, value.value_or(NO_VALUE)};
+}
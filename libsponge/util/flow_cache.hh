@@ -0,0 +1,81 @@
+#ifndef SPONGE_LIBSPONGE_FLOW_CACHE_HH
+#define SPONGE_LIBSPONGE_FLOW_CACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//! \brief A small exact-match cache of lookup results, keyed by destination address
+//! \details An open-addressing hash table: an address hashes to a set of WAYS adjacent slots (one cache
+//! line), and is stored in any of them, so a lookup reads a single cache line. When a set is full, an
+//! insertion replaces one of its entries.
+//!
+//! Each entry is stamped with the generation (e.g. the version of the routes) it was computed in, and
+//! only hits in that same generation: moving to a new generation invalidates every entry at once, without
+//! touching the table.
+//!
+//! Not thread-safe.
+class FlowCache {
+  public:
+    static constexpr size_t WAYS = 4;  //!< Slots an address may be stored in
+
+  private:
+    //! One slot: 16 bytes, so a set of WAYS slots fills a 64-byte cache line
+    struct Entry {
+        uint64_t generation;  //!< The generation of the result plus one (so zero marks an empty slot)
+        uint32_t address;     //!< The address looked up
+        uint32_t value;       //!< The result, or NO_VALUE if there was none
+    };
+
+    static constexpr uint32_t NO_VALUE = UINT32_MAX;  //!< Stored for a lookup that found nothing
+
+    std::vector<Entry> _entries;  //!< The slots, set after set
+    uint32_t _set_bits;           //!< log2 of the number of sets
+    size_t _hits = 0;             //!< Lookups that found an entry
+    size_t _misses = 0;           //!< Lookups that did not
+    size_t _victim = 0;           //!< Counter choosing which entry of a full set to replace
+
+    //! The first slot of the set for `address`
+    Entry *set_of(const uint32_t address) {
+        // Fibonacci hashing: the high bits of the product depend on all the bits of the address
+        return &_entries[_set_bits == 0 ? 0 : (uint32_t(address * 0x9e3779b1u) >> (32 - _set_bits)) * WAYS];
+    }
+
+  public:
+    //! A cache of at least `capacity` entries (rounded up to a power of two, and at least WAYS)
+    explicit FlowCache(const size_t capacity);
+
+    //! \brief Look up `address`, as cached in `generation`
+    //! \returns `true` on a hit, setting `value` to the cached result (which may be empty)
+    bool lookup(const uint32_t address, const uint64_t generation, std::optional<uint32_t> &value) {
+        const Entry *const set = set_of(address);
+        for (size_t way = 0; way < WAYS; way++) {
+            if (set[way].address == address and set[way].generation == generation + 1) {
+                value = set[way].value == NO_VALUE ? std::optional<uint32_t>{} : set[way].value;
+                _hits++;
+                return true;
+            }
+        }
+        _misses++;
+        return false;
+    }
+
+    //! Cache the result of looking up `address` in `generation`
+    void insert(const uint32_t address, const uint64_t generation, const std::optional<uint32_t> value);
+
+    //! Hint that `address` will be looked up soon
+    void prefetch(const uint32_t address) { __builtin_prefetch(set_of(address)); }
+
+    //! Number of entries the cache can hold
+    size_t capacity() const { return _entries.size(); }
+
+    //! \name Lookups that hit and missed, since construction or reset_stats()
+    //!@{
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+    void reset_stats() { _hits = _misses = 0; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_FLOW_CACHE_HH
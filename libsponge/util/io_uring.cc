@@ -0,0 +1,376 @@
+#include "io_uring.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+int io_uring_setup(const unsigned entries, io_uring_params &params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags,
+                   const void *arg, const size_t argsz) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+int io_uring_register(const int fd, const unsigned opcode, const void *arg, const unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+//! \name Ring indices are shared with the kernel, so they are read with acquire and written with release semantics
+//!@{
+template <typename T>
+T load_acquire(const T *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void store_release(T *ptr, const T value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+//!@}
+
+io_uring_params params_for(const unsigned completions) {
+    io_uring_params params{};
+    if (completions) {
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = completions;
+    }
+    return params;
+}
+
+}  // namespace
+
+IOUring::Mapping::Mapping(const int fd, const off_t offset, const size_t length)
+    : _addr(::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset)), _length(length) {
+    if (reinterpret_cast<intptr_t>(_addr) == -1) {
+        throw unix_error("mmap");
+    }
+}
+
+IOUring::Mapping::~Mapping() { ::munmap(_addr, _length); }
+
+//! \param[in] entries is the size of the submission queue
+//! \param[in] completions is the size of the completion queue (the kernel's default is twice `entries`)
+IOUring::IOUring(const unsigned entries, const unsigned completions) : IOUring(entries, params_for(completions)) {}
+
+IOUring::IOUring(const unsigned entries, io_uring_params params)
+    : _fd(SystemCall("io_uring_setup", io_uring_setup(entries, params)))
+    , _params(params)
+    , _sq_ring(_fd.fd_num(), IORING_OFF_SQ_RING, _params.sq_off.array + _params.sq_entries * sizeof(unsigned))
+    , _cq_ring(_fd.fd_num(), IORING_OFF_CQ_RING, _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe))
+    , _sqes(_fd.fd_num(), IORING_OFF_SQES, _params.sq_entries * sizeof(io_uring_sqe))
+    , _sq_head(_sq_ring.at<unsigned>(_params.sq_off.head))
+    , _sq_tail(_sq_ring.at<unsigned>(_params.sq_off.tail))
+    , _sq_mask(*_sq_ring.at<unsigned>(_params.sq_off.ring_mask))
+    , _sq_array(_sq_ring.at<unsigned>(_params.sq_off.array))
+    , _sq_local_tail(*_sq_tail)
+    , _cq_head(_cq_ring.at<unsigned>(_params.cq_off.head))
+    , _cq_tail(_cq_ring.at<unsigned>(_params.cq_off.tail))
+    , _cq_mask(*_cq_ring.at<unsigned>(_params.cq_off.ring_mask))
+    , _cqes(_cq_ring.at<io_uring_cqe>(_params.cq_off.cqes)) {
+    // submit() relies on timed waits, and completions must not be dropped when the queue is full
+    const unsigned required = IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((_params.features & required) != required) {
+        throw runtime_error("IOUring: kernel's io_uring is too old");
+    }
+}
+
+bool IOUring::available() {
+    static const bool result = [] {
+        try {
+            IOUring ring{1};
+            return true;
+        } catch (const exception &) {
+            return false;
+        }
+    }();
+    return result;
+}
+
+//! \param[in] opcode is the operation (e.g., IORING_OP_POLL_ADD)
+//! \param[in] fd is the file descriptor it operates on
+//! \param[in] user_data is returned in the operation's completion
+//! \returns a reference to the entry, for setting any other fields
+io_uring_sqe &IOUring::prepare(const uint8_t opcode, const int fd, const uint64_t user_data) {
+    if (_sq_local_tail - load_acquire(_sq_head) == _params.sq_entries) {
+        submit();
+    }
+
+    const unsigned index = _sq_local_tail & _sq_mask;
+    io_uring_sqe &sqe = _sqes.at<io_uring_sqe>(0)[index];
+    sqe = {};
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = user_data;
+    _sq_array[index] = index;
+    ++_sq_local_tail;
+    return sqe;
+}
+
+//! \param[in] wait_for is the number of completions to wait for (in addition to submitting)
+//! \param[in] timeout_ms is the longest time to wait, or -1 to wait indefinitely
+//! \note Returns without an error if the timeout expires; a caught signal throws a unix_error with EINTR.
+void IOUring::submit(const unsigned wait_for, const int timeout_ms) {
+    store_release(_sq_tail, _sq_local_tail);
+    const unsigned to_submit = _sq_local_tail - load_acquire(_sq_head);
+    if (to_submit == 0 and wait_for == 0) {
+        return;
+    }
+
+    unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec timeout{};
+    io_uring_getevents_arg arg{};
+    const void *argp = nullptr;
+    size_t argsz = 0;
+    if (wait_for and timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uintptr_t>(&timeout);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    ++_syscalls;
+    SystemCall("io_uring_enter", io_uring_enter(_fd.fd_num(), to_submit, wait_for, flags, argp, argsz), ETIME);
+}
+
+std::optional<IOUring::Completion> IOUring::pop_completion() {
+    const unsigned head = *_cq_head;
+    if (head == load_acquire(_cq_tail)) {
+        return {};
+    }
+    const io_uring_cqe &cqe = _cqes[head & _cq_mask];
+    const Completion ret{cqe.user_data, cqe.res, cqe.flags};
+    store_release(_cq_head, head + 1);
+    return ret;
+}
+
+bool IOUring::completion_ready() const { return *_cq_head != load_acquire(_cq_tail); }
+
+//! \param[in] opcode is the registration (e.g., IORING_REGISTER_BUFFERS)
+//! \param[in] arg describes what is registered
+//! \param[in] nr_args is the number of elements in `arg`
+void IOUring::register_resource(const unsigned opcode, const void *arg, const unsigned nr_args) {
+    SystemCall("io_uring_register", io_uring_register(_fd.fd_num(), opcode, arg, nr_args));
+}
+
+namespace {
+
+//! The per-thread state behind IOUringWriteBatch
+class WriteBatcher {
+  public:
+    static constexpr size_t ARENA_SIZE = 1024 * 1024;  //!< Bytes of registered buffer space
+    static constexpr unsigned QUEUE_DEPTH = 256;       //!< Writes per submission
+
+  private:
+    //! A queued write, and everything the kernel needs to perform it
+    struct PendingWrite {
+        int fd;
+        const char *data;
+        size_t length;
+        bool has_destination;
+        Address::Raw destination;
+        socklen_t destination_length;
+        iovec iov;
+        msghdr message;
+    };
+
+    IOUring _ring{QUEUE_DEPTH};
+    std::vector<char> _arena;
+    size_t _arena_used = 0;
+    std::vector<PendingWrite> _pending{};
+
+    //! Finish a write the kernel did not complete (or started and cut short) with ordinary system calls
+    static void complete_directly(const PendingWrite &write, const size_t already_written);
+
+  public:
+    bool active = false;  //!< Whether an IOUringWriteBatch is currently collecting writes
+
+    WriteBatcher() : _arena(ARENA_SIZE) {
+        _pending.reserve(QUEUE_DEPTH);
+        const iovec arena{_arena.data(), _arena.size()};
+        _ring.register_resource(IORING_REGISTER_BUFFERS, &arena, 1);
+    }
+
+    bool queue(const FileDescriptor &fd, const BufferViewList &buffer, const Address *destination);
+    void flush();
+    size_t syscall_count() const { return _ring.syscall_count(); }
+};
+
+thread_local std::optional<WriteBatcher> batcher{};
+
+bool WriteBatcher::queue(const FileDescriptor &fd, const BufferViewList &buffer, const Address *destination) {
+    const size_t length = buffer.size();
+    if (length > ARENA_SIZE) {
+        flush();  // too big to batch: preserve ordering, then let the caller write it directly
+        return false;
+    }
+    if (_arena_used + length > ARENA_SIZE or _pending.size() == QUEUE_DEPTH) {
+        flush();
+    }
+
+    char *data = _arena.data() + _arena_used;
+    size_t copied = 0;
+    for (const auto &iov : buffer.as_iovecs()) {
+        memcpy(data + copied, iov.iov_base, iov.iov_len);
+        copied += iov.iov_len;
+    }
+    _arena_used += length;
+
+    PendingWrite write{fd.fd_num(), data, length, destination != nullptr, {}, 0, {}, {}};
+    if (destination) {
+        memcpy(static_cast<sockaddr *>(write.destination),
+               static_cast<const sockaddr *>(*destination),
+               destination->size());
+        write.destination_length = destination->size();
+    }
+    _pending.push_back(write);
+    return true;
+}
+
+//! \details The writes are linked, so the kernel performs them in order. If one fails, the rest are
+//! canceled; those (and any short write) are finished here with ordinary system calls, in order, so the
+//! outcome matches what writing each one directly would have produced.
+void WriteBatcher::flush() {
+    if (_pending.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < _pending.size(); i++) {
+        PendingWrite &write = _pending[i];
+        io_uring_sqe *sqe = nullptr;
+        if (write.has_destination) {
+            write.iov = {const_cast<char *>(write.data), write.length};
+            write.message = {};
+            write.message.msg_name = static_cast<sockaddr *>(write.destination);
+            write.message.msg_namelen = write.destination_length;
+            write.message.msg_iov = &write.iov;
+            write.message.msg_iovlen = 1;
+            sqe = &_ring.prepare(IORING_OP_SENDMSG, write.fd, i);
+            sqe->addr = reinterpret_cast<uintptr_t>(&write.message);
+            sqe->len = 1;
+        } else {
+            sqe = &_ring.prepare(IORING_OP_WRITE_FIXED, write.fd, i);
+            sqe->addr = reinterpret_cast<uintptr_t>(write.data);
+            sqe->len = write.length;
+            sqe->off = uint64_t(-1);
+            sqe->buf_index = 0;
+        }
+        if (i + 1 < _pending.size()) {
+            sqe->flags = IOSQE_IO_LINK;
+        }
+    }
+
+    vector<int> results(_pending.size(), -ECANCELED);
+    auto pending = move(_pending);
+    _pending.clear();
+    _pending.reserve(QUEUE_DEPTH);
+    _arena_used = 0;
+
+    size_t outstanding = pending.size();
+    while (outstanding) {
+        _ring.submit(outstanding);
+        while (const auto cqe = _ring.pop_completion()) {
+            results.at(cqe->user_data) = cqe->res;
+            --outstanding;
+        }
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        const int result = results[i];
+        if (result == -ECANCELED) {
+            complete_directly(pending[i], 0);
+        } else if (result < 0) {
+            throw unix_error(pending[i].has_destination ? "sendmsg" : "write", -result);
+        } else if (size_t(result) < pending[i].length) {
+            complete_directly(pending[i], result);
+        }
+    }
+}
+
+void WriteBatcher::complete_directly(const PendingWrite &write, const size_t already_written) {
+    if (write.has_destination) {
+        if (already_written) {
+            throw runtime_error("datagram payload too big for sendmsg()");
+        }
+        iovec iov{const_cast<char *>(write.data), write.length};
+        msghdr message{};
+        message.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(write.destination));
+        message.msg_namelen = write.destination_length;
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        if (size_t(SystemCall("sendmsg", ::sendmsg(write.fd, &message, 0))) != write.length) {
+            throw runtime_error("datagram payload too big for sendmsg()");
+        }
+        return;
+    }
+
+    for (size_t written = already_written; written < write.length;) {
+        written += SystemCall("write", ::write(write.fd, write.data + written, write.length - written));
+    }
+}
+
+}  // namespace
+
+IOUringWriteBatch::IOUringWriteBatch() : _active(false) {
+    if (not IOUring::available()) {
+        return;
+    }
+    try {
+        if (not batcher) {
+            batcher.emplace();
+        }
+    } catch (const exception &) {
+        return;  // e.g. not allowed to register buffers; write directly instead
+    }
+    if (not batcher->active) {  // an enclosing batch will flush these writes
+        batcher->active = _active = true;
+    }
+}
+
+void IOUringWriteBatch::flush() {
+    if (_active) {
+        batcher->flush();
+    }
+}
+
+IOUringWriteBatch::~IOUringWriteBatch() {
+    if (not _active) {
+        return;
+    }
+    try {
+        batcher->flush();
+    } catch (const exception &e) {
+        cerr << "Exception destructing IOUringWriteBatch: " << e.what() << endl;
+    }
+    batcher->active = false;
+}
+
+//! \param[in] fd is the FileDescriptor to write to
+//! \param[in] buffer is the data to write (copied before this returns)
+//! \param[in] destination is the address to send the datagram to, or `nullptr` to write to `fd`
+//! \returns `true` if the write was queued
+bool IOUringWriteBatch::queue(const FileDescriptor &fd, const BufferViewList &buffer, const Address *destination) {
+    if (not batcher or not batcher->active) {
+        return false;
+    }
+    return batcher->queue(fd, buffer, destination);
+}
+
+size_t IOUringWriteBatch::syscall_count() { return batcher ? batcher->syscall_count() : 0; }
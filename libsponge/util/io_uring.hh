@@ -0,0 +1,152 @@
+#ifndef SPONGE_LIBSPONGE_IO_URING_HH
+#define SPONGE_LIBSPONGE_IO_URING_HH
+
+#include "address.hh"
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <optional>
+#include <vector>
+
+//! \brief A minimal [io_uring(7)](\ref man7::io_uring) instance: a submission queue and a completion queue
+//! shared with the kernel, driven with raw system calls (no liburing dependency)
+class IOUring {
+    //! A region of the ring mapped into our address space with [mmap(2)](\ref man2::mmap)
+    class Mapping {
+        void *_addr;
+        size_t _length;
+
+      public:
+        Mapping(const int fd, const off_t offset, const size_t length);
+        ~Mapping();
+
+        //! \returns a pointer to the object at `offset` bytes into the mapping
+        template <typename T>
+        T *at(const size_t offset) const {
+            return reinterpret_cast<T *>(static_cast<char *>(_addr) + offset);
+        }
+
+        //! \name
+        //! A Mapping cannot be copied or moved
+
+        //!@{
+        Mapping(const Mapping &other) = delete;
+        Mapping &operator=(const Mapping &other) = delete;
+        Mapping(Mapping &&other) = delete;
+        Mapping &operator=(Mapping &&other) = delete;
+        //!@}
+    };
+
+    FileDescriptor _fd;
+    io_uring_params _params;
+    Mapping _sq_ring;
+    Mapping _cq_ring;
+    Mapping _sqes;
+
+    //! \name Submission queue (we own the tail, the kernel owns the head)
+    //!@{
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned _sq_mask;
+    unsigned *_sq_array;
+    unsigned _sq_local_tail;  //!< Tail including SQEs prepared but not yet published
+    //!@}
+
+    //! \name Completion queue (the kernel owns the tail, we own the head)
+    //!@{
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned _cq_mask;
+    io_uring_cqe *_cqes;
+    //!@}
+
+    size_t _syscalls = 0;  //!< Number of [io_uring_enter(2)](\ref man2::io_uring_enter) calls made
+
+    IOUring(const unsigned entries, io_uring_params params);
+
+  public:
+    //! The fields of a completion queue entry (io_uring_cqe ends in a flexible array, so it can't be copied)
+    struct Completion {
+        uint64_t user_data;  //!< The `user_data` of the submission
+        int32_t res;         //!< Result (negated errno on failure)
+        uint32_t flags;      //!< IORING_CQE_F_* flags
+    };
+
+    //! Set up a ring with room for `entries` submissions (and `completions` completions, if nonzero)
+    explicit IOUring(const unsigned entries, const unsigned completions = 0);
+
+    //! `true` if the running kernel lets this process create a ring (checked once)
+    static bool available();
+
+    //! \brief Get a zeroed submission queue entry, submitting earlier ones first if the queue is full
+    //! \note The entry is handed to the kernel by the next call to IOUring::submit.
+    io_uring_sqe &prepare(const uint8_t opcode, const int fd, const uint64_t user_data);
+
+    //! Submit prepared entries, then wait for at least `wait_for` completions (or until `timeout_ms` passes)
+    void submit(const unsigned wait_for = 0, const int timeout_ms = -1);
+
+    //! Remove the oldest completion from the completion queue, if there is one
+    std::optional<Completion> pop_completion();
+
+    //! `true` if the completion queue is not empty
+    bool completion_ready() const;
+
+    //! Wrapper around [io_uring_register(2)](\ref man2::io_uring_register)
+    void register_resource(const unsigned opcode, const void *arg, const unsigned nr_args);
+
+    //! Number of [io_uring_enter(2)](\ref man2::io_uring_enter) calls made so far
+    size_t syscall_count() const { return _syscalls; }
+
+    //! \name
+    //! An IOUring cannot be copied or moved (the kernel holds pointers into it)
+
+    //!@{
+    IOUring(const IOUring &other) = delete;
+    IOUring &operator=(const IOUring &other) = delete;
+    IOUring(IOUring &&other) = delete;
+    IOUring &operator=(IOUring &&other) = delete;
+    //!@}
+
+    ~IOUring() = default;
+};
+
+//! \brief While an IOUringWriteBatch is active, FileDescriptor writes (with `write_all`) and UDPSocket sends
+//! made on the same thread are copied into registered buffers and queued, then submitted together by
+//! IOUringWriteBatch::flush with one system call
+class IOUringWriteBatch {
+    bool _active;
+
+  public:
+    //! Begin batching, if io_uring is available (otherwise writes proceed as usual)
+    IOUringWriteBatch();
+
+    //! Submit the queued writes and wait for them to complete
+    void flush();
+
+    //! Stop batching (any writes still queued are submitted; errors are ignored)
+    ~IOUringWriteBatch();
+
+    //! \brief Queue a write (and, if `destination` is given, send it as a datagram to that address)
+    //! \returns `false` if no batch is active on this thread, in which case the caller should write directly
+    static bool queue(const FileDescriptor &fd, const BufferViewList &buffer, const Address *destination = nullptr);
+
+    //! Number of system calls made by this thread's batches so far
+    static size_t syscall_count();
+
+    //! \name
+    //! An IOUringWriteBatch cannot be copied or moved
+
+    //!@{
+    IOUringWriteBatch(const IOUringWriteBatch &other) = delete;
+    IOUringWriteBatch &operator=(const IOUringWriteBatch &other) = delete;
+    //!@}
+};
+
+//! \class IOUring
+//! An IOUring is used by EventLoop (with EventLoop::Backend::IOUring) and by IOUringWriteBatch. Each amortizes many operations over one [io_uring_enter(2)](\ref man2::io_uring_enter)
+//! call. Callers should check IOUring::available() and fall back to ordinary system calls if it is `false`.
+
+#endif  // SPONGE_LIBSPONGE_IO_URING_HH
@@ -0,0 +1,259 @@
+#include "lpm_trie.hh"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+using namespace std;
+
+//! The bit of `address` at `position` (0 is the most significant), which must be less than 32
+static size_t bit_at(const uint32_t address, const uint8_t position) { return (address >> (31 - position)) & 1; }
+
+//! Number of leading bits that `a` and `b` have in common
+static uint8_t common_length(const uint32_t a, const uint32_t b) { return a == b ? 32 : __builtin_clz(a ^ b); }
+
+uint32_t LPMTrie::make_node(const uint32_t prefix, const uint8_t length, const uint32_t value) {
+    const Node node{prefix, value, {NIL, NIL}, length};
+    if (not _free.empty()) {
+        const uint32_t index = _free.back();
+        _free.pop_back();
+        _nodes[index] = node;
+        return index;
+    }
+    _nodes.push_back(node);
+    return _nodes.size() - 1;
+}
+
+//! \param[in] prefix is the prefix (bits past `length` are ignored)
+//! \param[in] length is the number of significant bits in `prefix` (0 to 32)
+//! \param[in] value is the value to store (anything but NO_VALUE)
+bool LPMTrie::insert(uint32_t prefix, const uint8_t length, const uint32_t value) {
+    if (length > 32 or value == NO_VALUE) {
+        throw invalid_argument("LPMTrie::insert: bad prefix length or value");
+    }
+    prefix &= mask(length);
+
+    // the link being followed, as its owner (NIL for the root) and which child it is
+    uint32_t parent = NIL;
+    size_t side = 0;
+    const auto link = [&]() -> uint32_t & { return parent == NIL ? _root : _nodes[parent].child[side]; };
+
+    while (true) {
+        const uint32_t current = link();
+        if (current == NIL) {
+            const uint32_t leaf = make_node(prefix, length, value);
+            link() = leaf;
+            _size++;
+            return true;
+        }
+
+        const Node node = _nodes[current];  // a copy: make_node() may move the nodes
+        const uint8_t common = min({length, node.length, common_length(prefix, node.prefix)});
+        if (common == node.length) {
+            if (common == length) {
+                const bool added = node.value == NO_VALUE;
+                _nodes[current].value = value;
+                _size += added;
+                return added;
+            }
+            parent = current;
+            side = bit_at(prefix, node.length);
+            continue;
+        }
+
+        // the new prefix doesn't extend the node's: put a new node above the node (a branch point, unless the
+        // node's prefix extends the new one)
+        uint32_t above;
+        if (common == length) {
+            above = make_node(prefix, length, value);
+        } else {
+            above = make_node(prefix & mask(common), common, NO_VALUE);
+            const uint32_t leaf = make_node(prefix, length, value);
+            _nodes[above].child[bit_at(prefix, common)] = leaf;
+        }
+        _nodes[above].child[bit_at(node.prefix, common)] = current;
+        link() = above;
+        _size++;
+        return true;
+    }
+}
+
+//! \param[in] prefix is the prefix (bits past `length` are ignored)
+//! \param[in] length is the number of significant bits in `prefix`
+//! \details Nodes that are no longer needed (without a value and with fewer than two children) are freed,
+//! so the trie stays as small as if the prefix had never been inserted.
+bool LPMTrie::erase(uint32_t prefix, const uint8_t length) {
+    if (length > 32) {
+        return false;
+    }
+    prefix &= mask(length);
+
+    // the links to the node and to its parent
+    uint32_t grandparent = NIL, parent = NIL;
+    size_t grandparent_side = 0, side = 0;
+    uint32_t current = _root;
+    while (current != NIL) {
+        const Node &node = _nodes[current];
+        if (node.length > length or (prefix & mask(node.length)) != node.prefix) {
+            return false;
+        }
+        if (node.length == length) {
+            break;
+        }
+        grandparent = parent;
+        grandparent_side = side;
+        parent = current;
+        side = bit_at(prefix, node.length);
+        current = node.child[side];
+    }
+    if (current == NIL or _nodes[current].value == NO_VALUE) {
+        return false;
+    }
+
+    _size--;
+    Node &node = _nodes[current];
+    node.value = NO_VALUE;
+    if (node.child[0] != NIL and node.child[1] != NIL) {
+        return true;  // still a branch point
+    }
+
+    const auto link = [&](const uint32_t owner, const size_t which) -> uint32_t & {
+        return owner == NIL ? _root : _nodes[owner].child[which];
+    };
+    const bool leaf = node.child[0] == NIL and node.child[1] == NIL;
+    link(parent, side) = node.child[0] != NIL ? node.child[0] : node.child[1];
+    _free.push_back(current);
+
+    // removing a leaf leaves its parent with one child: if the parent was only a branch point, it goes too
+    if (leaf and parent != NIL and _nodes[parent].value == NO_VALUE) {
+        link(grandparent, grandparent_side) = _nodes[parent].child[1 - side];
+        _free.push_back(parent);
+    }
+    return true;
+}
+
+//! \param[in] address is the address to look up
+//! \param[in] max_length is the longest prefix to consider
+optional<uint32_t> LPMTrie::lookup(const uint32_t address, const uint8_t max_length) const {
+    optional<uint32_t> best{};
+    uint32_t current = _root;
+    while (current != NIL) {
+        const Node &node = _nodes[current];
+        if (node.length > max_length or (address & mask(node.length)) != node.prefix) {
+            break;
+        }
+        if (node.value != NO_VALUE) {
+            best = node.value;
+        }
+        if (node.length == 32) {
+            break;
+        }
+        current = node.child[bit_at(address, node.length)];
+    }
+    return best;
+}
+
+//! \param[in] addresses are the addresses to look up
+//! \param[out] values receives the value of the longest prefix matching each address, if any
+//! \param[in] count is the number of addresses
+//! \details Walks the trie for up to LOOKUP_BATCH addresses together, one level per round, prefetching
+//! the node each walk visits next so that the cache misses of different walks overlap.
+void LPMTrie::lookup_batch(const uint32_t *addresses, optional<uint32_t> *values, const size_t count) const {
+    array<uint32_t, LOOKUP_BATCH> current{};  // node each walk is at
+    array<size_t, LOOKUP_BATCH> active{};     // the walks still going
+    for (size_t first = 0; first < count; first += LOOKUP_BATCH) {
+        const size_t batch = min(LOOKUP_BATCH, count - first);
+        size_t num_active = 0;
+        for (size_t i = first; i < first + batch; i++) {
+            values[i].reset();
+            current[i - first] = _root;
+            if (_root != NIL) {
+                active[num_active++] = i - first;
+            }
+        }
+
+        while (num_active > 0) {
+            size_t still_active = 0;
+            for (size_t k = 0; k < num_active; k++) {
+                const size_t i = active[k];
+                const uint32_t address = addresses[first + i];
+                const Node &node = _nodes[current[i]];
+                if ((address & mask(node.length)) != node.prefix) {
+                    continue;
+                }
+                if (node.value != NO_VALUE) {
+                    values[first + i] = node.value;
+                }
+                if (node.length == 32) {
+                    continue;
+                }
+                current[i] = node.child[bit_at(address, node.length)];
+                if (current[i] != NIL) {
+                    __builtin_prefetch(&_nodes[current[i]]);
+                    active[still_active++] = i;
+                }
+            }
+            num_active = still_active;
+        }
+    }
+}
+
+//! \param[in] prefix is the prefix (bits past `length` are ignored)
+//! \param[in] length is the number of significant bits in `prefix`
+optional<uint32_t> LPMTrie::find(uint32_t prefix, const uint8_t length) const {
+    if (length > 32) {
+        return {};
+    }
+    prefix &= mask(length);
+    uint32_t current = _root;
+    while (current != NIL) {
+        const Node &node = _nodes[current];
+        if (node.length > length or (prefix & mask(node.length)) != node.prefix) {
+            break;
+        }
+        if (node.length == length) {
+            if (node.value != NO_VALUE) {
+                return node.value;
+            }
+            break;
+        }
+        current = node.child[bit_at(prefix, node.length)];
+    }
+    return {};
+}
+
+//! \param[in] prefix is the prefix (bits past `length` are ignored)
+//! \param[in] length is the number of significant bits in `prefix`
+//! \param[in] visit is called for each prefix found, shortest first along each path
+void LPMTrie::for_each(uint32_t prefix,
+                       const uint8_t length,
+                       const function<void(uint32_t, uint8_t, uint32_t)> &visit) const {
+    prefix &= mask(length);
+
+    // find the top of the subtrie holding the prefixes that start with this one
+    uint32_t current = _root;
+    while (current != NIL and _nodes[current].length < length) {
+        const Node &node = _nodes[current];
+        if ((prefix & mask(node.length)) != node.prefix) {
+            return;
+        }
+        current = node.child[bit_at(prefix, node.length)];
+    }
+    if (current == NIL or (_nodes[current].prefix & mask(length)) != prefix) {
+        return;
+    }
+
+    vector<uint32_t> pending{current};
+    while (not pending.empty()) {
+        const Node &node = _nodes[pending.back()];
+        pending.pop_back();
+        if (node.value != NO_VALUE) {
+            visit(node.prefix, node.length, node.value);
+        }
+        for (const uint32_t child : node.child) {
+            if (child != NIL) {
+                pending.push_back(child);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SPONGE_LIBSPONGE_LPM_TRIE_HH
+#define SPONGE_LIBSPONGE_LPM_TRIE_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+//! \brief A path-compressed binary (Patricia) trie of IPv4 prefixes, for longest-prefix-match lookups
+//! \details Each prefix maps to a `uint32_t` value (e.g. the index of a next hop). A node stands either
+//! for a prefix that was inserted or for a branch point where two prefixes diverge, so a trie of `n`
+//! prefixes has fewer than `2n` nodes, and a lookup visits at most one node per distinct prefix length
+//! on the path to the address (at most 33).
+class LPMTrie {
+  public:
+    static constexpr uint32_t NO_VALUE = UINT32_MAX;  //!< Not a valid value (marks a branch-only node)
+
+  private:
+    static constexpr uint32_t NIL = 0;          //!< Index meaning "no node" (node 0 is never used)
+    static constexpr size_t LOOKUP_BATCH = 32;  //!< Most lookups lookup_batch() interleaves at once
+
+    //! One node: 20 bytes, with children referred to by index into LPMTrie::_nodes
+    struct Node {
+        uint32_t prefix;                //!< The prefix, with the bits past `length` zero
+        uint32_t value;                 //!< The value of the prefix, or NO_VALUE for a branch point
+        std::array<uint32_t, 2> child;  //!< Subtries whose next bit (at position `length`) is 0 or 1
+        uint8_t length;                 //!< Number of significant bits in `prefix`
+    };
+
+    std::vector<Node> _nodes = std::vector<Node>(1);  //!< All nodes (and freed ones, in the free list)
+    std::vector<uint32_t> _free{};                    //!< Indices of freed nodes
+    uint32_t _root = NIL;                             //!< The root node
+    size_t _size = 0;                                 //!< Number of prefixes
+
+    //! Allocate a node
+    uint32_t make_node(const uint32_t prefix, const uint8_t length, const uint32_t value);
+
+  public:
+    //! \brief Insert a prefix, or replace its value
+    //! \returns `true` if the prefix was not already present
+    bool insert(const uint32_t prefix, const uint8_t length, const uint32_t value);
+
+    //! \brief Remove a prefix
+    //! \returns `true` if the prefix was present
+    bool erase(const uint32_t prefix, const uint8_t length);
+
+    //! The value of the longest prefix, no longer than `max_length`, matching `address`, if any
+    std::optional<uint32_t> lookup(const uint32_t address, const uint8_t max_length = 32) const;
+
+    //! \brief Look up `count` addresses at once, storing the result for `addresses[i]` in `values[i]`
+    //! \details Faster than separate lookups when the trie does not fit in the cache.
+    void lookup_batch(const uint32_t *addresses, std::optional<uint32_t> *values, const size_t count) const;
+
+    //! Call `visit(prefix, length, value)` for each prefix that starts with `prefix`/`length` (including itself)
+    void for_each(const uint32_t prefix,
+                  const uint8_t length,
+                  const std::function<void(uint32_t, uint8_t, uint32_t)> &visit) const;
+
+    //! The value of exactly this prefix, if it is present
+    std::optional<uint32_t> find(const uint32_t prefix, const uint8_t length) const;
+
+    //! Number of prefixes
+    size_t size() const { return _size; }
+
+    //! Bytes of memory held by the trie
+    size_t memory_usage() const { return _nodes.capacity() * sizeof(Node) + _free.capacity() * sizeof(uint32_t); }
+
+    //! The mask selecting the first `length` bits of an address
+    static constexpr uint32_t mask(const uint8_t length) { return length == 0 ? 0 : UINT32_MAX << (32 - length); }
+};
+
+#endif  // SPONGE_LIBSPONGE_LPM_TRIE_HH
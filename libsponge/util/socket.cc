@@ -1,8 +1,12 @@
 #include "socket.hh"
 
+#include "io_uring.hh"
 #include "util.hh"
 
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <unistd.h>
 
@@ -112,6 +116,103 @@ UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
     return ret;
 }
 
+//! \note If `mtu` is too small to hold the received datagram, this method throws a std::runtime_error
+UDPSocket::received_buffer UDPSocket::recv_buffer(const size_t mtu) {
+    Address::Raw datagram_source_address;
+    socklen_t fromlen = sizeof(datagram_source_address);
+
+    Buffer payload = Buffer::read_from(mtu, [&](const iovec *iov, const int iovcnt) {
+        msghdr message{};
+        message.msg_name = static_cast<sockaddr *>(datagram_source_address);
+        message.msg_namelen = fromlen;
+        message.msg_iov = const_cast<iovec *>(iov);
+        message.msg_iovlen = iovcnt;
+
+        const ssize_t recv_len = SystemCall("recvmsg", ::recvmsg(fd_num(), &message, MSG_TRUNC));
+        if (recv_len > ssize_t(mtu)) {
+            throw runtime_error("recvmsg (oversized datagram)");
+        }
+        fromlen = message.msg_namelen;
+        return size_t(recv_len);
+    });
+
+    register_read();
+    return {{datagram_source_address, fromlen}, std::move(payload)};
+}
+
+//! Room for one control message carrying an `int` (the `UDP_SEGMENT` or `UDP_GRO` segment size)
+struct ControlBuffer {
+    alignas(cmsghdr) array<char, CMSG_SPACE(sizeof(int))> data;
+};
+
+//! \returns the segment size of a datagram coalesced by GRO, from its control data (or 0 if it wasn't)
+static size_t gro_segment_size(msghdr &message) {
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO) {
+            int segment_size;
+            memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+            return segment_size;
+        }
+    }
+    return 0;
+}
+
+//! \note If `mtu` is too small to hold any of the received datagrams, this method throws a std::runtime_error
+//! \details Uses [recvmmsg(2)](\ref man2::recvmmsg) with `MSG_WAITFORONE`: blocks (if the socket is blocking)
+//! until one datagram arrives, then takes whatever else is already queued, up to `max_datagrams` in all.
+vector<UDPSocket::received_buffer> UDPSocket::recv_batch(const size_t max_datagrams, const size_t mtu) {
+    thread_local vector<mmsghdr> messages{};
+    thread_local vector<Address::Raw> source_addresses{};
+    thread_local vector<ControlBuffer> controls{};
+    messages.assign(max_datagrams, {});
+    source_addresses.resize(max_datagrams);
+    controls.resize(_gro ? max_datagrams : 0);
+
+    const auto receive = [&](const iovec *iov, const size_t count, size_t *lengths) {
+        for (size_t i = 0; i < count; i++) {
+            msghdr &message = messages[i].msg_hdr;
+            message.msg_name = static_cast<sockaddr *>(source_addresses[i]);
+            message.msg_namelen = sizeof(Address::Raw);
+            message.msg_iov = const_cast<iovec *>(iov + 2 * i);
+            message.msg_iovlen = 2;
+            if (_gro) {
+                message.msg_control = controls[i].data.data();
+                message.msg_controllen = controls[i].data.size();
+            }
+        }
+
+        const int received = SystemCall(
+            "recvmmsg", ::recvmmsg(fd_num(), messages.data(), count, MSG_TRUNC | MSG_WAITFORONE, nullptr));
+        for (int i = 0; i < received; i++) {
+            if (messages[i].msg_len > mtu) {
+                throw runtime_error("recvmmsg (oversized datagram)");
+            }
+            lengths[i] = messages[i].msg_len;
+        }
+        return size_t(received);
+    };
+    auto payloads = Buffer::read_batch_from(max_datagrams, mtu, receive);
+
+    register_read();
+    vector<received_buffer> ret;
+    ret.reserve(payloads.size());
+    for (size_t i = 0; i < payloads.size(); i++) {
+        const Address source{source_addresses[i], messages[i].msg_hdr.msg_namelen};
+        const size_t segment_size = _gro ? gro_segment_size(messages[i].msg_hdr) : 0;
+        if (segment_size == 0 or payloads[i].size() <= segment_size) {
+            ret.push_back({source, std::move(payloads[i])});
+            continue;
+        }
+
+        // split a coalesced datagram back into the datagrams that were sent (all but the last are full-size)
+        const string_view coalesced = payloads[i];
+        for (size_t offset = 0; offset < coalesced.size(); offset += segment_size) {
+            ret.push_back({source, Buffer::copy_of(coalesced.substr(offset, segment_size))});
+        }
+    }
+    return ret;
+}
+
 void sendmsg_helper(const int fd_num,
                     const sockaddr *destination_address,
                     const socklen_t destination_address_len,
@@ -132,15 +233,149 @@ void sendmsg_helper(const int fd_num,
 }
 
 void UDPSocket::sendto(const Address &destination, const BufferViewList &payload) {
-    sendmsg_helper(fd_num(), destination, destination.size(), payload);
+    if (not IOUringWriteBatch::queue(*this, payload, &destination)) {
+        sendmsg_helper(fd_num(), destination, destination.size(), payload);
+    }
     register_write();
 }
 
 void UDPSocket::send(const BufferViewList &payload) {
-    sendmsg_helper(fd_num(), nullptr, 0, payload);
+    if (not IOUringWriteBatch::queue(*this, payload)) {
+        sendmsg_helper(fd_num(), nullptr, 0, payload);
+    }
+    register_write();
+}
+
+//! Most datagrams one `UDP_SEGMENT` send may carry (the kernel's `UDP_MAX_SEGMENTS`)
+static constexpr size_t MAX_GSO_SEGMENTS = 64;
+
+//! Most bytes one `UDP_SEGMENT` send may carry (the largest UDP payload over IPv4)
+static constexpr size_t MAX_GSO_BYTES = 65507;
+
+void sendmmsg_helper(const int fd_num,
+                     const Address *destination,
+                     const vector<BufferViewList> &payloads,
+                     const bool gso) {
+    //! One message: a datagram, or a run of datagrams to be segmented by the kernel
+    struct Run {
+        size_t first_iovec;   //!< Index of the first iovec of the run's payloads
+        size_t bytes;         //!< Total size of the run's payloads
+        size_t segment_size;  //!< Size of each datagram in the run (0 if the run is one datagram)
+    };
+
+    thread_local vector<iovec> iovecs{};
+    thread_local vector<Run> runs{};
+    thread_local vector<ControlBuffer> controls{};
+    thread_local vector<mmsghdr> messages{};
+    iovecs.clear();
+    runs.clear();
+
+    // with GSO, coalesce each run of datagrams that are all the same size (except the last, which may be smaller)
+    for (size_t i = 0; i < payloads.size();) {
+        const size_t segment_size = payloads[i].size();
+        Run run{iovecs.size(), 0, 0};
+        size_t end = i;
+        do {
+            const auto views = payloads[end].as_iovecs();
+            iovecs.insert(iovecs.end(), views.begin(), views.end());
+            run.bytes += payloads[end].size();
+            end++;
+        } while (gso and end < payloads.size() and end - i < MAX_GSO_SEGMENTS and segment_size > 0 and
+                 payloads[end - 1].size() == segment_size and payloads[end].size() > 0 and
+                 payloads[end].size() <= segment_size and run.bytes + payloads[end].size() <= MAX_GSO_BYTES);
+        run.segment_size = end - i > 1 ? segment_size : 0;
+        runs.push_back(run);
+        i = end;
+    }
+
+    messages.assign(runs.size(), {});
+    controls.resize(runs.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+        msghdr &message = messages[i].msg_hdr;
+        if (destination) {
+            message.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(*destination));
+            message.msg_namelen = destination->size();
+        }
+        message.msg_iov = &iovecs[runs[i].first_iovec];
+        message.msg_iovlen = (i + 1 < runs.size() ? runs[i + 1].first_iovec : iovecs.size()) - runs[i].first_iovec;
+
+        if (runs[i].segment_size) {
+            message.msg_control = controls[i].data.data();
+            message.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const uint16_t segment_size = runs[i].segment_size;
+            memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+    }
+
+    // sendmmsg(2) may stop short of the whole batch; carry on from where it left off
+    size_t sent = 0;
+    while (sent < runs.size()) {
+        const int count = SystemCall("sendmmsg", ::sendmmsg(fd_num, &messages[sent], runs.size() - sent, 0));
+        for (size_t i = sent; i < sent + count; i++) {
+            if (messages[i].msg_len != runs[i].bytes) {
+                throw runtime_error("datagram payload too big for sendmmsg()");
+            }
+        }
+        sent += count;
+    }
+}
+
+//! \details Uses [sendmmsg(2)](\ref man2::sendmmsg), or queues the datagrams if an IOUringWriteBatch is active.
+void UDPSocket::send_batch(const Address &destination, const vector<BufferViewList> &payloads) {
+    if (payloads.empty()) {
+        return;
+    }
+    if (IOUringWriteBatch::queue(*this, payloads.front(), &destination)) {
+        for (size_t i = 1; i < payloads.size(); i++) {
+            if (not IOUringWriteBatch::queue(*this, payloads[i], &destination)) {
+                sendmsg_helper(fd_num(), destination, destination.size(), payloads[i]);  // e.g. too big to batch
+            }
+        }
+    } else {
+        sendmmsg_helper(fd_num(), &destination, payloads, _gso);
+    }
+    register_write();
+}
+
+//! \details Uses [sendmmsg(2)](\ref man2::sendmmsg), or queues the datagrams if an IOUringWriteBatch is active.
+void UDPSocket::send_batch(const vector<BufferViewList> &payloads) {
+    if (payloads.empty()) {
+        return;
+    }
+    if (IOUringWriteBatch::queue(*this, payloads.front())) {
+        for (size_t i = 1; i < payloads.size(); i++) {
+            if (not IOUringWriteBatch::queue(*this, payloads[i])) {
+                sendmsg_helper(fd_num(), nullptr, 0, payloads[i]);  // e.g. too big to batch
+            }
+        }
+    } else {
+        sendmmsg_helper(fd_num(), nullptr, payloads, _gso);
+    }
     register_write();
 }
 
+//! \details Checks for support by setting the socket's default segment size to zero (which leaves each send
+//! unsegmented unless it asks otherwise).
+bool UDPSocket::enable_gso() {
+    const int no_default_segmentation = 0;
+    _gso = ::setsockopt(fd_num(),
+                        SOL_UDP,
+                        UDP_SEGMENT,
+                        &no_default_segmentation,
+                        sizeof(no_default_segmentation)) == 0;
+    return _gso;
+}
+
+bool UDPSocket::enable_gro() {
+    const int enable = 1;
+    _gro = ::setsockopt(fd_num(), SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == 0;
+    return _gro;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen(const int backlog) { SystemCall("listen", ::listen(fd_num(), backlog)); }
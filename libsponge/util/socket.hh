@@ -8,6 +8,7 @@
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -49,6 +50,10 @@ class Socket : public FileDescriptor {
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
 class UDPSocket : public Socket {
+  private:
+    bool _gso = false;  //!< Coalesce equal-size datagrams in send_batch() (UDP generic segmentation offload)
+    bool _gro = false;  //!< Let the kernel coalesce received datagrams (UDP generic receive offload)
+
   protected:
     //! \brief Construct from FileDescriptor (used by TCPOverUDPSocketAdapter)
     //! \param[in] fd is the FileDescriptor from which to construct
@@ -70,11 +75,41 @@ class UDPSocket : public Socket {
     //! Receive a datagram and the Address of its sender (caller can allocate storage)
     void recv(received_datagram &datagram, const size_t mtu = 65536);
 
+    //! Returned by UDPSocket::recv_buffer; like received_datagram, but the payload is a pooled Buffer
+    struct received_buffer {
+        Address source_address;  //!< Address from which this datagram was received
+        Buffer payload;          //!< UDP datagram payload
+    };
+
+    //! Receive a datagram into a pooled Buffer (no copy for datagrams that fit in one chunk)
+    received_buffer recv_buffer(const size_t mtu = 65536);
+
+    //! \brief Receive up to `max_datagrams` datagrams with one system call (waiting only for the first)
+    //! \note With GRO enabled, a datagram the kernel coalesced is split apart again, so more than
+    //! `max_datagrams` datagrams may be returned
+    std::vector<received_buffer> recv_batch(const size_t max_datagrams = 64, const size_t mtu = 65536);
+
     //! Send a datagram to specified Address
     void sendto(const Address &destination, const BufferViewList &payload);
 
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
+
+    //! Send datagrams to specified Address with as few system calls as possible
+    void send_batch(const Address &destination, const std::vector<BufferViewList> &payloads);
+
+    //! Send datagrams to the socket's connected address with as few system calls as possible
+    void send_batch(const std::vector<BufferViewList> &payloads);
+
+    //! \brief Make send_batch() hand each run of same-size datagrams to the kernel as one buffer, to be split
+    //! into datagrams as late as possible (`UDP_SEGMENT`, see [udp(7)](\ref man7::udp))
+    //! \returns `false` (and leaves GSO off) if the kernel doesn't support it
+    bool enable_gso();
+
+    //! \brief Let the kernel coalesce datagrams from the same flow as they are received (`UDP_GRO`)
+    //! \returns `false` (and leaves GRO off) if the kernel doesn't support it
+    //! \note Only recv_batch() splits coalesced datagrams; recv() and recv_buffer() return them joined together.
+    bool enable_gro();
 };
 
 //! \class UDPSocket
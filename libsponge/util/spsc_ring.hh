@@ -0,0 +1,79 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_RING_HH
+#define SPONGE_LIBSPONGE_SPSC_RING_HH
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! \brief A bounded, lock-free queue between exactly one producer thread and one consumer thread
+//! \details The producer only writes SPSCRing::_tail and the consumer only writes SPSCRing::_head, each
+//! on its own cache line; each side keeps a cached copy of the other's index and reloads it only when
+//! the ring looks full (or empty), so a steady stream costs no cache-line transfers per element.
+template <typename T>
+class SPSCRing {
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> _slots;
+    size_t _mask;
+
+    alignas(CACHE_LINE) std::atomic<size_t> _head{0};  //!< Next slot to pop (written by the consumer)
+    size_t _cached_tail = 0;                            //!< The consumer's last look at SPSCRing::_tail
+
+    alignas(CACHE_LINE) std::atomic<size_t> _tail{0};  //!< Next slot to push (written by the producer)
+    size_t _cached_head = 0;                            //!< The producer's last look at SPSCRing::_head
+
+  public:
+    //! Construct a ring holding up to `capacity` elements (a power of two)
+    explicit SPSCRing(const size_t capacity) : _slots(capacity), _mask(capacity - 1) {
+        if (capacity == 0 or (capacity & _mask) != 0) {
+            throw std::invalid_argument("SPSCRing: capacity must be a power of two");
+        }
+    }
+
+    //! Add an element (producer only); returns `false`, leaving `value` alone, if the ring is full
+    bool push(T &&value) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head == _slots.size()) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head == _slots.size()) {
+                return false;
+            }
+        }
+        _slots[tail & _mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Take the oldest element (consumer only), if there is one
+    std::optional<T> pop() {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _cached_tail) {
+                return std::nullopt;
+            }
+        }
+        std::optional<T> ret{std::move(_slots[head & _mask])};
+        _head.store(head + 1, std::memory_order_release);
+        return ret;
+    }
+
+    //! Whether the ring is empty (exact for the consumer; a snapshot for anyone else)
+    bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+    //! The most elements the ring can hold
+    size_t capacity() const { return _slots.size(); }
+
+    //! \name
+    //! An SPSCRing cannot be copied or moved (both threads refer to it)
+
+    //!@{
+    SPSCRing(const SPSCRing &other) = delete;
+    SPSCRing &operator=(const SPSCRing &other) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_SPSC_RING_HH
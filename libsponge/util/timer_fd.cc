@@ -0,0 +1,37 @@
+#include "timer_fd.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+TimerFD::TimerFD()
+    : FileDescriptor(SystemCall("timerfd_create", timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))) {}
+
+//! \param[in] delay_ms is how long to wait before the descriptor becomes readable
+void TimerFD::arm(const uint64_t delay_ms) {
+    itimerspec setting{};
+    setting.it_value.tv_sec = delay_ms / 1000;
+    setting.it_value.tv_nsec = (delay_ms % 1000) * 1000 * 1000;
+    if (delay_ms == 0) {
+        setting.it_value.tv_nsec = 1;  // an all-zero it_value would disarm the timer instead
+    }
+    SystemCall("timerfd_settime", timerfd_settime(fd_num(), 0, &setting, nullptr));
+}
+
+void TimerFD::disarm() {
+    const itimerspec setting{};
+    SystemCall("timerfd_settime", timerfd_settime(fd_num(), 0, &setting, nullptr));
+}
+
+uint64_t TimerFD::read_expirations() {
+    uint64_t expirations = 0;
+    if (SystemCall("read", ::read(fd_num(), &expirations, sizeof(expirations)), EAGAIN) < 0) {
+        return 0;  // not expired
+    }
+    register_read();
+    return expirations;
+}
@@ -0,0 +1,27 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_FD_HH
+#define SPONGE_LIBSPONGE_TIMER_FD_HH
+
+#include "file_descriptor.hh"
+
+#include <cstdint>
+
+//! \brief A one-shot [timerfd](\ref man2::timerfd_create) on the monotonic clock
+//! \details The descriptor becomes readable when the timer expires, so an EventLoop can wait for a
+//! deadline the same way it waits for I/O, and sleep for exactly as long as there is nothing to do.
+class TimerFD : public FileDescriptor {
+  public:
+    //! Create a disarmed timer
+    TimerFD();
+
+    //! \brief Expire once, `delay_ms` milliseconds from now (immediately, if zero), replacing any earlier setting
+    //! \note Safe to call from another thread, e.g. to wake up a thread waiting on the timer.
+    void arm(const uint64_t delay_ms);
+
+    //! Stop the timer from expiring
+    void disarm();
+
+    //! Consume any expiration (making the descriptor unreadable); returns the number of expirations
+    uint64_t read_expirations();
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_FD_HH
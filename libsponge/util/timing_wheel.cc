@@ -0,0 +1,221 @@
+#include "timing_wheel.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] now_ms is the current time (timers are added with absolute expiry times on the same clock)
+TimingWheel::TimingWheel(const uint64_t now_ms) : _current(now_ms) {
+    _heads.fill(NONE);
+    _tails.fill(NONE);
+}
+
+void TimingWheel::link(const uint32_t index, const uint32_t list) {
+    Node &node = _nodes[index];
+    node.list = list;
+    node.next = NONE;
+    node.prev = _tails[list];
+    if (_tails[list] == NONE) {
+        _heads[list] = index;
+    } else {
+        _nodes[_tails[list]].next = index;
+    }
+    _tails[list] = index;
+
+    if (list < DUE) {
+        _occupied[list / SLOTS][(list % SLOTS) / 64] |= uint64_t(1) << (list % 64);
+    }
+}
+
+void TimingWheel::unlink(const uint32_t index) {
+    Node &node = _nodes[index];
+    const uint32_t list = node.list;
+    if (node.prev == NONE) {
+        _heads[list] = node.next;
+    } else {
+        _nodes[node.prev].next = node.next;
+    }
+    if (node.next == NONE) {
+        _tails[list] = node.prev;
+    } else {
+        _nodes[node.next].prev = node.prev;
+    }
+    node.list = node.prev = node.next = NONE;
+
+    if (list < DUE and _heads[list] == NONE) {
+        _occupied[list / SLOTS][(list % SLOTS) / 64] &= ~(uint64_t(1) << (list % 64));
+    }
+}
+
+void TimingWheel::release(const uint32_t index) {
+    Node &node = _nodes[index];
+    node.callback = nullptr;
+    node.generation++;
+    _free.push_back(index);
+    _size--;
+}
+
+void TimingWheel::place(const uint32_t index) {
+    Node &node = _nodes[index];
+    if (node.expiry < _current) {
+        link(index, DUE);
+        return;
+    }
+    node.expiry = min(node.expiry, _current + HORIZON - 1);
+
+    const uint64_t delay = node.expiry - _current;
+    unsigned level = 0;
+    while (delay >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    link(index, level * SLOTS + ((node.expiry >> (SLOT_BITS * level)) & (SLOTS - 1)));
+}
+
+//! \param[in] level is the level (at least 1) whose slot for the current time is to be emptied
+void TimingWheel::cascade(const unsigned level) {
+    const uint32_t list = level * SLOTS + ((_current >> (SLOT_BITS * level)) & (SLOTS - 1));
+    while (_heads[list] != NONE) {
+        const uint32_t index = _heads[list];
+        unlink(index);
+        place(index);
+    }
+}
+
+//! \param[in] expiry_ms is when the timer should fire
+//! \param[in] callback is called (from TimingWheel::advance) when it fires
+//! \returns an identifier for TimingWheel::cancel
+//! \note Delays beyond 2^32 ms (about 50 days) are shortened to that.
+TimingWheel::TimerId TimingWheel::add(const uint64_t expiry_ms, CallbackT callback) {
+    uint32_t index;
+    if (_free.empty()) {
+        index = _nodes.size();
+        _nodes.emplace_back();
+    } else {
+        index = _free.back();
+        _free.pop_back();
+    }
+
+    _nodes[index].callback = move(callback);
+    _nodes[index].expiry = expiry_ms;
+    place(index);
+    _size++;
+    return {index, _nodes[index].generation};
+}
+
+//! \param[in] timer identifies the timer
+bool TimingWheel::cancel(const TimerId &timer) {
+    if (timer._index >= _nodes.size()) {
+        return false;
+    }
+    const Node &node = _nodes[timer._index];
+    if (node.generation != timer._generation or node.list == NONE) {
+        return false;
+    }
+    unlink(timer._index);
+    release(timer._index);
+    return true;
+}
+
+size_t TimingWheel::fire_all() {
+    size_t fired = 0;
+    while (_heads[FIRING] != NONE) {
+        const uint32_t index = _heads[FIRING];
+        unlink(index);
+        // free the node first, so that the callback may add timers (possibly reusing it) or cancel others
+        const CallbackT callback = move(_nodes[index].callback);
+        release(index);
+        callback();
+        fired++;
+    }
+    return fired;
+}
+
+//! \param[in] bits is a bitmap of the slots of one level
+//! \param[in] from is the slot to start searching from
+//! \returns how many slots past `from` (cyclically) the first occupied slot is, if there is one
+static optional<unsigned> next_occupied(const array<uint64_t, 4> &bits, const unsigned from) {
+    for (unsigned step = 0; step <= bits.size(); step++) {
+        const unsigned word = (from / 64 + step) % bits.size();
+        uint64_t candidates = bits[word];
+        if (step == 0) {
+            candidates &= ~uint64_t(0) << (from % 64);  // slots at or after `from`
+        } else if (step == bits.size()) {
+            candidates &= ~(~uint64_t(0) << (from % 64));  // wrapped around to the slots before `from`
+        }
+        if (candidates) {
+            const unsigned slot = word * 64 + __builtin_ctzll(candidates);
+            return (slot + bits.size() * 64 - from) % (bits.size() * 64);
+        }
+    }
+    return nullopt;
+}
+
+optional<uint64_t> TimingWheel::next_slot_time() const {
+    optional<uint64_t> earliest{};
+
+    // the first level holds timers due within the next SLOTS ms, each in the slot of its exact time
+    const auto distance = next_occupied(_occupied[0], _current & (SLOTS - 1));
+    if (distance) {
+        earliest = _current + distance.value();
+    }
+
+    // a slot of a higher level is cascaded when its span begins (if the current span has already begun, the
+    // timers in its slot wait for the next time around)
+    for (unsigned level = 1; level < LEVELS; level++) {
+        const unsigned shift = SLOT_BITS * level;
+        const uint64_t span = (_current + (uint64_t(1) << shift) - 1) >> shift;  // the first span not yet begun
+        const auto slots_ahead = next_occupied(_occupied[level], span & (SLOTS - 1));
+        if (slots_ahead) {
+            const uint64_t start = (span + slots_ahead.value()) << shift;
+            earliest = min(earliest.value_or(start), start);
+        }
+    }
+    return earliest;
+}
+
+optional<uint64_t> TimingWheel::next_expiry() const {
+    if (_heads[DUE] != NONE) {
+        return _current - 1;  // already expired
+    }
+    return next_slot_time();
+}
+
+//! \param[in] now_ms is the current time
+//! \details Timers added by the callbacks for a time that has already passed are fired by the next call.
+size_t TimingWheel::advance(const uint64_t now_ms) {
+    while (_heads[DUE] != NONE) {
+        const uint32_t index = _heads[DUE];
+        unlink(index);
+        link(index, FIRING);
+    }
+    size_t fired = fire_all();
+
+    while (true) {
+        const auto next = next_slot_time();
+        if (not next or next.value() > now_ms) {
+            break;
+        }
+
+        // skip ahead (no slots in between have timers), cascading if a higher level's span begins now
+        _current = next.value();
+        for (unsigned level = 1; level < LEVELS; level++) {
+            if ((_current & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        const uint32_t slot = _current & (SLOTS - 1);
+        _current++;
+        while (_heads[slot] != NONE) {
+            const uint32_t index = _heads[slot];
+            unlink(index);
+            link(index, FIRING);
+        }
+        fired += fire_all();
+    }
+
+    _current = max(_current, now_ms + 1);
+    return fired;
+}
@@ -0,0 +1,106 @@
+#ifndef SPONGE_LIBSPONGE_TIMING_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMING_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+//! \brief A hierarchical timing wheel: one-shot timers with millisecond resolution, added and canceled in O(1)
+class TimingWheel {
+  public:
+    using CallbackT = std::function<void(void)>;  //!< Called when a timer expires
+
+    //! \brief Refers to a timer added with TimingWheel::add
+    //! \note A TimerId stays safe to use after its timer has fired or been canceled (TimingWheel::cancel
+    //! then does nothing).
+    class TimerId {
+        friend class TimingWheel;
+        uint32_t _index = UINT32_MAX;
+        uint32_t _generation = 0;
+
+        TimerId(const uint32_t index, const uint32_t generation) : _index(index), _generation(generation) {}
+
+      public:
+        TimerId() = default;
+    };
+
+  private:
+    static constexpr unsigned SLOT_BITS = 8;                     //!< log2 of the number of slots per level
+    static constexpr unsigned SLOTS = 1 << SLOT_BITS;            //!< Slots per level
+    static constexpr unsigned LEVELS = 4;                        //!< Levels (together spanning 2^32 ms)
+    static constexpr unsigned DUE = LEVELS * SLOTS;              //!< List of timers added for a time already passed
+    static constexpr unsigned FIRING = DUE + 1;                  //!< List of timers being fired
+    static constexpr unsigned LISTS = FIRING + 1;                //!< Slots plus the two lists above
+    static constexpr uint32_t NONE = UINT32_MAX;                 //!< Null node index
+    static constexpr uint64_t HORIZON = uint64_t(1) << (SLOT_BITS * LEVELS);  //!< Longest delay
+
+    //! A timer, linked into the list it is waiting in
+    struct Node {
+        CallbackT callback{};   //!< Empty while the node is free
+        uint64_t expiry = 0;    //!< When the timer expires
+        uint32_t generation = 0;  //!< Incremented each time the node is freed, invalidating TimerId objects
+        uint32_t list = NONE;   //!< The list the node is in (a slot, DUE or FIRING), or NONE if it is free
+        uint32_t prev = NONE;   //!< Previous node in the list
+        uint32_t next = NONE;   //!< Next node in the list
+    };
+
+    std::vector<Node> _nodes{};      //!< All nodes, free or not (referred to by index, so they can be reallocated)
+    std::vector<uint32_t> _free{};   //!< Indices of free nodes
+    std::array<uint32_t, LISTS> _heads{};  //!< First node of each list
+    std::array<uint32_t, LISTS> _tails{};  //!< Last node of each list
+    std::array<std::array<uint64_t, SLOTS / 64>, LEVELS> _occupied{};  //!< Which slots are non-empty, per level
+
+    uint64_t _current;  //!< The first millisecond not yet processed by TimingWheel::advance
+    size_t _size = 0;   //!< Number of pending timers
+
+    void link(const uint32_t index, const uint32_t list);
+    void unlink(const uint32_t index);
+    void release(const uint32_t index);
+
+    //! Link a node into the slot (or DUE list) for its expiry, relative to TimingWheel::_current
+    void place(const uint32_t index);
+
+    //! Re-place every timer in one slot of a level above the first (they are now due within its span)
+    void cascade(const unsigned level);
+
+    //! The next time at which a slot of the wheel has timers to fire or to cascade, if any
+    std::optional<uint64_t> next_slot_time() const;
+
+    //! Fire every timer in the FIRING list, returning how many there were
+    size_t fire_all();
+
+  public:
+    //! Construct an empty wheel whose clock reads `now_ms`
+    explicit TimingWheel(const uint64_t now_ms);
+
+    //! Call `callback` from the first TimingWheel::advance at or after `expiry_ms`
+    TimerId add(const uint64_t expiry_ms, CallbackT callback);
+
+    //! Cancel a pending timer; returns `false` if it had already fired or been canceled
+    bool cancel(const TimerId &timer);
+
+    //! Fire every timer that has expired by `now_ms`; returns the number fired
+    size_t advance(const uint64_t now_ms);
+
+    //! \brief The next time TimingWheel::advance has work to do, or `std::nullopt` if no timers are pending
+    //! \note This is the earliest expiry, or else the time a later timer moves to a finer level of the wheel.
+    std::optional<uint64_t> next_expiry() const;
+
+    //! Number of pending timers
+    size_t size() const { return _size; }
+};
+
+//! \class TimingWheel
+//! Timers are kept in LEVELS rings of SLOTS slots each. A timer due less than SLOTS ms from now waits in
+//! the first ring, in the slot for its exact millisecond. Timers due further out wait in the ring whose
+//! span covers their delay, in the slot for their coarser time unit (SLOTS ms, SLOTS^2 ms, ...). When the
+//! first ring wraps, the matching slot of the ring above is emptied into the rings below ("cascaded").
+//!
+//! Adding or canceling a timer just links or unlinks a list node. Each timer is moved at most LEVELS - 1
+//! times before it fires. TimingWheel::advance skips straight to slots that have timers (using a bitmap per
+//! ring), so its cost does not depend on the time elapsed or the number of pending timers.
+
+#endif  // SPONGE_LIBSPONGE_TIMING_WHEEL_HH
@@ -14,18 +14,28 @@ using namespace std;
 
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects Ethernet frames)
+//! \param[in] multi_queue is `true` to attach a new queue of a multi-queue device (`IFF_MULTI_QUEUE`); the kernel
+//! spreads received packets across the queues by flow, and a flow's packets follow the queue last used to send on it
+//! \param[in] offload is `true` to exchange TCP/IPv4 packets with the kernel unsegmented (up to 64 KiB) and with
+//! checksums left to be computed (`IFF_VNET_HDR`, with the `TUN_F_CSUM` and `TUN_F_TSO4` offloads)
 //!
 //! To create a TUN device, you should already have run
 //!
 //!     ip tuntap add mode tun user `username` name `devname`
 //!
-//! as root before calling this function.
+//! as root before calling this function (adding `multi_queue` to open it with `multi_queue` set).
 
-TunTapFD::TunTapFD(const string &devname, const bool is_tun)
-    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))) {
+TunTapFD::TunTapFD(const string &devname, const bool is_tun, const bool multi_queue, const bool offload)
+    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))), _offload(offload) {
     struct ifreq tun_req {};
 
     tun_req.ifr_flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI;  // tun device with no packetinfo
+    if (multi_queue) {
+        tun_req.ifr_flags |= IFF_MULTI_QUEUE;
+    }
+    if (offload) {
+        tun_req.ifr_flags |= IFF_VNET_HDR;
+    }
 
     // copy devname to ifr_name, making sure to null terminate
 
@@ -33,4 +43,13 @@ TunTapFD::TunTapFD(const string &devname, const bool is_tun)
     tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
     SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)));
+
+    if (offload) {
+        int header_size = sizeof(VirtioNetHeader);
+        SystemCall("ioctl", ioctl(fd_num(), TUNSETVNETHDRSZ, &header_size));
+    }
+
+    // offloads outlive the descriptor that set them, so turn them off explicitly when not wanted (otherwise
+    // the kernel would go on sending packets with checksums left unfinished)
+    SystemCall("ioctl", ioctl(fd_num(), TUNSETOFFLOAD, offload ? TUN_F_CSUM | TUN_F_TSO4 : 0));
 }
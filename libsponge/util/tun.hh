@@ -3,27 +3,61 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <string>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor {
+  private:
+    bool _offload;  //!< Whether each packet is preceded by a VirtioNetHeader
+
   public:
+    //! \brief The `virtio_net_hdr` that precedes each packet when offloads are on
+    //! \details Mirrors `struct virtio_net_hdr` from `<linux/virtio_net.h>`, which can't be included from C++
+    //! (it has a member named `class`). Fields are in host byte order.
+    struct VirtioNetHeader {
+        static constexpr uint8_t F_NEEDS_CSUM = 1;  //!< `flags`: checksum `csum_start` onward, store at `csum_offset`
+        static constexpr uint8_t F_DATA_VALID = 2;  //!< `flags`: the checksum has already been verified
+        static constexpr uint8_t GSO_NONE = 0;      //!< `gso_type`: a single packet
+        static constexpr uint8_t GSO_TCPV4 = 1;     //!< `gso_type`: split into TCP/IPv4 segments of `gso_size`
+
+        uint8_t flags;         //!< F_* flags
+        uint8_t gso_type;      //!< GSO_* type
+        uint16_t hdr_len;      //!< Length of the IP and TCP headers
+        uint16_t gso_size;     //!< Payload bytes per segment
+        uint16_t csum_start;   //!< Where checksumming starts
+        uint16_t csum_offset;  //!< Where (after `csum_start`) to store the checksum
+    };
+
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunTapFD(const std::string &devname, const bool is_tun);
+    explicit TunTapFD(const std::string &devname,
+                      const bool is_tun,
+                      const bool multi_queue = false,
+                      const bool offload = false);
+
+    //! \brief Whether checksum and segmentation offloads are on
+    //! \details If they are, every packet read or written is preceded by a VirtioNetHeader that describes
+    //! any checksum still to be computed and how to segment the packet.
+    bool offload() const { return _offload; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD {
   public:
-    //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunFD(const std::string &devname) : TunTapFD(devname, true) {}
+    //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt)
+    //! (or, if `multi_queue` is `true`, one more queue of a multi-queue device), optionally with offloads (see
+    //! TunTapFD::offload).
+    explicit TunFD(const std::string &devname, const bool multi_queue = false, const bool offload = false)
+        : TunTapFD(devname, true, multi_queue, offload) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TapFD : public TunTapFD {
   public:
-    //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TapFD(const std::string &devname) : TunTapFD(devname, false) {}
+    //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt)
+    //! (or, if `multi_queue` is `true`, one more queue of a multi-queue device).
+    explicit TapFD(const std::string &devname, const bool multi_queue = false)
+        : TunTapFD(devname, false, multi_queue) {}
 };
 
 #endif  // SPONGE_LIBSPONGE_TUN_HH
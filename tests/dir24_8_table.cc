@@ -0,0 +1,137 @@
+#include "dir24_8_table.hh"
+#include "epoch.hh"
+#include "lpm_trie.hh"
+#include "router.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! More prefixes longer than /24, each in a /24 of its own, than a Dir24_8Table has groups for
+constexpr uint32_t TOO_MANY_GROUPS = 0x8000 + 1;
+
+//! Wait up to `timeout_ms` for `done` (polled with an Epoch::Guard held); returns `done()`
+bool wait_for(const function<bool()> &done, const uint64_t timeout_ms) {
+    const auto deadline = steady_clock::now() + milliseconds(timeout_ms);
+    while (steady_clock::now() < deadline) {
+        {
+            const Epoch::Guard guard;
+            if (done()) {
+                return true;
+            }
+        }
+        this_thread::sleep_for(milliseconds(1));
+    }
+    const Epoch::Guard guard;
+    return done();
+}
+
+//! Check that `builder`'s current table agrees with `trie` on `addresses`
+void check_table(const Dir24_8Builder &builder, const LPMTrie &trie, const vector<uint32_t> &addresses) {
+    const Epoch::Guard guard;
+    const Dir24_8Table *const table = builder.table();
+    test_err_if(not table, "table withdrawn");
+    for (const uint32_t address : addresses) {
+        test_err_if(table->lookup(address) != trie.lookup(address),
+                    "table and trie disagree on " + to_string(address));
+    }
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        uniform_int_distribution<uint32_t> any_address;
+
+        // addresses in and around the prefixes below, and some anywhere
+        vector<uint32_t> addresses;
+        for (uint32_t low = 0; low < 256; low++) {
+            addresses.push_back(0x0a010200 | low);  // 10.1.2.x
+        }
+        for (const uint32_t address : {0x0a000000U, 0x0affffffU, 0x09ffffffU, 0x0b000000U, 0U, UINT32_MAX}) {
+            addresses.push_back(address);
+        }
+        for (size_t i = 0; i < 1000; i++) {
+            addresses.push_back(any_address(rd));
+        }
+
+        // test 1: the builder's table follows the changes reported to it, including ones to /0 and /32
+        {
+            LPMTrie trie;
+            trie.insert(0x0a000000, 8, 1);   // 10.0.0.0/8
+            trie.insert(0x0a010200, 24, 2);  // 10.1.2.0/24
+            trie.insert(0x0a010280, 25, 3);  // 10.1.2.128/25
+            trie.insert(0x0a0102c8, 32, 4);  // 10.1.2.200/32
+            Dir24_8Builder builder{trie, 1};
+            check_table(builder, trie, addresses);
+
+            trie.erase(0x0a010280, 25);
+            builder.update(0x0a010280, 25, {}, 2);
+            trie.insert(0, 0, 5);
+            builder.update(0, 0, 5, 3);
+            trie.insert(0x0a000000, 8, 6);
+            builder.update(0x0a000000, 8, 6, 4);
+            trie.erase(0x0a0102c8, 32);
+            builder.update(0x0a0102c8, 32, {}, 5);
+            trie.insert(0x0a0102c9, 32, 7);
+            builder.update(0x0a0102c9, 32, 7, 6);
+
+            test_err_if(not wait_for([&] { return builder.table()->version() == 6; }, 10000),
+                        "test 1 failed: changes not compiled");
+            check_table(builder, trie, addresses);
+        }
+
+        // test 2: a change that cannot be compiled withdraws the table, rather than leaving it stale
+        {
+            Dir24_8Builder builder{LPMTrie{}, 0};
+            for (uint32_t i = 0; i < TOO_MANY_GROUPS; i++) {
+                builder.update((i << 8) | 1, 32, i % 16, i + 1);
+            }
+            test_err_if(not wait_for([&] { return builder.table() == nullptr; }, 10000),
+                        "test 2 failed: table not withdrawn after a failed update");
+            builder.update(0, 0, 1, TOO_MANY_GROUPS + 1);  // ignored
+            const Epoch::Guard guard;
+            test_err_if(builder.table() != nullptr, "test 2 failed: table published after a failed update");
+        }
+
+        // test 3: a Router whose table is withdrawn goes on looking up routes in its route table
+        {
+            Router router;
+            router.add_route(0, 0, {}, 7);
+            router.compile_routes();
+            vector<Router::Route> routes;
+            for (uint32_t i = 0; i < TOO_MANY_GROUPS; i++) {
+                routes.push_back({(i << 8) | 1, 32, {}, i % 4});
+            }
+            router.add_routes(routes);
+
+            const auto deadline = steady_clock::now() + seconds(1);
+            while (steady_clock::now() < deadline) {
+                const uint32_t i = any_address(rd) % TOO_MANY_GROUPS;
+                const auto hop = router.lookup((i << 8) | 1);
+                test_err_if(not hop or hop->interface_num != i % 4, "test 3 failed: wrong route for a /32");
+                const auto other = router.lookup((i << 8) | 2);
+                test_err_if(not other or other->interface_num != 7, "test 3 failed: wrong default route");
+            }
+            router.remove_route(1, 32);
+            test_err_if(router.lookup(1)->interface_num != 7, "test 3 failed: removed route still used");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+using Backend = EventLoop::Backend;
+
+// On every backend, a rule whose fd is closed, or whose input reaches EOF, outside the rule's own callback
+// is canceled, so that the EventLoop runs out of rules and wait_next_event returns Result::Exit.
+
+string name(const Backend backend) {
+    switch (backend) {
+        case Backend::Poll:
+            return "poll";
+        case Backend::Epoll:
+            return "epoll";
+        default:
+            return "io_uring";
+    }
+}
+
+//! A rule whose interest the EventLoop is told of (InterestMode::Notified), on a socket closed from outside
+void closed_outside(const Backend backend) {
+    EventLoop loop{backend};
+    UDPSocket sock;
+    sock.bind(Address{"127.0.0.1", 0});
+    bool canceled = false;
+    loop.add_rule(
+        sock, Direction::In, [&] { sock.recv(); }, [] { return true; }, [&] { canceled = true; },
+        EventLoop::InterestMode::Notified);
+
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name(backend) + ": expected a timeout");
+    sock.close();
+    test_err_if(loop.wait_next_event(1000) != EventLoop::Result::Exit,
+                name(backend) + ": rule on a closed fd kept the loop waiting");
+    test_err_if(not canceled, name(backend) + ": rule on a closed fd not canceled");
+}
+
+//! A rule without an interest callback, on a pipe read to EOF from outside
+void eof_outside(const Backend backend) {
+    int fds[2];
+    SystemCall("pipe", ::pipe(fds));
+    FileDescriptor read_end{fds[0]};
+    FileDescriptor write_end{fds[1]};
+
+    EventLoop loop{backend};
+    bool canceled = false;
+    loop.add_rule(
+        read_end, Direction::In, [&] { read_end.read(); }, {}, [&] { canceled = true; });
+
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, name(backend) + ": expected a timeout");
+    write_end.close();
+    read_end.read();
+    test_err_if(not read_end.eof(), "expected EOF on the pipe");
+    test_err_if(loop.wait_next_event(1000) != EventLoop::Result::Exit,
+                name(backend) + ": rule on an fd at EOF kept the loop waiting");
+    test_err_if(not canceled, name(backend) + ": rule on an fd at EOF not canceled");
+}
+
+int main() {
+    try {
+        for (const auto backend : {Backend::Poll, Backend::Epoll, Backend::IOUring}) {
+            closed_outside(backend);
+            eof_outside(backend);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -89,6 +89,20 @@ int main() {
             test.execute(NotAtEof{});
         }
 
+        // a bare FIN arrives ahead of the data; then the data is retransmitted, carrying the FIN again
+        {
+            ReassemblerTestHarness test{65000};
+
+            test.execute(SubmitSegment{"", 4}.with_eof(true));
+            test.execute(BytesAssembled(0));
+            test.execute(NotAtEof{});
+
+            test.execute(SubmitSegment{"abcd", 0}.with_eof(true));
+            test.execute(BytesAssembled(4));
+            test.execute(BytesAvailable("abcd"));
+            test.execute(AtEof{});
+        }
+
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
         return EXIT_FAILURE;
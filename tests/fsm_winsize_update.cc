@@ -0,0 +1,65 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static constexpr unsigned NREPS = 32;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        TCPConfig cfg{};
+
+        // test 1: fill the receive window, then read: the connection announces the reopened window only once
+        // it has grown by a full segment or by half the buffer, whichever is less (RFC 1122 4.2.3.3)
+        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+            cfg.recv_capacity = 1000 + (rd() % 64000);
+            const size_t threshold = min(TCPConfig::MAX_PAYLOAD_SIZE, cfg.recv_capacity / 2);
+            const WrappingInt32 rx_isn(rd());
+            const WrappingInt32 tx_isn(rd());
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+
+            string d(cfg.recv_capacity, 0);
+            generate(d.begin(), d.end(), [&] { return rd(); });
+            for (size_t off = 0; off < d.size(); off += TCPConfig::MAX_PAYLOAD_SIZE) {
+                const size_t sz = min(TCPConfig::MAX_PAYLOAD_SIZE, d.size() - off);
+                test_1.send_data(rx_isn + 1 + off, tx_isn + 1, d.cbegin() + off, d.cbegin() + off + sz);
+                test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(rx_isn + 1 + off + sz).with_win(
+                                   cfg.recv_capacity - off - sz),
+                               "test 1 failed: no ACK for data");
+            }
+
+            test_1.execute(Read{threshold - 1});
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: window update for less than the threshold");
+
+            test_1.execute(Read{1});
+            test_1.execute(ExpectOneSegment{}
+                               .with_no_flags()
+                               .with_ack(true)
+                               .with_ackno(rx_isn + 1 + cfg.recv_capacity)
+                               .with_win(threshold)
+                               .with_payload_size(0),
+                           "test 1 failed: no window update at the threshold");
+
+            // the next update is measured from the window just announced
+            test_1.execute(Read{threshold - 1});
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: window update soon after the last");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
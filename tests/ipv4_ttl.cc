@@ -0,0 +1,174 @@
+#include "buffer.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+
+using namespace std;
+
+//! The checksum of `header`, computed over the whole header
+uint16_t full_checksum(IPv4Header header) {
+    header.cksum = 0;
+    InternetChecksum check;
+    check.add(header.serialize());
+    return check.value();
+}
+
+//! Decrement the TTL of `header` (whose checksum is `cksum`, which need not be the one full_checksum() gives),
+//! checking the result against a full recomputation
+void check_header(IPv4Header header, const uint16_t cksum, const string &test) {
+    header.cksum = cksum;
+    const uint8_t ttl = header.ttl;
+    header.decrement_ttl();
+    test_err_if(header.ttl != uint8_t(ttl - 1), test + " failed: TTL not decremented");
+    test_err_if(header.cksum != full_checksum(header),
+                test + " failed: incremental checksum " + to_string(header.cksum) + " differs from full checksum " +
+                    to_string(full_checksum(header)));
+}
+
+//! A datagram, serialized with a correct checksum
+string make_datagram(const IPv4Header &header, const string &payload) {
+    IPv4Datagram datagram;
+    datagram.header() = header;
+    datagram.header().len = IPv4Header::LENGTH + payload.size();
+    datagram.payload() = string(payload);
+    return datagram.serialize().concatenate();
+}
+
+//! Check that `datagram` serializes to bytes that parse (so their checksum is right) with `ttl`, the same as
+//! a datagram with its header and payload rebuilt from scratch
+void check_datagram(const IPv4Datagram &datagram, const uint8_t ttl, const string &payload, const string &test) {
+    const string bytes = datagram.serialize().concatenate();
+    IPv4Datagram reparsed;
+    test_err_if(reparsed.parse(string(bytes)) != ParseResult::NoError, test + " failed: datagram does not parse");
+    test_err_if(reparsed.header().ttl != ttl, test + " failed: wrong TTL serialized");
+    test_err_if(datagram.payload().concatenate() != payload, test + " failed: payload changed");
+
+    IPv4Datagram rebuilt = datagram;
+    rebuilt.header();  // forget the bytes parsed
+    test_err_if(rebuilt.serialize().concatenate() != bytes, test + " failed: differs from a rebuilt datagram");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        uniform_int_distribution<uint16_t> u16;
+        uniform_int_distribution<uint32_t> u32;
+
+        IPv4Header base;
+        base.len = 100;
+        base.id = 0x1234;
+        base.proto = IPv4Header::PROTO_UDP;
+        base.src = 0x0a000001;
+        base.dst = 0xc0a80001;
+
+        // test 1: random headers, every TTL (down to 1 -> 0), against a full recomputation
+        for (size_t i = 0; i < 1000; i++) {
+            IPv4Header header = base;
+            header.tos = u16(rd);
+            header.len = u16(rd);
+            header.id = u16(rd);
+            header.df = u16(rd) & 1;
+            header.offset = u16(rd) & 0x1fff;
+            header.proto = u16(rd);
+            header.src = u32(rd);
+            header.dst = u32(rd);
+            header.ttl = 1 + u16(rd) % 255;
+            header.cksum = full_checksum(header);
+            while (header.ttl > 0) {
+                check_header(header, header.cksum, "test 1");
+                header.decrement_ttl();
+            }
+        }
+
+        // test 2: checksums at the wrap-around point, where the header's other words sum to 0xffff (so that
+        // 0x0000 and 0xffff are both valid checksums), and where the checksum after the decrement is 0x0000
+        {
+            bool found_before = false;
+            bool found_after = false;
+            for (uint32_t id = 0; id <= UINT16_MAX; id++) {
+                IPv4Header header = base;
+                header.id = id;
+                if (full_checksum(header) == 0) {
+                    found_before = true;
+                    check_header(header, 0x0000, "test 2 (checksum 0x0000)");
+                    check_header(header, 0xffff, "test 2 (checksum 0xffff)");
+                }
+                IPv4Header after = header;
+                after.ttl--;
+                if (full_checksum(after) == 0) {
+                    found_after = true;
+                    check_header(header, full_checksum(header), "test 2 (checksum becoming 0x0000)");
+                }
+            }
+            test_err_if(not found_before or not found_after, "test 2 failed: no header with a wrapping checksum");
+
+            // the same, for headers carrying each TTL (including 1 -> 0)
+            for (unsigned ttl = 1; ttl <= UINT8_MAX; ttl++) {
+                IPv4Header header = base;
+                header.ttl = ttl;
+                header.id = 0;
+                header.id = full_checksum(header);  // makes the words of the header (but the checksum) sum to 0xffff
+                test_err_if(full_checksum(header) != 0, "test 2 failed: could not make the checksum 0x0000");
+                check_header(header, 0x0000, "test 2 (TTL " + to_string(ttl) + ")");
+                check_header(header, 0xffff, "test 2 (TTL " + to_string(ttl) + ")");
+            }
+        }
+
+        // test 3: a parsed datagram's bytes are patched, in place when nothing else holds them
+        {
+            const string payload = "a payload of some length";
+            IPv4Header header = base;
+            header.ttl = 2;
+
+            IPv4Datagram datagram;
+            test_err_if(datagram.parse(make_datagram(header, payload)) != ParseResult::NoError,
+                        "test 3 failed: datagram does not parse");
+            const char *const parsed = datagram.serialize().buffers().front().str().data();
+            datagram.decrement_ttl();
+            check_datagram(datagram, 1, payload, "test 3");
+            test_err_if(datagram.serialize().buffers().front().str().data() != parsed,
+                        "test 3 failed: bytes not patched in place");
+
+            datagram.decrement_ttl();  // 1 -> 0
+            check_datagram(datagram, 0, payload, "test 3 (TTL 1 -> 0)");
+        }
+
+        // test 4: copy on write: bytes that another Buffer shares are copied before they are patched
+        {
+            const string payload = "shared";
+            IPv4Header header = base;
+            header.ttl = 64;
+            const string original = make_datagram(header, payload);
+            const Buffer shared{string(original)};
+
+            IPv4Datagram datagram;
+            test_err_if(datagram.parse(shared) != ParseResult::NoError, "test 4 failed: datagram does not parse");
+            IPv4Datagram copy = datagram;  // shares the bytes too
+            datagram.decrement_ttl();
+            check_datagram(datagram, 63, payload, "test 4");
+            test_err_if(shared.str() != original, "test 4 failed: shared bytes changed");
+            test_err_if(copy.serialize().concatenate() != original, "test 4 failed: copy of the datagram changed");
+            test_err_if(copy.header().ttl != 64, "test 4 failed: copy's TTL changed");
+
+            copy.decrement_ttl();
+            test_err_if(copy.serialize().concatenate() != datagram.serialize().concatenate(),
+                        "test 4 failed: datagram and copy differ after both decrements");
+            test_err_if(shared.str() != original, "test 4 failed: shared bytes changed");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
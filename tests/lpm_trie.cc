@@ -0,0 +1,233 @@
+#include "lpm_trie.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! The routes the trie should hold, keyed by (length, prefix), for checking it by a linear scan
+class Reference {
+    map<pair<uint8_t, uint32_t>, uint32_t> _routes{};
+
+  public:
+    void insert(const uint32_t prefix, const uint8_t length, const uint32_t value) {
+        _routes[{length, prefix & LPMTrie::mask(length)}] = value;
+    }
+
+    void erase(const uint32_t prefix, const uint8_t length) { _routes.erase({length, prefix & LPMTrie::mask(length)}); }
+
+    //! Longest-prefix match by scanning every route
+    optional<uint32_t> lookup(const uint32_t address, const uint8_t max_length = 32) const {
+        optional<uint32_t> best{};
+        for (const auto &[key, value] : _routes) {  // shortest first
+            const auto [length, prefix] = key;
+            if (length <= max_length and (address & LPMTrie::mask(length)) == prefix) {
+                best = value;
+            }
+        }
+        return best;
+    }
+
+    const map<pair<uint8_t, uint32_t>, uint32_t> &routes() const { return _routes; }
+};
+
+//! Check `trie` against `reference`: lookups (single and batched) of `addresses`, find(), size() and for_each()
+void check(const LPMTrie &trie, const Reference &reference, const vector<uint32_t> &addresses, const string &test) {
+    vector<optional<uint32_t>> batch(addresses.size());
+    trie.lookup_batch(addresses.data(), batch.data(), addresses.size());
+    for (size_t i = 0; i < addresses.size(); i++) {
+        const auto expected = reference.lookup(addresses[i]);
+        test_err_if(trie.lookup(addresses[i]) != expected,
+                    test + " failed: trie and scan disagree on " + to_string(addresses[i]));
+        test_err_if(batch[i] != expected,
+                    test + " failed: lookup_batch() and scan disagree on " + to_string(addresses[i]));
+        for (const uint8_t max_length : {0, 8, 23, 31}) {
+            test_err_if(trie.lookup(addresses[i], max_length) != reference.lookup(addresses[i], max_length),
+                        test + " failed: lookup with a maximum length disagrees on " + to_string(addresses[i]));
+        }
+    }
+
+    test_err_if(trie.size() != reference.routes().size(), test + " failed: wrong size()");
+    for (const auto &[key, value] : reference.routes()) {
+        test_err_if(trie.find(key.second, key.first) != value, test + " failed: prefix not found");
+    }
+    map<pair<uint8_t, uint32_t>, uint32_t> visited;
+    trie.for_each(0, 0, [&](const uint32_t prefix, const uint8_t length, const uint32_t value) {
+        test_err_if(not visited.emplace(make_pair(length, prefix), value).second, test + " failed: visited twice");
+    });
+    test_err_if(visited != reference.routes(), test + " failed: for_each() visited the wrong prefixes");
+}
+
+//! Addresses in and around each route's prefix (its first and last, and those just outside), plus `extra`
+vector<uint32_t> addresses_near(const Reference &reference, const vector<uint32_t> &extra = {}) {
+    vector<uint32_t> addresses = extra;
+    for (const auto &entry : reference.routes()) {
+        const auto [length, prefix] = entry.first;
+        const uint32_t last = prefix | ~LPMTrie::mask(length);
+        addresses.insert(addresses.end(), {prefix, last, prefix - 1, last + 1});
+    }
+    return addresses;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // test 1: prefixes nested in and overlapping each other, inserted longest first and shortest first
+        {
+            const vector<tuple<uint32_t, uint8_t>> chain = {
+                {0x0a010203, 32}, {0x0a010200, 24}, {0x0a010000, 16}, {0x0a000000, 8}, {0x0a010280, 25}};
+            for (const bool longest_first : {true, false}) {
+                LPMTrie trie;
+                Reference reference;
+                for (size_t i = 0; i < chain.size(); i++) {
+                    const auto [prefix, length] = chain[longest_first ? i : chain.size() - 1 - i];
+                    test_err_if(not trie.insert(prefix, length, i), "test 1 failed: insert() of a new prefix");
+                    reference.insert(prefix, length, i);
+                }
+                check(trie, reference, addresses_near(reference), "test 1");
+
+                // replace a value, then remove prefixes from the middle of the chain
+                test_err_if(trie.insert(0x0a010000, 16, 99), "test 1 failed: insert() of an existing prefix");
+                reference.insert(0x0a010000, 16, 99);
+                check(trie, reference, addresses_near(reference), "test 1");
+                for (const auto &[prefix, length] : {make_pair(0x0a010200U, 24), make_pair(0x0a000000U, 8)}) {
+                    test_err_if(not trie.erase(prefix, length), "test 1 failed: erase() of a present prefix");
+                    test_err_if(trie.erase(prefix, length), "test 1 failed: erase() of an absent prefix");
+                    reference.erase(prefix, length);
+                    check(trie, reference, addresses_near(reference, {0x0a010204, 0x0a0102ff}), "test 1");
+                }
+            }
+        }
+
+        // test 2: the /0 and /32 prefixes at both ends of the address space
+        {
+            LPMTrie trie;
+            Reference reference;
+            const vector<uint32_t> edges = {0, 1, 0x7fffffff, 0x80000000, UINT32_MAX - 1, UINT32_MAX};
+            for (const uint32_t address : {0U, UINT32_MAX, 0x80000000U}) {
+                trie.insert(address, 32, address & 0xff);
+                reference.insert(address, 32, address & 0xff);
+            }
+            check(trie, reference, edges, "test 2");
+            test_err_if(trie.lookup(1).has_value(), "test 2 failed: match without a default route");
+
+            trie.insert(0x12345678, 0, 7);  // bits past the length are ignored
+            reference.insert(0, 0, 7);
+            check(trie, reference, edges, "test 2");
+            test_err_if(trie.lookup(UINT32_MAX, 0) != 7U, "test 2 failed: /0 not matched at maximum length 0");
+
+            test_err_if(not trie.erase(0, 0), "test 2 failed: /0 not erased");
+            reference.erase(0, 0);
+            test_err_if(not trie.erase(UINT32_MAX, 32), "test 2 failed: /32 not erased");
+            reference.erase(UINT32_MAX, 32);
+            check(trie, reference, edges, "test 2");
+
+            test_err_if(trie.erase(0, 33), "test 2 failed: erased a prefix longer than /32");
+            bool threw = false;
+            try {
+                trie.insert(0, 33, 1);
+            } catch (const invalid_argument &) {
+                threw = true;
+            }
+            test_err_if(not threw, "test 2 failed: inserted a prefix longer than /32");
+        }
+
+        // test 3: a node is split by a prefix that diverges from it (making a branch point), and the branch
+        // point is merged away again when one side is erased
+        {
+            LPMTrie trie;
+            Reference reference;
+            trie.insert(0x0a010000, 16, 1);  // 10.1.0.0/16
+            trie.insert(0x0a020000, 16, 2);  // 10.2.0.0/16: diverges from 10.1/16 after 14 bits
+            trie.insert(0x0a030000, 16, 3);  // 10.3.0.0/16: diverges from 10.2/16 after 15 bits
+            trie.insert(0x0a000000, 15, 4);  // 10.0.0.0/15: above 10.1/16, below their branch point
+            reference.insert(0x0a010000, 16, 1);
+            reference.insert(0x0a020000, 16, 2);
+            reference.insert(0x0a030000, 16, 3);
+            reference.insert(0x0a000000, 15, 4);
+            check(trie, reference, addresses_near(reference), "test 3");
+            test_err_if(trie.find(0x0a000000, 14).has_value(), "test 3 failed: found a branch point");
+
+            // churn: erasing a prefix must free the nodes it needed (branch points included), so that the
+            // nodes are reused rather than the trie growing
+            size_t memory = 0;
+            for (size_t round = 0; round < 1000; round++) {
+                if (round == 8) {
+                    memory = trie.memory_usage();  // once the free list has grown to its largest
+                }
+                const uint32_t side = 0x0a000000 | ((round % 4) << 16);
+                const uint8_t length = round % 4 == 0 ? 15 : 16;
+                trie.erase(side, length);
+                reference.erase(side, length);
+                const uint32_t extra = 0x0a000000 | (rd() & 0xffffff);
+                const uint8_t extra_length = 17 + rd() % 16;
+                trie.insert(extra, extra_length, 5);
+                reference.insert(extra, extra_length, 5);
+                check(trie, reference, addresses_near(reference, {side, side | 0xffff}), "test 3");
+
+                trie.erase(extra, extra_length);
+                reference.erase(extra, extra_length);
+                trie.insert(side, length, round);
+                reference.insert(side, length, round);
+            }
+            test_err_if(trie.memory_usage() != memory, "test 3 failed: erase() leaked nodes");
+
+            const auto remaining = reference.routes();
+            for (const auto &entry : remaining) {
+                trie.erase(entry.first.second, entry.first.first);
+                reference.erase(entry.first.second, entry.first.first);
+            }
+            check(trie, reference, {0x0a010000, 0}, "test 3");
+            test_err_if(trie.lookup(0x0a010000).has_value(), "test 3 failed: emptied trie matched");
+        }
+
+        // test 4: random routes, with lengths as in a BGP table, against a linear scan, including after
+        // removing half of them
+        {
+            discrete_distribution<int> length_distribution{
+                {1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 3, 5, 6, 13, 6, 10, 18, 30, 40, 60, 50, 320, 5, 5, 5, 5,
+                 5, 5, 5, 20}};
+            LPMTrie trie;
+            Reference reference;
+            vector<pair<uint32_t, uint8_t>> inserted;
+            for (uint32_t i = 0; i < 2000; i++) {
+                const auto length = static_cast<uint8_t>(length_distribution(rd));
+                const uint32_t prefix = rd() & LPMTrie::mask(length);
+                trie.insert(prefix, length, i);
+                reference.insert(prefix, length, i);
+                inserted.emplace_back(prefix, length);
+            }
+
+            vector<uint32_t> addresses;
+            for (size_t i = 0; i < 5000; i++) {
+                const auto &[prefix, length] = inserted[rd() % inserted.size()];
+                addresses.push_back(i % 2 ? rd() : prefix | (rd() & ~LPMTrie::mask(length)));
+            }
+            check(trie, reference, addresses, "test 4");
+
+            for (size_t i = 1; i < inserted.size(); i += 2) {
+                trie.erase(inserted[i].first, inserted[i].second);
+                reference.erase(inserted[i].first, inserted[i].second);
+            }
+            check(trie, reference, addresses, "test 4");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -535,6 +535,24 @@ struct Write : public TCPAction {
     }
 };
 
+struct Read : public TCPAction {
+    size_t bytes;
+
+    Read(size_t bytes_) : bytes(bytes_) {}
+
+    std::string description() const { return "read " + std::to_string(bytes) + " bytes"; }
+
+    //! Reads as TCPSpongeSocket does: takes bytes from the inbound stream, then tells the connection
+    void execute(TCPTestHarness &harness) const {
+        const size_t bytes_read = harness._fsm.inbound_stream().read(bytes).size();
+        if (bytes_read != bytes) {
+            throw TCPExpectationViolation(std::to_string(bytes) + " bytes should have been read but " +
+                                          std::to_string(bytes_read) + " were");
+        }
+        harness._fsm.inbound_stream_read();
+    }
+};
+
 struct Tick : public TCPAction {
     size_t ms_since_last_tick;
 
@@ -65,7 +65,7 @@ void TestFdAdapter::config_segment(TCPSegment &seg) {
 }
 
 //! \param[in] seg is the TCPSegment to write
-void TestFdAdapter::write(TCPSegment &seg) {
+void TestFdAdapter::write(TCPSegment &&seg) {
     config_segment(seg);
     TestFD::write(seg.serialize());
 }
@@ -145,7 +145,7 @@ void TCPTestHarness::execute(const TCPTestStep &step, std::string note) {
     try {
         step.execute(*this);
         while (not _fsm.segments_out().empty()) {
-            _flt.write(_fsm.segments_out().front());
+            _flt.write(std::move(_fsm.segments_out().front()));
             _fsm.segments_out().pop();
         }
         _steps_executed.emplace_back(step.to_string());
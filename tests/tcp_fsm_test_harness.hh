@@ -50,7 +50,7 @@ class TestFD : public FileDescriptor {
 //! An FdAdapterBase that writes to a TestFD. Does not (need to) support reading.
 class TestFdAdapter : public FdAdapterBase, public TestFD {
   public:
-    void write(TCPSegment &seg);  //!< Write a TCPSegment to the underlying TestFD
+    void write(TCPSegment &&seg);  //!< Write a TCPSegment to the underlying TestFD
 
     void config_segment(TCPSegment &seg);  //!< Copy information from FdAdapterConfig into a TCPSegment
 };
@@ -0,0 +1,177 @@
+#include "address.hh"
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "tcp_stack.hh"
+#include "tcp_state.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using SocketId = TCPStack::SocketId;
+
+// Two TCPStacks without devices, back to back: a server at 10.0.0.1 (and 10.0.0.3), and a client at 10.0.0.2
+
+class Link {
+    deque<InternetDatagram> _to_server{};
+    deque<InternetDatagram> _to_client{};
+
+    //! Hand the datagrams in `queue` to `stack`, as if read off a wire
+    static bool deliver(deque<InternetDatagram> &queue, TCPStack &stack) {
+        if (queue.empty()) {
+            return false;
+        }
+        InternetDatagram datagram;
+        if (datagram.parse(queue.front().serialize().concatenate()) != ParseResult::NoError) {
+            throw runtime_error("a stack sent a datagram that does not parse");
+        }
+        queue.pop_front();
+        stack.datagram_received(datagram);
+        return true;
+    }
+
+  public:
+    TCPStack server{[&](InternetDatagram &&datagram) { _to_client.push_back(move(datagram)); }};
+    TCPStack client{[&](InternetDatagram &&datagram) { _to_server.push_back(move(datagram)); }};
+
+    //! Pass datagrams between the stacks until neither has anything more to say
+    void run() {
+        while (deliver(_to_server, server) or deliver(_to_client, client)) {
+        }
+    }
+
+    //! Run the stacks (and their timers) until `done` or `timeout_ms` passes; returns `done()`
+    bool run_until(const function<bool()> &done, const uint64_t timeout_ms) {
+        const uint64_t deadline = timestamp_ms() + timeout_ms;
+        run();
+        while (not done() and timestamp_ms() < deadline) {
+            client.wait_next_event(10);
+            server.wait_next_event(0);
+            run();
+        }
+        return done();
+    }
+};
+
+const Address server_address{"10.0.0.1", 80};
+const Address other_server_address{"10.0.0.3", 80};
+const Address client_address{"10.0.0.2", 0};
+
+int main() {
+    try {
+        const TCPState established{TCPState::State::ESTABLISHED};
+
+        // test 1: a listener holds at most `backlog` connections waiting; a SYN beyond that is dropped, and the
+        // peer's retransmission gets through once the owner accepts
+        {
+            Link link;
+            const SocketId listener = link.server.listen(server_address, 2);
+            size_t notified = 0;
+            link.server.set_callback(listener, [&] { notified++; });
+
+            vector<SocketId> clients;
+            for (size_t i = 0; i < 3; i++) {
+                clients.push_back(link.client.connect(client_address, server_address));
+            }
+            link.run();
+            test_err_if(link.client.state(clients[0]) != established or link.client.state(clients[1]) != established,
+                        "test 1 failed: connections within the backlog were not established");
+            test_err_if(link.client.state(clients[2]) != TCPState{TCPState::State::SYN_SENT},
+                        "test 1 failed: a connection beyond the backlog was answered");
+            test_err_if(link.server.connection_count() != 2, "test 1 failed: server kept a connection beyond backlog");
+            test_err_if(notified != 2, "test 1 failed: listener not notified of each ready connection");
+
+            test_err_if(not link.server.accept(listener).has_value() or not link.server.accept(listener).has_value(),
+                        "test 1 failed: established connections not accepted");
+            test_err_if(link.server.accept(listener).has_value(), "test 1 failed: accepted a connection not ready");
+
+            const auto third_established = [&] { return link.client.state(clients[2]) == established; };
+            const bool retried = link.run_until(third_established, 4 * TCPConfig::TIMEOUT_DFLT);
+            test_err_if(not retried, "test 1 failed: retransmitted SYN not accepted once the backlog had room");
+            test_err_if(not link.server.accept(listener).has_value(), "test 1 failed: third connection not ready");
+        }
+
+        // test 2: segments go to the connection with their 4-tuple, and SYNs to the listener on their address
+        // and port, else the one on just their port
+        {
+            Link link;
+            const SocketId listener = link.server.listen(server_address, 8);
+            const SocketId any_listener = link.server.listen(Address{"0", 80}, 8);
+
+            const SocketId c1 = link.client.connect(client_address, server_address);
+            const SocketId c2 = link.client.connect(client_address, server_address);
+            const SocketId c3 = link.client.connect(client_address, other_server_address);
+            link.run();
+
+            const auto s1 = link.server.accept(listener);
+            const auto s2 = link.server.accept(listener);
+            const auto s3 = link.server.accept(any_listener);
+            test_err_if(not s1 or not s2 or not s3, "test 2 failed: connections not accepted by their listeners");
+            test_err_if(link.server.accept(listener).has_value() or link.server.accept(any_listener).has_value(),
+                        "test 2 failed: a connection went to both listeners");
+
+            link.client.write(c1, "one");
+            link.client.write(c2, "two");
+            link.client.write(c3, "three");
+            link.run();
+            const string d1 = link.server.read(s1.value(), 100);
+            const string d2 = link.server.read(s2.value(), 100);
+            test_err_if(set<string>({d1, d2}) != set<string>({"one", "two"}), "test 2 failed: data mixed up");
+            test_err_if(link.server.read(s3.value(), 100) != "three", "test 2 failed: wrong data on wildcard listener");
+
+            // echo back: each client must get its own data
+            link.server.write(s1.value(), d1 + "!");
+            link.server.write(s2.value(), d2 + "!");
+            link.server.write(s3.value(), "three!");
+            link.run();
+            test_err_if(link.client.read(c1, 100) != "one!" or link.client.read(c2, 100) != "two!" or
+                            link.client.read(c3, 100) != "three!",
+                        "test 2 failed: data returned on the wrong connection");
+        }
+
+        // test 3: callbacks may close the socket they are called for
+        {
+            Link link;
+            const SocketId listener = link.server.listen(server_address, 8);
+            string received;
+            link.server.set_callback(listener, [&] {
+                const SocketId id = link.server.accept(listener).value();
+                link.server.close(listener);  // accept just the one
+                link.server.set_callback(id, [&, id] {
+                    received += link.server.read(id, link.server.bytes_readable(id));
+                    if (link.server.eof(id)) {
+                        link.server.close(id);
+                    }
+                });
+            });
+
+            const SocketId c = link.client.connect(client_address, server_address);
+            link.run();
+            link.client.write(c, "hello");
+            link.client.shutdown(c);
+            link.run();
+            test_err_if(received != "hello", "test 3 failed: data not read from the callback");
+            test_err_if(not link.client.eof(c), "test 3 failed: closing from the callback did not send a FIN");
+            test_err_if(link.server.connection_count() != 0, "test 3 failed: closed connection not forgotten");
+
+            const SocketId refused = link.client.connect(client_address, server_address);
+            link.run();
+            test_err_if(link.client.state(refused) == established, "test 3 failed: closed listener still accepts");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "test_err_if.hh"
+#include "timing_wheel.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+constexpr uint64_t LEVEL_1 = uint64_t(1) << 8;   // shortest delay kept in the second ring
+constexpr uint64_t LEVEL_2 = uint64_t(1) << 16;  // shortest delay kept in the third ring
+constexpr uint64_t HORIZON = uint64_t(1) << 32;  // longest delay
+
+//! Add a timer that records (expiry, time of firing) in `fired`, firing at the time passed to `advance`
+TimingWheel::TimerId add_recorded(TimingWheel &wheel,
+                                  const uint64_t expiry,
+                                  const uint64_t &now,
+                                  vector<pair<uint64_t, uint64_t>> &fired) {
+    return wheel.add(expiry, [expiry, &now, &fired] { fired.emplace_back(expiry, now); });
+}
+
+//! Advance one millisecond at a time from `from` to `to`, checking that a single timer due at `expiry` fires
+//! exactly then, and that TimingWheel::next_expiry never promises work later than that
+void expect_exact_fire(TimingWheel &wheel, const uint64_t from, const uint64_t to, const uint64_t expiry) {
+    size_t fired = 0;
+    for (uint64_t now = from; now <= to; now++) {
+        const auto next = wheel.next_expiry();
+        test_err_if(fired == 0 and (not next or next.value() > expiry),
+                    "next_expiry() is later than a pending timer at " + to_string(now));
+        const size_t n = wheel.advance(now);
+        test_err_if(n != 0 and now != expiry, "timer due at " + to_string(expiry) + " fired at " + to_string(now));
+        fired += n;
+    }
+    test_err_if(fired != 1, "timer due at " + to_string(expiry) + " fired " + to_string(fired) + " times");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // test 1: timers in every level fire in expiry order, each at the first advance at or after its expiry,
+        // across the cascades from the second and third rings
+        {
+            const uint64_t start = uniform_int_distribution<uint64_t>{0, 1 << 20}(rd);
+            uint64_t now = start;
+            TimingWheel wheel{now};
+            vector<pair<uint64_t, uint64_t>> fired;
+
+            using Delay = uniform_int_distribution<uint64_t>;
+            Delay delay_in_level[] = {Delay{0, LEVEL_1 - 1}, Delay{LEVEL_1, LEVEL_2 - 1}, Delay{LEVEL_2, 4 * LEVEL_2}};
+            const size_t count = 3000;
+            for (size_t i = 0; i < count; i++) {
+                add_recorded(wheel, start + delay_in_level[i % 3](rd), now, fired);
+            }
+            test_err_if(wheel.size() != count, "test 1 failed: wrong size after add");
+
+            uniform_int_distribution<uint64_t> step{1, 700};
+            while (wheel.size() > 0) {
+                now += step(rd);
+                const size_t before = fired.size();
+                const size_t n = wheel.advance(now);
+                test_err_if(n != fired.size() - before, "test 1 failed: advance() miscounted timers fired");
+            }
+
+            test_err_if(fired.size() != count, "test 1 failed: not every timer fired");
+            for (size_t i = 0; i < fired.size(); i++) {
+                const auto [expiry, when] = fired[i];
+                test_err_if(when < expiry, "test 1 failed: timer fired early");
+                test_err_if(when >= expiry + step.max(), "test 1 failed: timer fired late");
+                test_err_if(i > 0 and expiry < fired[i - 1].first, "test 1 failed: timers fired out of order");
+            }
+        }
+
+        // test 2: a timer whose coarse slot is the one for the span already under way (delay just under
+        // LEVEL_2, or LEVEL_2 * 256) waits for the next time around the ring, and fires on time
+        {
+            for (const uint64_t level_span : {LEVEL_1, LEVEL_2}) {
+                const uint64_t start = 1000 * level_span + level_span / 2 + 7;  // part-way through a span
+                const uint64_t delay = level_span * 256 - level_span / 4;       // lands in that span's slot
+                TimingWheel wheel{start};
+                const uint64_t expiry = start + delay;
+                wheel.add(expiry, [] {});
+
+                // the span of the slot is under way: nothing there to cascade until the ring comes round
+                test_err_if(wheel.advance(start + level_span) != 0, "test 2 failed: timer fired a ring early");
+                test_err_if(wheel.next_expiry().value() > expiry, "test 2 failed: next_expiry() after the timer");
+                test_err_if(wheel.next_expiry().value() <= start + level_span,
+                            "test 2 failed: next_expiry() when no work is due");
+                test_err_if(wheel.advance(expiry - 2 * LEVEL_1) != 0, "test 2 failed: timer fired early");
+                expect_exact_fire(wheel, expiry - 2 * LEVEL_1 + 1, expiry + 5, expiry);
+            }
+        }
+
+        // test 3: canceling a timer after it fires, or twice, does nothing, even once its node is reused
+        {
+            TimingWheel wheel{0};
+            size_t first_fired = 0;
+            size_t second_fired = 0;
+            const auto first = wheel.add(10, [&] { first_fired++; });
+            test_err_if(wheel.advance(10) != 1 or first_fired != 1, "test 3 failed: timer did not fire");
+            test_err_if(wheel.cancel(first), "test 3 failed: canceled a timer that had fired");
+
+            const auto second = wheel.add(20, [&] { second_fired++; });  // reuses the freed node
+            test_err_if(wheel.cancel(first), "test 3 failed: stale id canceled a newer timer");
+            test_err_if(wheel.size() != 1, "test 3 failed: stale id changed size");
+            test_err_if(wheel.advance(20) != 1 or second_fired != 1, "test 3 failed: newer timer did not fire");
+
+            const auto third = wheel.add(30, [&] { second_fired++; });
+            test_err_if(not wheel.cancel(third), "test 3 failed: pending timer not canceled");
+            test_err_if(wheel.cancel(third), "test 3 failed: timer canceled twice");
+            test_err_if(wheel.cancel(second), "test 3 failed: canceled a timer that had fired");
+            test_err_if(wheel.size() != 0 or wheel.next_expiry().has_value(), "test 3 failed: wheel not empty");
+            test_err_if(wheel.advance(1000) != 0 or second_fired != 1, "test 3 failed: canceled timer fired");
+            test_err_if(wheel.cancel(TimingWheel::TimerId{}), "test 3 failed: canceled a default TimerId");
+
+            // a callback may cancel another timer due at the same time, and add one reusing its own node
+            TimingWheel::TimerId victim;
+            size_t victim_fired = 0;
+            size_t added_fired = 0;
+            wheel.add(2000, [&] {
+                test_err_if(not wheel.cancel(victim), "test 3 failed: callback could not cancel");
+                wheel.add(2001, [&] { added_fired++; });
+            });
+            victim = wheel.add(2000, [&] { victim_fired++; });
+            test_err_if(wheel.advance(2000) != 1 or victim_fired != 0, "test 3 failed: canceled timer fired");
+            test_err_if(wheel.advance(2001) != 1 or added_fired != 1, "test 3 failed: timer added by callback");
+        }
+
+        // test 4: delays beyond the wheel's horizon are shortened to it
+        {
+            const uint64_t start = 12345;
+            TimingWheel wheel{start};
+            bool fired = false;
+            wheel.add(start + (HORIZON << 4), [&] { fired = true; });
+            const uint64_t clamped = start + HORIZON - 1;
+            test_err_if(wheel.next_expiry().value() > clamped, "test 4 failed: next_expiry() beyond the horizon");
+            test_err_if(wheel.advance(clamped - 1) != 0 or fired, "test 4 failed: timer fired early");
+            test_err_if(wheel.next_expiry().value() != clamped, "test 4 failed: wrong next_expiry()");
+            test_err_if(wheel.advance(clamped) != 1 or not fired, "test 4 failed: timer not fired at the horizon");
+
+            // right at the horizon: kept as is
+            const uint64_t edge = clamped + HORIZON;
+            wheel.add(edge, [] {});
+            test_err_if(wheel.advance(edge - 1) != 0, "test 4 failed: timer at the horizon fired early");
+            test_err_if(wheel.advance(edge) != 1, "test 4 failed: timer at the horizon not fired");
+        }
+
+        // test 5: a timer added for a time already passed is due at once, even from a callback
+        {
+            TimingWheel wheel{0};
+            test_err_if(wheel.advance(100) != 0, "test 5 failed: empty wheel fired");
+            bool late_fired = false;
+            wheel.add(50, [&] { late_fired = true; });
+            wheel.add(5000, [] {});
+            test_err_if(wheel.next_expiry().value() > 100, "test 5 failed: next_expiry() ignores a due timer");
+            test_err_if(wheel.advance(100) != 1 or not late_fired, "test 5 failed: due timer not fired");
+            test_err_if(wheel.next_expiry().value() > 5000 or wheel.next_expiry().value() <= 100,
+                        "test 5 failed: wrong next_expiry() after the due list");
+
+            bool chained_fired = false;
+            wheel.add(200, [&] { wheel.add(150, [&] { chained_fired = true; }); });
+            test_err_if(wheel.advance(300) != 1 or chained_fired, "test 5 failed: callback's timer fired too soon");
+            test_err_if(wheel.next_expiry().value() > 300, "test 5 failed: next_expiry() ignores a due timer");
+            test_err_if(wheel.advance(300) != 1 or not chained_fired, "test 5 failed: callback's timer not fired");
+            test_err_if(wheel.next_expiry().value() > 5000 or wheel.next_expiry().value() <= 300,
+                        "test 5 failed: wrong next_expiry() after the due list");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}